@@ -0,0 +1,219 @@
+//===---------------------------------------------------*- C -*---===
+//: bench_cli.c
+//
+// DESCRIPTION
+// Times the `sysconf` command line on generated config files (see
+// gen_config.c) of each size and style. Each case runs the real
+// program a number of times (at least 3, and for at least a second)
+// and prints one line:
+//
+//      cli <case> style=<rc|jail> keys=<n> bytes=<n> runs=<n> seconds=<s>
+//          ops_per_sec=<r> mb_per_sec=<r> peak_rss_kb=<n>
+//
+// (on one line). `mb_per_sec` is the size of the config file times
+// the number of runs over the time taken; `peak_rss_kb` is the largest
+// resident size of any run.
+//
+// The cases are:
+//      list    sysconf -f file                 (print every key)
+//      get     sysconf -f file bench_key
+//      set     sysconf -f file bench_key=value
+//      add     sysconf -f file bench_key+=extra
+//      remove  sysconf -f file bench_key-=extra  (alternates with add)
+//      dups    sysconf -f file -d defaults     (a tenth as many keys)
+//
+// USAGE
+//      bench_cli [keys ...]                    (default 100 10000 1000000)
+//
+// Run from the top of the tree after `make bench` has built
+// ./sysconf and ./gen_config. Files are generated in $TMPDIR. The runs
+// do not ask a running sysconfd (SYSCONF_SOCKET is set to ""), so the
+// command line itself is timed.
+//===-------------------------------------------------------------===
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#define MIN_RUNS        3
+#define MAX_RUNS        1000
+#define MIN_SECONDS     1.0
+
+// The result of one or more runs of a case
+typedef struct {
+  int runs;
+  double seconds;
+  long peak_rss_kb;
+} result_t;
+
+//------------------------------------------------------*- C -*------
+// now
+//      Monotonic time in seconds.
+//-------------------------------------------------------------------
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+//------------------------------------------------------*- C -*------
+// run
+//      Run a program with STDOUT sent to `output` (or /dev/null) and
+//      wait for it. It runs with SYSCONF_SOCKET="", so `sysconf` does
+//      not hand the request to a daemon.
+//
+// ARGS
+//  argv            :   the program and its arguments
+//  output          :   file for STDOUT, or NULL
+//  result          :   gets the run's time and resident size added
+//
+// RETURN
+//  int             :   the program's exit status, or -1
+//-------------------------------------------------------------------
+static int run(char *const argv[], const char *output, result_t *result) {
+  double start = now();
+  pid_t pid = fork();
+  if (pid < 0)
+    return -1;
+  if (pid == 0) {
+    int fd = output ? open(output, O_WRONLY | O_CREAT | O_TRUNC, 0644) : open("/dev/null", O_WRONLY);
+    int null = open("/dev/null", O_WRONLY);
+    if (fd < 0 || null < 0)
+      _exit(127);
+    dup2(fd, STDOUT_FILENO);
+    dup2(null, STDERR_FILENO);
+    setenv("SYSCONF_SOCKET", "", 1);
+    execv(argv[0], argv);
+    _exit(127);
+  }
+
+  int status;
+  struct rusage usage;
+  if (wait4(pid, &status, 0, &usage) < 0)
+    return -1;
+  if (result != NULL) {
+    result->seconds += now() - start;
+    result->runs++;
+#ifdef __APPLE__
+    long rss = usage.ru_maxrss / 1024;                  /* bytes on macOS */
+#else
+    long rss = usage.ru_maxrss;                         /* kilobytes elsewhere */
+#endif
+    if (rss > result->peak_rss_kb)
+      result->peak_rss_kb = rss;
+  }
+  return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+//------------------------------------------------------*- C -*------
+// generate
+//      Write a config file with ./gen_config.
+//-------------------------------------------------------------------
+static int generate(const char *filename, int jail, unsigned long keys) {
+  char count[32];
+  snprintf(count, sizeof(count), "%lu", keys);
+  char *rc_argv[] = { "./gen_config", count, NULL };
+  char *jail_argv[] = { "./gen_config", "-j", count, NULL };
+  return run(jail ? jail_argv : rc_argv, filename, NULL);
+}
+
+static void report(const char *name, const char *style, unsigned long keys,
+                   off_t bytes, const result_t *result) {
+  printf("cli %-6s style=%s keys=%lu bytes=%lld runs=%d seconds=%.4f "
+         "ops_per_sec=%.1f mb_per_sec=%.1f peak_rss_kb=%ld\n",
+         name, style, keys, (long long)bytes, result->runs, result->seconds,
+         result->runs / result->seconds,
+         bytes * (double)result->runs / result->seconds / (1024 * 1024),
+         result->peak_rss_kb);
+  fflush(stdout);
+}
+
+static int enough(const result_t *result) {
+  return result->runs >= MAX_RUNS || \
+         (result->runs >= MIN_RUNS && result->seconds >= MIN_SECONDS);
+}
+
+//------------------------------------------------------*- C -*------
+// bench_file
+//      Run every case against one generated file.
+//-------------------------------------------------------------------
+static int bench_file(const char *dir, int jail, unsigned long keys) {
+  char config[4096], defaults[4096];
+  const char *style = jail ? "jail" : "rc";
+  snprintf(config, sizeof(config), "%s/sysconf-bench-%s-%lu.conf", dir, style, keys);
+  snprintf(defaults, sizeof(defaults), "%s/sysconf-bench-%s-%lu.defaults", dir, style, keys);
+  if (generate(config, jail, keys) != 0 || \
+      generate(defaults, jail, keys / 10 > 100 ? keys / 10 : 100) != 0) {
+    fprintf(stderr, "bench_cli: cannot generate %s\n", config);
+    return -1;
+  }
+
+  struct stat st;
+  stat(config, &st);
+
+  char *list[] = { "./sysconf", "-f", config, NULL };
+  char *get[] = { "./sysconf", "-f", config, "bench_key", NULL };
+  char *set[] = { "./sysconf", "-f", config, "bench_key=alpha beta gamma", NULL };
+  char *add[] = { "./sysconf", "-f", config, "bench_key+=extra", NULL };
+  char *remove[] = { "./sysconf", "-f", config, "bench_key-=extra", NULL };
+  char *dups[] = { "./sysconf", "-f", config, "-d", defaults, NULL };
+  struct {
+    const char *name;
+    char **argv;
+  } cases[] = { { "list", list }, { "get", get }, { "set", set }, { "dups", dups } };
+
+  for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+    result_t result = { 0, 0.0, 0 };
+    while (!enough(&result)) {
+      if (run(cases[c].argv, NULL, &result) != 0) {
+        fprintf(stderr, "bench_cli: %s failed on %s\n", cases[c].name, config);
+        break;
+      }
+    }
+    report(cases[c].name, style, keys, st.st_size, &result);
+  }
+
+  // `+=` and `-=` take turns so the file stays the same size.
+  result_t added = { 0, 0.0, 0 }, removed = { 0, 0.0, 0 };
+  while (!enough(&added) || !enough(&removed)) {
+    if (run(add, NULL, &added) != 0 || run(remove, NULL, &removed) != 0) {
+      fprintf(stderr, "bench_cli: add/remove failed on %s\n", config);
+      break;
+    }
+  }
+  report("add", style, keys, st.st_size, &added);
+  report("remove", style, keys, st.st_size, &removed);
+
+  unlink(config);
+  unlink(defaults);
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  const char *dir = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+  unsigned long sizes[] = { 100, 10000, 1000000 };
+
+  if (access("./sysconf", X_OK) != 0 || access("./gen_config", X_OK) != 0) {
+    fprintf(stderr, "bench_cli: run `make bench` from the top of the tree\n");
+    return 1;
+  }
+
+  for (int jail = 0; jail <= 1; jail++) {
+    if (argc > 1) {
+      for (int i = 1; i < argc; i++)
+        bench_file(dir, jail, strtoul(argv[i], NULL, 10));
+    } else {
+      for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+        bench_file(dir, jail, sizes[i]);
+    }
+  }
+  return 0;
+}
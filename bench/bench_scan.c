@@ -0,0 +1,125 @@
+//===---------------------------------------------------*- C -*---===
+//: bench_scan.c
+//
+// DESCRIPTION
+// Measures how fast a large config file is split into tokens with
+// the old `strspn()`/`strcspn()` approach and with each delimiter
+// scanner (see delim-scan.h). Prints one line per method:
+//
+//      scan <method> bytes=<n> tokens=<n> seconds=<s> mb_per_sec=<r>
+//
+// USAGE
+//      bench_scan [megabytes]          (default 64)
+//
+// "strspn" is how `count_tokens()`/`populate_array()` used to split
+// strings; "table" is the byte at a time fallback; the last line is
+// the vector scanner `delim_init()` picks on this machine.
+//===-------------------------------------------------------------===
+
+#include "delim-scan.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+//------------------------------------------------------*- C -*------
+// now
+//      Monotonic time in seconds.
+//-------------------------------------------------------------------
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+//------------------------------------------------------*- C -*------
+// make_config
+//      Fill a buffer with config lines of varied shape (nul-terminated
+//      so the string functions can run over it too).
+//-------------------------------------------------------------------
+static char *make_config(size_t size) {
+  char *buffer = malloc(size + 1);
+  size_t length = 0;
+  unsigned seed = 1;
+  if (buffer == NULL)
+    return NULL;
+  while (length + 200 < size) {
+    seed = seed * 1103515245 + 12345;
+    switch ((seed >> 16) % 4) {
+      case 0:  length += sprintf(buffer + length, "item%u = \"value%u\";\n", seed % 100000, seed % 977); break;
+      case 1:  length += sprintf(buffer + length, "  section.key_%u:\t/usr/local/bin/program --flag=%u  # comment\n", seed % 5000, seed % 31); break;
+      case 2:  length += sprintf(buffer + length, "list_%u=\"alpha beta gamma delta epsilon zeta eta theta\"\n", seed % 1000); break;
+      default: length += sprintf(buffer + length, "a_rather_long_key_name_number_%u = a_rather_long_value_that_keeps_going_%u;\n", seed % 300, seed); break;
+    }
+  }
+  buffer[length] = '\0';
+  return buffer;
+}
+
+//------------------------------------------------------*- C -*------
+// count_strspn
+//      Count tokens the way `count_tokens()` used to.
+//-------------------------------------------------------------------
+static size_t count_strspn(const char *p, const char *delimiters) {
+  size_t tokens = 0;
+  p += strspn(p, delimiters);
+  while (*p) {
+    tokens++;
+    p += strcspn(p, delimiters);
+    p += strspn(p, delimiters);
+  }
+  return tokens;
+}
+
+//------------------------------------------------------*- C -*------
+// count_scan
+//      Count tokens line by line with a delimiter scanner, the way the
+//      parser does.
+//-------------------------------------------------------------------
+static size_t count_scan(const delim_set_t *delims, const char *p, size_t length) {
+  const char *end = p + length;
+  size_t tokens = 0;
+  span_t spans[32];
+  while (p < end) {
+    const char *eol = memchr(p, '\n', end - p);
+    const char *next = eol ? eol + 1 : end;
+    tokens += delim_tokens(delims, p, next - p, spans, 32);
+    p = next;
+  }
+  return tokens;
+}
+
+static void report(const char *method, size_t bytes, size_t tokens, double seconds) {
+  printf("scan %-8s bytes=%zu tokens=%zu seconds=%.4f mb_per_sec=%.1f\n",
+         method, bytes, tokens, seconds, bytes / seconds / (1024 * 1024));
+}
+
+int main(int argc, char *argv[]) {
+  size_t megabytes = argc > 1 ? strtoul(argv[1], NULL, 10) : 64;
+  char delimiters[] = " \t\n\"\':=;";
+  char *config = make_config(megabytes * 1024 * 1024);
+  if (config == NULL) {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+  size_t length = strlen(config);
+
+  double start = now();
+  size_t tokens = count_strspn(config, delimiters);
+  report("strspn", length, tokens, now() - start);
+
+  delim_set_t delims;
+  delim_init_table(&delims, delimiters);
+  start = now();
+  tokens = count_scan(&delims, config, length);
+  report("table", length, tokens, now() - start);
+
+  delim_init(&delims, delimiters);
+  start = now();
+  tokens = count_scan(&delims, config, length);
+  report(delim_scanner(), length, tokens, now() - start);
+
+  free(config);
+  return 0;
+}
@@ -0,0 +1,77 @@
+//===---------------------------------------------------*- C -*---===
+//: gen_config.c
+//
+// DESCRIPTION
+// Writes a synthetic configuration file to STDOUT for the benchmarks:
+// rc.conf style (`name="value"` lines, comments and blank lines) or
+// jail.conf style (`name { param = "value"; ... }` blocks).
+//
+// USAGE
+//      gen_config [-j] keys > file.conf
+//
+// `keys` is the number of key lines (100 to 10000000 or more). Either
+// style has one `bench_key` line half way through the file, which the
+// benchmarks look up and change; its value is "alpha beta gamma".
+// The output only depends on the arguments.
+//===-------------------------------------------------------------===
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//------------------------------------------------------*- C -*------
+// rc_line
+//      One rc.conf style line for key number `i`.
+//-------------------------------------------------------------------
+static void rc_line(unsigned long i) {
+  if (i % 50 == 0)
+    printf("\n# --- section %lu ---\n", i / 50);
+  switch (i % 4) {
+    case 0:  printf("service%lu_enable=\"YES\"\n", i); break;
+    case 1:  printf("service%lu_flags=\"-a -b --level=%lu\"\n", i, i % 7); break;
+    case 2:  printf("ifconfig_em%lu=\"inet 10.%lu.%lu.%lu netmask 255.255.255.0\"\n",
+                    i, (i >> 16) & 255, (i >> 8) & 255, i & 255); break;
+    default: printf("cloned_interfaces_%lu=\"bridge0 tap%lu tap%lu\"\t# %lu\n", i, i, i + 1, i); break;
+  }
+}
+
+//------------------------------------------------------*- C -*------
+// jail_line
+//      One jail.conf style line for key number `i` (six parameters a
+//      jail).
+//-------------------------------------------------------------------
+static void jail_line(unsigned long i) {
+  unsigned long jail = i / 6;
+  switch (i % 6) {
+    case 0:  printf("jail%lu {\n    host.hostname = \"jail%lu.example.org\";\n", jail, jail); break;
+    case 1:  printf("    path = \"/usr/local/jails/jail%lu\";\n", jail); break;
+    case 2:  printf("    ip4.addr = \"em0|10.%lu.%lu.%lu/24\";\n",
+                    (jail >> 16) & 255, (jail >> 8) & 255, jail & 255); break;
+    case 3:  printf("    exec.start = \"/bin/sh /etc/rc\";\n"); break;
+    case 4:  printf("    exec.stop = \"/bin/sh /etc/rc.shutdown jail\";\n"); break;
+    default: printf("    mount.devfs;\n}\n"); break;
+  }
+}
+
+int main(int argc, char *argv[]) {
+  int jail = argc > 1 && strcmp(argv[1], "-j") == 0;
+  if (argc != 2 + jail) {
+    fprintf(stderr, "Usage: %s [-j] keys\n", argv[0]);
+    return 1;
+  }
+  unsigned long keys = strtoul(argv[1 + jail], NULL, 10);
+
+  printf("# Generated by gen_config (%s style, %lu keys)\n", jail ? "jail.conf" : "rc.conf", keys);
+  for (unsigned long i = 0; i < keys; i++) {
+    // (between jails, for jail.conf)
+    if (i == keys / 2 - (jail ? (keys / 2) % 6 : 0))
+      printf("bench_key = \"alpha beta gamma\";\n");
+    if (jail)
+      jail_line(i);
+    else
+      rc_line(i);
+  }
+  if (jail && keys % 6 != 0)
+    printf("}\n");
+  return 0;
+}
@@ -0,0 +1,106 @@
+#include "arena.h"
+#include "stats.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_ALIGN     (sizeof(void *))                /* alignment of every allocation */
+
+// A block of arena memory; the usable bytes follow the header.
+struct arena_block {
+    arena_block_t *next;                                /* previously filled block */
+    size_t size;                                        /* usable bytes in this block */
+    size_t used;                                        /* bytes handed out so far */
+};
+
+/**
+ *: arena_init
+ * @brief               Set up an empty arena.
+ *
+ * @param arena         The arena to initialize.
+ * @param block_size    Size of the first block (later blocks double).
+ */
+void arena_init(arena_t *arena, size_t block_size) {
+    arena->head = NULL;
+    arena->block_size = block_size ? block_size : 4096;
+    arena->blocks = 0;
+    arena->allocs = 0;
+    arena->bytes = 0;
+}
+
+/**
+ *: arena_alloc
+ * @brief               Allocate memory from the arena.
+ *
+ * @param arena         The arena to allocate from.
+ * @param size          The number of bytes wanted.
+ *
+ * @return void*        Pointer aligned memory, or NULL on error.
+ */
+void *arena_alloc(arena_t *arena, size_t size) {
+    size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+
+    arena_block_t *block = arena->head;
+    if (block == NULL || block->size - block->used < size) {
+        size_t block_size = arena->block_size;
+        while (block_size < size) block_size *= 2;
+
+        block = malloc(sizeof(arena_block_t) + block_size);
+        if (block == NULL) {
+            return NULL;
+        }
+        block->next = arena->head;
+        block->size = block_size;
+        block->used = 0;
+        arena->head = block;
+        arena->block_size = block_size * 2;
+        arena->blocks++;
+        stats.allocations++;
+        stats.allocated_bytes += sizeof(arena_block_t) + block_size;
+    }
+
+    void *ptr = (char *)(block + 1) + block->used;
+    block->used += size;
+    arena->allocs++;
+    arena->bytes += size;
+    return ptr;
+}
+
+/**
+ *: arena_strndup
+ * @brief               Copy a string into the arena.
+ *
+ * @param arena         The arena to allocate from.
+ * @param string        The characters to copy.
+ * @param length        The number of characters to copy.
+ *
+ * @return char*        The nul-terminated copy, or NULL on error.
+ */
+char *arena_strndup(arena_t *arena, const char *string, size_t length) {
+    char *copy = arena_alloc(arena, length + 1);
+    if (copy == NULL) {
+        return NULL;
+    }
+    memcpy(copy, string, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+/**
+ *: arena_free
+ * @brief               Release every block held by the arena.
+ *
+ * @param arena         The arena to release.
+ */
+void arena_free(arena_t *arena) {
+    arena_block_t *block = arena->head;
+    while (block) {
+        arena_block_t *next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->head = NULL;
+    arena->blocks = 0;
+    arena->allocs = 0;
+    arena->bytes = 0;
+}
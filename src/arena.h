@@ -0,0 +1,49 @@
+/**
+ * This code is a simple region (arena) allocator.
+ *
+ * Memory is carved out of a few large blocks and handed back all at
+ * once with `arena_free()`; there is no way to free a single
+ * allocation. The parser uses one arena per parsed file so that the
+ * tokens and the per-line pointer arrays cost a handful of
+ * `malloc()` calls instead of one (or more) per token.
+ *
+ *      arena_t arena;
+ *      arena_init(&arena, 64 * 1024);
+ *      char *copy = arena_strndup(&arena, "value", 5);
+ *      ...
+ *      arena_free(&arena);             // releases `copy` and friends
+ */
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+typedef struct arena_block arena_block_t;
+
+// Arena state
+typedef struct {
+    arena_block_t *head;                                /* block currently being carved up */
+    size_t block_size;                                  /* size of the next block to allocate */
+    size_t blocks;                                      /* number of blocks malloc()'d */
+    size_t allocs;                                      /* number of allocations served */
+    size_t bytes;                                       /* number of bytes handed out */
+} arena_t;
+
+//: arena_init
+//      Set up an empty arena whose first block will be `block_size`
+//      bytes (later blocks double in size).
+void arena_init(arena_t *arena, size_t block_size);
+
+//: arena_alloc
+//      Allocate `size` bytes (pointer aligned) from the arena.
+void *arena_alloc(arena_t *arena, size_t size);
+
+//: arena_strndup
+//      Copy `length` bytes of `string` into the arena and nul-terminate it.
+char *arena_strndup(arena_t *arena, const char *string, size_t length);
+
+//: arena_free
+//      Release every block held by the arena.
+void arena_free(arena_t *arena);
+
+#endif /* ARENA_H */
@@ -0,0 +1,416 @@
+#include "cache-config.h"
+#include "config-index.h"
+#include "parse-config.h"
+#include "delim-scan.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#define CACHE_MAGIC     "SYSCONF\001"
+
+// Nanoseconds part of a file's modification time.
+#if defined(__APPLE__)
+#define MTIME_NSEC(st)  ((st).st_mtimespec.tv_nsec)
+#else
+#define MTIME_NSEC(st)  ((st).st_mtim.tv_nsec)
+#endif
+
+/**
+ *: cache_name
+ * @brief               Builds the name of the cache for a file.
+ *
+ * @param filename      The config file.
+ *
+ * @return char*        The malloc'd cache file name, or NULL on error.
+ */
+static char *cache_name(const char *filename) {
+    size_t length = strlen(filename);
+    char *name = malloc(length + sizeof(CACHE_SUFFIX));
+    if (name != NULL) {
+        memcpy(name, filename, length);
+        memcpy(name + length, CACHE_SUFFIX, sizeof(CACHE_SUFFIX));
+    }
+    return name;
+}
+
+/**
+ *: content_hash
+ * @brief               Hashes a file's contents (FNV-1a style, eight
+ *                      bytes at a time).
+ *
+ * @param data          The contents.
+ * @param length        The number of bytes.
+ *
+ * @return uint64_t     The hash value.
+ */
+static uint64_t content_hash(const char *data, size_t length) {
+    uint64_t hash = 14695981039346656037ull;
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        hash = (hash ^ word) * 1099511628211ull;
+    }
+    for (; i < length; i++) {
+        hash = (hash ^ (unsigned char)data[i]) * 1099511628211ull;
+    }
+    return hash ^ length;
+}
+
+/**
+ *: write_cache
+ * @brief               Builds the cache for a config file.
+ *
+ * Every line the parser would read is recorded as an entry (its token
+ * spans); the key index points at the first entry for each key. The
+ * cache is written to a temporary file and renamed into place.
+ *
+ * @param filename      The config file.
+ * @param delimiters    The delimiters to tokenize with.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int write_cache(const char *filename, const char *delimiters) {
+    file_buffer_t source;
+    struct stat st;
+    if (strlen(delimiters) >= sizeof(((cache_header_t *)0)->delimiters)) {
+        return -1;
+    }
+    if (load_file_stat(filename, &source, &st) < 0) {
+        return -1;
+    }
+    if (!S_ISREG(st.st_mode)) {                         /* nothing to validate a pipe against */
+        unload_file(&source);
+        return -1;
+    }
+
+    delim_set_t delims;
+    delim_init(&delims, delimiters);
+
+    size_t entry_capacity = 64, token_capacity = 256;
+    size_t entry_count = 0, token_count = 0;
+    cache_entry_t *entries = malloc(entry_capacity * sizeof(cache_entry_t));
+    cache_token_t *tokens = malloc(token_capacity * sizeof(cache_token_t));
+    int span_capacity = 16;
+    span_t *spans = malloc(span_capacity * sizeof(span_t));
+    config_slot_t *slots = NULL;
+    char *name = cache_name(filename);
+    char *temp = NULL;
+    int rc = -1;
+    if (!entries || !tokens || !spans || !name) {
+        goto done;
+    }
+
+    // Record the token spans of every line.
+    const char *pos = source.data;
+    const char *end = source.data + source.length;
+    const char *line_end;
+    const char *str;
+    while ((str = next_config_line(&pos, end, &line_end)) != NULL) {
+        int n = span_tokens(str, line_end - str, &delims, spans, span_capacity);
+        if (n > span_capacity) {
+            span_t *grown = realloc(spans, n * sizeof(span_t));
+            if (grown == NULL)
+                goto done;
+            spans = grown;
+            span_capacity = n;
+            span_tokens(str, line_end - str, &delims, spans, span_capacity);
+        }
+        if (n == 0)
+            continue;
+
+        if (entry_count == entry_capacity) {
+            cache_entry_t *grown = realloc(entries, entry_capacity * 2 * sizeof(cache_entry_t));
+            if (grown == NULL)
+                goto done;
+            entries = grown;
+            entry_capacity *= 2;
+        }
+        while (token_count + n > token_capacity) {
+            cache_token_t *grown = realloc(tokens, token_capacity * 2 * sizeof(cache_token_t));
+            if (grown == NULL)
+                goto done;
+            tokens = grown;
+            token_capacity *= 2;
+        }
+
+        entries[entry_count].first_token = token_count;
+        entries[entry_count].token_count = (uint32_t)n;
+        entries[entry_count].reserved = 0;
+        entry_count++;
+        for (int i = 0; i < n; i++) {
+            tokens[token_count].offset = (str - source.data) + spans[i].offset;
+            tokens[token_count].length = spans[i].length;
+            token_count++;
+        }
+    }
+
+    // Index the first entry for each key.
+    size_t slot_count = 16;
+    while (slot_count < entry_count * 2) slot_count *= 2;
+    if ((slots = calloc(slot_count, sizeof(config_slot_t))) == NULL) {
+        goto done;
+    }
+    for (size_t e = 0; e < entry_count; e++) {
+        const cache_token_t *key = &tokens[entries[e].first_token];
+        uint32_t hash = config_hash(source.data + key->offset, key->length);
+        size_t slot = hash & (slot_count - 1);
+        while (slots[slot].entry != 0) {
+            const cache_token_t *other = &tokens[entries[slots[slot].entry - 1].first_token];
+            if (slots[slot].hash == hash && other->length == key->length && \
+                memcmp(source.data + other->offset, source.data + key->offset, key->length) == 0)
+                break;
+            slot = (slot + 1) & (slot_count - 1);
+        }
+        if (slots[slot].entry == 0) {
+            slots[slot].hash = hash;
+            slots[slot].entry = (uint32_t)e + 1;
+        }
+    }
+
+    cache_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+    header.dev = (uint64_t)st.st_dev;
+    header.ino = (uint64_t)st.st_ino;
+    header.size = (uint64_t)st.st_size;
+    header.mtime_sec = (int64_t)st.st_mtime;
+    header.mtime_nsec = (int64_t)MTIME_NSEC(st);
+    header.hash = content_hash(source.data, source.length);
+    strcpy(header.delimiters, delimiters);
+    header.slot_count = (uint32_t)slot_count;
+    header.entry_count = (uint32_t)entry_count;
+    header.token_count = token_count;
+
+    // Write to a temporary file next to the cache and rename it over.
+    if ((temp = malloc(strlen(name) + sizeof(".XXXXXX"))) == NULL) {
+        goto done;
+    }
+    strcpy(temp, name);
+    strcat(temp, ".XXXXXX");
+    int fd = mkstemp(temp);
+    if (fd < 0) {
+        goto done;
+    }
+    fchmod(fd, st.st_mode & 0666);
+    FILE *out = fdopen(fd, "w");
+    if (out == NULL) {
+        close(fd);
+        unlink(temp);
+        goto done;
+    }
+    fwrite(&header, sizeof(header), 1, out);
+    fwrite(slots, sizeof(config_slot_t), slot_count, out);
+    fwrite(entries, sizeof(cache_entry_t), entry_count, out);
+    fwrite(tokens, sizeof(cache_token_t), token_count, out);
+    if (fclose(out) != 0 || rename(temp, name) < 0) {
+        unlink(temp);
+        goto done;
+    }
+    rc = 0;
+
+done:
+    free(entries);
+    free(tokens);
+    free(spans);
+    free(slots);
+    free(name);
+    free(temp);
+    unload_file(&source);
+    return rc;
+}
+
+/**
+ *: cache_layout
+ * @brief               Finds the tables of a mapped cache.
+ *
+ * @param cache         The mapped cache file.
+ * @param slots         Set to the key index.
+ * @param entries       Set to the entries.
+ * @param tokens        Set to the tokens.
+ *
+ * @return 0 if the file is a well formed cache, -1 otherwise.
+ */
+static int cache_layout(const file_buffer_t *cache, const config_slot_t **slots,
+                        const cache_entry_t **entries, const cache_token_t **tokens) {
+    const cache_header_t *header = (const cache_header_t *)cache->data;
+    if (cache->length < sizeof(cache_header_t) || \
+        memcmp(header->magic, CACHE_MAGIC, sizeof(header->magic)) != 0 || \
+        header->slot_count == 0 || (header->slot_count & (header->slot_count - 1)) != 0) {
+        return -1;
+    }
+
+    uint64_t expected = sizeof(cache_header_t) + \
+                        (uint64_t)header->slot_count * sizeof(config_slot_t) + \
+                        (uint64_t)header->entry_count * sizeof(cache_entry_t) + \
+                        header->token_count * sizeof(cache_token_t);
+    if (expected != cache->length) {
+        return -1;
+    }
+
+    *slots = (const config_slot_t *)(header + 1);
+    *entries = (const cache_entry_t *)(*slots + header->slot_count);
+    *tokens = (const cache_token_t *)(*entries + header->entry_count);
+    return 0;
+}
+
+/**
+ *: open_cache
+ * @brief               Maps and validates the cache for a config file.
+ *
+ * @param filename      The config file.
+ * @param delimiters    The delimiters the caller tokenizes with.
+ * @param cache         Filled with the mapped cache and source file.
+ *
+ * @return 0 if the cache can be used, -1 if it is missing or stale.
+ */
+int open_cache(const char *filename, const char *delimiters, config_cache_t *cache) {
+    const config_slot_t *slots;
+    const cache_entry_t *entries;
+    const cache_token_t *tokens;
+    struct stat st;
+    char *name = cache_name(filename);
+
+    cache->cache.data = cache->source.data = NULL;
+    cache->cache.length = cache->source.length = 0;
+    cache->cache.mapped = cache->source.mapped = 0;
+    if (name == NULL || load_file(name, &cache->cache) < 0) {
+        free(name);
+        return -1;
+    }
+    free(name);
+
+    const cache_header_t *header = (const cache_header_t *)cache->cache.data;
+    if (cache_layout(&cache->cache, &slots, &entries, &tokens) < 0 || \
+        strncmp(header->delimiters, delimiters, sizeof(header->delimiters)) != 0) {
+        close_cache(cache);
+        return -1;
+    }
+
+    // The source file must be the one the cache was built from ...
+    if (load_file_stat(filename, &cache->source, &st) < 0 || \
+        header->dev != (uint64_t)st.st_dev || \
+        header->ino != (uint64_t)st.st_ino || \
+        header->size != (uint64_t)st.st_size || \
+        header->size != cache->source.length || \
+        header->mtime_sec != (int64_t)st.st_mtime || \
+        header->mtime_nsec != (int64_t)MTIME_NSEC(st)) {
+        close_cache(cache);
+        return -1;
+    }
+
+    // ... with the same contents. (The tokens a lookup returns are
+    // checked by `cache_get()`.)
+    if (header->hash != content_hash(cache->source.data, cache->source.length)) {
+        close_cache(cache);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ *: token_inside
+ * @brief               Tells if a cached token lies inside the source
+ *                      file.
+ *
+ * @param header        The cache header.
+ * @param token         The token.
+ *
+ * @return 1 if it does, 0 if the cache is damaged.
+ */
+static int token_inside(const cache_header_t *header, const cache_token_t *token) {
+    return token->offset <= header->size && token->length <= header->size - token->offset;
+}
+
+/**
+ *: cache_get
+ * @brief               Finds a key in an open cache.
+ *
+ * @param cache         An open cache (see `open_cache()`).
+ * @param key           The key to find (exact match).
+ * @param tokens        Set to the key's tokens (the key first).
+ *
+ * @return int          The number of tokens, or 0 if not found (or the
+ *                      entry is damaged; its tokens are checked to lie
+ *                      inside the source file).
+ */
+int cache_get(config_cache_t *cache, const char *key, const cache_token_t **tokens) {
+    const cache_header_t *header = (const cache_header_t *)cache->cache.data;
+    const config_slot_t *slots;
+    const cache_entry_t *entries;
+    const cache_token_t *all;
+    cache_layout(&cache->cache, &slots, &entries, &all);
+
+    size_t length = strlen(key);
+    uint32_t hash = config_hash(key, length);
+    size_t mask = header->slot_count - 1;
+    size_t slot = hash & mask;
+    for (uint32_t probe = 0; probe < header->slot_count && slots[slot].entry != 0; probe++) {
+        uint32_t e = slots[slot].entry - 1;
+        if (slots[slot].hash == hash && e < header->entry_count && \
+            entries[e].first_token + entries[e].token_count <= header->token_count) {
+            const cache_token_t *first = &all[entries[e].first_token];
+            if (token_inside(header, first) && first->length == length && \
+                memcmp(cache->source.data + first->offset, key, length) == 0) {
+                for (uint32_t t = 1; t < entries[e].token_count; t++) {
+                    if (!token_inside(header, &first[t]))
+                        return 0;
+                }
+                *tokens = first;
+                return (int)entries[e].token_count;
+            }
+        }
+        slot = (slot + 1) & mask;
+    }
+    return 0;
+}
+
+/**
+ *: close_cache
+ * @brief               Unmaps an open cache.
+ *
+ * @param cache         The cache to close.
+ */
+void close_cache(config_cache_t *cache) {
+    unload_file(&cache->cache);
+    unload_file(&cache->source);
+}
+
+/**
+ *: refresh_cache
+ * @brief               Rebuilds the cache for a config file, if there
+ *                      is one, after the file has been changed.
+ *
+ * @param filename      The config file.
+ */
+void refresh_cache(const char *filename) {
+    char *name = cache_name(filename);
+    if (name == NULL) {
+        return;
+    }
+
+    cache_header_t header;
+    int fd = open(name, O_RDONLY);
+    if (fd < 0) {                                       /* no cache; nothing to do */
+        free(name);
+        return;
+    }
+    ssize_t n = read(fd, &header, sizeof(header));
+    close(fd);
+
+    // Rebuild with the delimiters it was built with; a cache that
+    // cannot be rebuilt is removed so it cannot go stale.
+    if (n != (ssize_t)sizeof(header) || \
+        memcmp(header.magic, CACHE_MAGIC, sizeof(header.magic)) != 0 || \
+        memchr(header.delimiters, '\0', sizeof(header.delimiters)) == NULL || \
+        write_cache(filename, header.delimiters) < 0) {
+        unlink(name);
+    }
+    free(name);
+}
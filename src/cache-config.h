@@ -0,0 +1,103 @@
+/**
+ * This code keeps a compiled copy of a parsed configuration file's key
+ * index next to the file (`file.conf` -> `file.conf.sysconf-cache`) so
+ * a lookup can be answered without parsing the file at all.
+ *
+ * The cache is a flat binary file meant to be mapped with `mmap()`:
+ *
+ *      cache_header_t                  source file identity, sizes
+ *      config_slot_t[slot_count]       open-addressing key index
+ *      cache_entry_t[entry_count]      first occurrence of each key
+ *      cache_token_t[token_count]      token spans into the source
+ *
+ * The tokens are not copied into the cache; they are (offset, length)
+ * spans into the source file, which is mapped alongside. A cache is
+ * only used when the source file's device, inode, size and mtime
+ * match the header and a hash of its contents matches too, so a stale
+ * cache is never believed. That hash is a deliberate safety check, not
+ * free: `open_cache()` reads the whole source file (one pass, eight
+ * bytes at a time), so a cache hit costs time in proportion to the
+ * size of the file. What it saves is the tokenizing, the allocations
+ * and the index building of a parse. The tokens of a key are checked
+ * to lie inside the source file when `cache_get()` returns them. The cache is written to a temporary file
+ * and renamed into place, and `refresh_cache()` (called after the file
+ * is changed) rebuilds an existing cache the same way.
+ *
+ *      config_cache_t cache;
+ *      if (open_cache("rc.conf", delimiters, &cache) == 0) {
+ *          const cache_token_t *tokens;
+ *          int n = cache_get(&cache, "hostname", &tokens);
+ *          ...cache.source.data + tokens[i].offset...
+ *          close_cache(&cache);
+ *      } else {
+ *          write_cache("rc.conf", delimiters);
+ *      }
+ */
+#ifndef CACHE_CONFIG_H
+#define CACHE_CONFIG_H
+
+#include "read-config.h"
+
+#include <stdint.h>
+
+#define CACHE_SUFFIX    ".sysconf-cache"
+
+// Cache file header
+typedef struct {
+    char magic[8];                                      /* "SYSCONF" + format version */
+    uint64_t dev;                                       /* source file identity ... */
+    uint64_t ino;
+    uint64_t size;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    uint64_t hash;                                      /* ... and contents hash */
+    char delimiters[32];                                /* delimiters the cache was built with */
+    uint32_t slot_count;                                /* power of two */
+    uint32_t entry_count;
+    uint64_t token_count;
+} cache_header_t;
+
+// One key (the first line that has it)
+typedef struct {
+    uint64_t first_token;                               /* index into the token array */
+    uint32_t token_count;                               /* tokens, including the key */
+    uint32_t reserved;
+} cache_entry_t;
+
+// One token; a span of the source file
+typedef struct {
+    uint64_t offset;
+    uint64_t length;
+} cache_token_t;
+
+// An open (validated) cache
+typedef struct {
+    file_buffer_t cache;                                /* the mapped cache file */
+    file_buffer_t source;                               /* the mapped source file */
+} config_cache_t;
+
+//: write_cache
+//      Build the cache for `filename`. Returns 0 on success, -1 on error.
+int write_cache(const char *filename, const char *delimiters);
+
+//: open_cache
+//      Map and validate the cache for `filename`. Returns 0 if the
+//      cache can be used, -1 if it is missing or stale.
+int open_cache(const char *filename, const char *delimiters, config_cache_t *cache);
+
+//: cache_get
+//      Find `key`; sets `tokens` to its tokens (key first) and returns
+//      their number, or returns 0 if the key is not in the file (or
+//      its entry is damaged).
+int cache_get(config_cache_t *cache, const char *key, const cache_token_t **tokens);
+
+//: close_cache
+//      Unmap an open cache.
+void close_cache(config_cache_t *cache);
+
+//: refresh_cache
+//      Rebuild the cache for `filename` if there is one (after the
+//      file has been changed).
+void refresh_cache(const char *filename);
+
+#endif /* CACHE_CONFIG_H */
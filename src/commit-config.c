@@ -0,0 +1,282 @@
+#include "commit-config.h"
+#include "print-config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+// The states of a queue entry
+enum {
+    QUEUE_WAITING = 1,                                  /* the change is not made yet */
+    QUEUE_DONE,                                         /* made; the result is waiting for its writer */
+    QUEUE_TAKEN                                         /* the writer has its result */
+};
+
+// A change in the queue
+typedef struct {
+    int32_t state;
+    int32_t status;                                     /* exit status of the change */
+    int64_t pid;                                        /* the writer */
+    char argument[QUEUE_ARGUMENT];
+    char output[QUEUE_REPORT];                          /* its change report */
+    char errors[QUEUE_REPORT];                          /* and its problems */
+} queue_entry_t;
+
+/**
+ *: queue_lock
+ * @brief               Takes (or releases) the lock of the queue; it is
+ *                      only held while the queue is read or written.
+ *
+ * @param queue         The queue file.
+ * @param operation     LOCK_EX or LOCK_UN.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int queue_lock(int queue, int operation) {
+    int rc;
+    while ((rc = flock(queue, operation)) < 0 && errno == EINTR)
+        ;
+    return rc;
+}
+
+/**
+ *: queue_add
+ * @brief               Adds a change to the end of the queue.
+ *
+ * @param queue         The queue file.
+ * @param argument      The change.
+ *
+ * @return off_t        Where the entry is, or -1 on error.
+ */
+static off_t queue_add(int queue, const char *argument) {
+    queue_entry_t entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.state = QUEUE_WAITING;
+    entry.pid = (int64_t)getpid();
+    strcpy(entry.argument, argument);
+
+    if (queue_lock(queue, LOCK_EX) < 0)
+        return -1;
+    off_t offset = lseek(queue, 0, SEEK_END);
+    offset -= offset % (off_t)sizeof(entry);            /* (past a torn entry) */
+    if (offset < 0 || pwrite(queue, &entry, sizeof(entry), offset) != (ssize_t)sizeof(entry))
+        offset = -1;
+    queue_lock(queue, LOCK_UN);
+    return offset;
+}
+
+/**
+ *: writer_gone
+ * @brief               Tells if the process that queued an entry has
+ *                      exited (so nobody is waiting for it).
+ */
+static int writer_gone(const queue_entry_t *entry) {
+    return kill((pid_t)entry->pid, 0) < 0 && errno == ESRCH;
+}
+
+/**
+ *: make_change
+ * @brief               Makes one queued change, keeping its report and
+ *                      problems in the entry.
+ *
+ * @param entry         The entry.
+ * @param filename      The config file.
+ * @param delimiters    Tokenizer delimiters.
+ */
+static void make_change(queue_entry_t *entry, const char *filename, char *delimiters) {
+    memset(entry->output, 0, sizeof(entry->output));
+    memset(entry->errors, 0, sizeof(entry->errors));
+    FILE *out = fmemopen(entry->output, sizeof(entry->output) - 1, "w");
+    FILE *errors = fmemopen(entry->errors, sizeof(entry->errors) - 1, "w");
+    if (out == NULL || errors == NULL) {
+        strcpy(entry->errors, "Unable to make the change: out of memory\n");
+        entry->status = 1;
+    } else {
+        FILE *previous = set_change_output(out);
+        entry->argument[QUEUE_ARGUMENT - 1] = '\0';
+        entry->status = changevariable(entry->argument, filename, delimiters, errors);
+        set_change_output(previous);
+    }
+    if (out != NULL) fclose(out);
+    if (errors != NULL) fclose(errors);
+    entry->state = QUEUE_DONE;
+}
+
+/**
+ *: make_queued
+ * @brief               Makes every change that is waiting in the queue
+ *                      in one batch (the lock of the config file must
+ *                      be held) and posts the results.
+ *
+ * @param queue         The queue file.
+ * @param filename      The config file.
+ * @param delimiters    Tokenizer delimiters.
+ *
+ * @return 0 on success, -1 if the queue could not be read or written.
+ */
+static int make_queued(int queue, const char *filename, char *delimiters) {
+    // -Take the waiting entries; writers may keep adding to the queue
+    //  while they are made (those are left for the next batch).
+    struct stat st;
+    if (queue_lock(queue, LOCK_EX) < 0 || fstat(queue, &st) < 0) {
+        queue_lock(queue, LOCK_UN);
+        return -1;
+    }
+    size_t count = (size_t)st.st_size / sizeof(queue_entry_t);
+    queue_entry_t *entries = malloc((count ? count : 1) * sizeof(queue_entry_t));
+    if (entries == NULL || \
+        pread(queue, entries, count * sizeof(queue_entry_t), 0) != (ssize_t)(count * sizeof(queue_entry_t))) {
+        queue_lock(queue, LOCK_UN);
+        free(entries);
+        return -1;
+    }
+    queue_lock(queue, LOCK_UN);
+
+    int batch = begin_changes(filename);
+    for (size_t i = 0; i < count; i++) {
+        queue_entry_t *entry = &entries[i];
+        if (entry->state != QUEUE_WAITING)
+            continue;
+        if (writer_gone(entry)) {
+            entry->state = QUEUE_TAKEN;                 /* nobody to make it for */
+        } else if (batch < 0) {
+            snprintf(entry->errors, sizeof(entry->errors), "Unable to lock %s: %s\n",
+                     filename, strerror(errno));
+            entry->status = 1;
+            entry->state = QUEUE_DONE;
+        } else {
+            make_change(entry, filename, delimiters);
+        }
+    }
+    if (batch == 0 && end_changes() < 0) {
+        for (size_t i = 0; i < count; i++) {
+            if (entries[i].state == QUEUE_DONE) {
+                snprintf(entries[i].errors, sizeof(entries[i].errors), "Unable to write %s\n", filename);
+                entries[i].status = 1;
+            }
+        }
+    }
+
+    // -Post the results (only the entries this batch took are written;
+    //  the ones added since are still waiting).
+    int rc = 0;
+    queue_lock(queue, LOCK_EX);
+    for (size_t i = 0; i < count; i++) {
+        if (entries[i].state == QUEUE_DONE || entries[i].state == QUEUE_TAKEN) {
+            off_t offset = (off_t)(i * sizeof(queue_entry_t));
+            if (pwrite(queue, &entries[i], sizeof(queue_entry_t), offset) != (ssize_t)sizeof(queue_entry_t))
+                rc = -1;
+        }
+    }
+    queue_lock(queue, LOCK_UN);
+    free(entries);
+    return rc;
+}
+
+/**
+ *: take_result
+ * @brief               Reads a writer's result from the queue, marks it
+ *                      taken, and removes the queue once every writer
+ *                      has its result.
+ *
+ * @param queue         The queue file.
+ * @param queue_name    Its name.
+ * @param offset        The writer's entry.
+ * @param entry         Filled with the entry.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int take_result(int queue, const char *queue_name, off_t offset, queue_entry_t *entry) {
+    if (queue_lock(queue, LOCK_EX) < 0)
+        return -1;
+    int rc = -1;
+    if (pread(queue, entry, sizeof(*entry), offset) == (ssize_t)sizeof(*entry) && \
+        entry->state == QUEUE_DONE) {
+        int32_t taken = QUEUE_TAKEN;
+        if (pwrite(queue, &taken, sizeof(taken), offset) == (ssize_t)sizeof(taken))
+            rc = 0;
+    }
+
+    // -Is anybody still waiting?
+    queue_entry_t other;
+    int waiting = 0;
+    for (off_t at = 0; !waiting && pread(queue, &other, sizeof(other), at) == (ssize_t)sizeof(other);
+         at += sizeof(other)) {
+        if (other.state != QUEUE_TAKEN && !writer_gone(&other))
+            waiting = 1;
+    }
+    if (!waiting)
+        unlink(queue_name);                             /* (a writer still holding it is its own leader) */
+    queue_lock(queue, LOCK_UN);
+    return rc;
+}
+
+/**
+ *: commit_change
+ * @brief               Makes a change to a config file, batched with
+ *                      the changes other writers queued for it.
+ *
+ * @param filename      The config file.
+ * @param argument      The `key=value` (`+=`, `-=`) argument.
+ * @param delimiters    Tokenizer delimiters.
+ * @param out           The stream the change is reported on.
+ * @param errors        The stream problems are reported on.
+ *
+ * @return int          The exit status (see `changevariable()`).
+ */
+int commit_change(const char *filename, const char *argument, char *delimiters,
+                  FILE *out, FILE *errors) {
+    size_t size = strlen(filename) + sizeof(QUEUE_SUFFIX);
+    char *queue_name = malloc(size);
+    int queue = -1;
+    off_t offset = -1;
+    if (queue_name != NULL && strlen(argument) < QUEUE_ARGUMENT) {
+        snprintf(queue_name, size, "%s%s", filename, QUEUE_SUFFIX);
+        queue = open(queue_name, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+        if (queue >= 0)
+            offset = queue_add(queue, argument);
+    }
+
+    // -The lock is where writers queue up.
+    if (lock_config(filename) < 0) {
+        fprintf(errors, "Unable to lock %s: %s\n", filename, strerror(errno));
+        if (queue >= 0) close(queue);
+        free(queue_name);
+        return 1;
+    }
+
+    int status;
+    queue_entry_t entry;
+    if (offset < 0) {
+        // -No queue; make the change alone.
+        FILE *previous = set_change_output(out);
+        status = changevariable(argument, filename, delimiters, errors);
+        set_change_output(previous);
+    } else if (pread(queue, &entry, sizeof(entry), offset) == (ssize_t)sizeof(entry) && \
+               entry.state == QUEUE_DONE) {
+        // -Made by the writer before us.
+        status = take_result(queue, queue_name, offset, &entry) < 0 ? 1 : entry.status;
+        fputs(entry.output, out);
+        fputs(entry.errors, errors);
+    } else if (make_queued(queue, filename, delimiters) == 0 && \
+               take_result(queue, queue_name, offset, &entry) == 0) {
+        // -Our turn; made ours and those queued behind it.
+        status = entry.status;
+        fputs(entry.output, out);
+        fputs(entry.errors, errors);
+    } else {
+        fprintf(errors, "Unable to use the change queue %s\n", queue_name);
+        status = 1;
+    }
+
+    unlock_config();
+    if (queue >= 0) close(queue);
+    free(queue_name);
+    return status;
+}
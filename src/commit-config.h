@@ -0,0 +1,42 @@
+/**
+ * This code lets several processes change the same configuration file
+ * at the same time without losing a change, and without each of them
+ * rewriting the file.
+ *
+ * A writer adds its change to a queue kept next to the file
+ * (`file.sysconf-queue`) and then waits for the lock of the file (see
+ * `lock_config()`). Whoever gets the lock makes every change that is
+ * still queued--its own and those of the writers waiting behind it--in
+ * one batch (see `begin_changes()`), so the file is rewritten once, and
+ * posts each writer's result back to its entry. A writer that finds its
+ * change already made only prints the result.
+ *
+ *      writer A    queue, lock, make A B C, write the file, unlock
+ *      writer B    queue, wait ...................................., print B's result
+ *      writer C    queue, wait ...................................., print C's result
+ *
+ * The queue is removed once every writer has its result. Where it
+ * cannot be made (a read-only directory, an argument too long for an
+ * entry) the change is made alone, under the lock.
+ *
+ *      int status = commit_change("rc.conf", "sshd_enable=YES", delimiters,
+ *                                 stdout, stderr);
+ */
+#ifndef COMMIT_CONFIG_H
+#define COMMIT_CONFIG_H
+
+#include <stdio.h>
+
+#define QUEUE_SUFFIX    ".sysconf-queue"                /* the queue of a file */
+#define QUEUE_ARGUMENT  1024                            /* longest argument that is queued */
+#define QUEUE_REPORT    1024                            /* longest result kept for a writer */
+
+//: commit_change
+//      Make the change of a `key=value` (`+=`, `-=`) argument to
+//      `filename` (see `changevariable()`), together with the changes
+//      other writers queued for it. Prints the change report on `out`
+//      and problems on `errors`; returns the exit status.
+int commit_change(const char *filename, const char *argument, char *delimiters,
+                  FILE *out, FILE *errors);
+
+#endif /* COMMIT_CONFIG_H */
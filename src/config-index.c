@@ -0,0 +1,197 @@
+#include "config-index.h"
+#include "stats.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ *: config_hash
+ * @brief               Hash a key (32-bit FNV-1a).
+ *
+ * @param key           The characters to hash.
+ * @param length        The number of characters in `key`.
+ *
+ * @return uint32_t     The hash value.
+ */
+uint32_t config_hash(const char *key, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)key[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/**
+ *: same_key
+ * @brief               Compares the key of an entry with a key.
+ *
+ * @param key_of        Reads the keys.
+ * @param keys          The keys.
+ * @param entry         The entry number.
+ * @param key           The key to compare with.
+ * @param length        The length of `key`.
+ *
+ * @return 1 if they are the same, 0 otherwise.
+ */
+static int same_key(config_key_fn key_of, const void *keys, int entry,
+                    const char *key, size_t length) {
+    size_t entry_length;
+    const char *entry_key = key_of(keys, entry, &entry_length);
+    return entry_key != NULL && entry_length == length && memcmp(entry_key, key, length) == 0;
+}
+
+/**
+ *: config_index_build
+ * @brief               Index the first occurrence of every key.
+ *
+ * @param index         The index to build.
+ * @param key_of        Reads the keys.
+ * @param keys          The keys.
+ * @param count         The number of configuration entries.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int config_index_build(config_index_t *index, config_key_fn key_of, const void *keys, int count) {
+    return config_index_build_hashed(index, key_of, keys, count, NULL);
+}
+
+/**
+ *: config_index_build_hashed
+ * @brief               Index the first occurrence of every key, with
+ *                      the hashes already worked out (by the parser's
+ *                      worker threads).
+ *
+ * @param index         The index to build.
+ * @param key_of        Reads the keys.
+ * @param keys          The keys.
+ * @param count         The number of configuration entries.
+ * @param hashes        `config_hash()` of each key, or NULL to hash
+ *                      them here.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int config_index_build_hashed(config_index_t *index, config_key_fn key_of, const void *keys,
+                              int count, const uint32_t *hashes) {
+    size_t size = 16;
+    while (size < (size_t)count * 2) size *= 2;
+
+    index->slots = calloc(size, sizeof(config_slot_t));
+    stats.allocations++;
+    stats.allocated_bytes += size * sizeof(config_slot_t);
+    index->mask = size - 1;
+    index->probes = 0;
+    if (index->slots == NULL) {
+        return -1;
+    }
+
+    for (int i = 0; i < count; i++) {
+        size_t length;
+        const char *key = key_of(keys, i, &length);
+        if (key == NULL)
+            continue;
+
+        uint32_t hash = hashes ? hashes[i] : config_hash(key, length);
+        size_t slot = hash & index->mask;
+
+        // Walk to an empty slot; stop if the key is already indexed
+        // so the first occurrence keeps its place.
+        while (index->slots[slot].entry != 0) {
+            const config_slot_t *s = &index->slots[slot];
+            if (s->hash == hash && same_key(key_of, keys, s->entry - 1, key, length))
+                break;
+            slot = (slot + 1) & index->mask;
+        }
+        if (index->slots[slot].entry == 0) {
+            index->slots[slot].hash = hash;
+            index->slots[slot].entry = (uint32_t)i + 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ *: config_index_add
+ * @brief               Index one more entry (if its key is new).
+ *
+ * @param index         The index to add to.
+ * @param key_of        Reads the keys.
+ * @param keys          The keys.
+ * @param count         The number of configuration entries.
+ * @param entry         The entry number to add.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int config_index_add(config_index_t *index, config_key_fn key_of, const void *keys,
+                     int count, int entry) {
+    // Keep the table at most half full; rebuild it bigger if needed.
+    if ((size_t)count * 2 > index->mask + 1) {
+        config_index_t grown;
+        if (config_index_build(&grown, key_of, keys, count) < 0) {
+            return -1;
+        }
+        grown.probes = index->probes;
+        config_index_free(index);
+        *index = grown;
+        return 0;
+    }
+
+    size_t length;
+    const char *key = key_of(keys, entry, &length);
+    if (key == NULL) {
+        return 0;
+    }
+    uint32_t hash = config_hash(key, length);
+    size_t slot = hash & index->mask;
+    while (index->slots[slot].entry != 0) {
+        const config_slot_t *s = &index->slots[slot];
+        if (s->hash == hash && same_key(key_of, keys, s->entry - 1, key, length))
+            return 0;
+        slot = (slot + 1) & index->mask;
+    }
+    index->slots[slot].hash = hash;
+    index->slots[slot].entry = (uint32_t)entry + 1;
+    return 0;
+}
+
+/**
+ *: config_index_find
+ * @brief               Find the entry for a key.
+ *
+ * @param index         The index to search.
+ * @param key_of        Reads the keys the index was built from.
+ * @param keys          The keys.
+ * @param key           The key to look for (exact match).
+ *
+ * @return int          The entry number, or -1 if not found.
+ */
+int config_index_find(config_index_t *index, config_key_fn key_of, const void *keys,
+                      const char *key) {
+    size_t length = strlen(key);
+    uint32_t hash = config_hash(key, length);
+    size_t slot = hash & index->mask;
+
+    while (index->slots[slot].entry != 0) {
+        const config_slot_t *s = &index->slots[slot];
+        index->probes++;
+        stats.probes++;
+        if (s->hash == hash && same_key(key_of, keys, s->entry - 1, key, length))
+            return (int)s->entry - 1;
+        slot = (slot + 1) & index->mask;
+    }
+    index->probes++;
+    stats.probes++;
+    return -1;
+}
+
+/**
+ *: config_index_free
+ * @brief               Release the memory held by an index.
+ *
+ * @param index         The index to release.
+ */
+void config_index_free(config_index_t *index) {
+    free(index->slots);
+    index->slots = NULL;
+    index->mask = 0;
+}
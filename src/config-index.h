@@ -0,0 +1,74 @@
+/**
+ * This code builds an open-addressing hash index over the keys of a
+ * parsed configuration file so a key can be found without scanning
+ * every entry. The keys are read through a `config_key_fn`, so they
+ * can be C strings (`values[0]`) or spans of the loaded file.
+ *
+ * Only the first entry for each key is indexed, which keeps the
+ * "first occurrence wins" behaviour of the old linear scans. Slots
+ * hold the key's hash and the entry number; collisions are resolved
+ * with linear probing and the table is kept at most half full.
+ *
+ *      config_index_t index;
+ *      if (config_index_build(&index, key_of, file, count) == 0) {
+ *          int i = config_index_find(&index, key_of, file, "key");
+ *          if (i >= 0) ...config[i].values...
+ *          config_index_free(&index);
+ *      }
+ */
+#ifndef CONFIG_INDEX_H
+#define CONFIG_INDEX_H
+
+
+#include <stddef.h>
+#include <stdint.h>
+
+// A slot in the index
+typedef struct {
+    uint32_t hash;                                      /* hash of the key */
+    uint32_t entry;                                     /* entry number + 1; 0 = empty slot */
+} config_slot_t;
+
+// Key index
+typedef struct {
+    config_slot_t *slots;
+    size_t mask;                                        /* number of slots - 1 */
+    size_t probes;                                      /* slots visited by lookups */
+} config_index_t;
+
+// Returns the key of entry `entry` of `keys` and sets `*length`
+// (NULL if the entry has no key).
+typedef const char *(*config_key_fn)(const void *keys, int entry, size_t *length);
+
+//: config_hash
+//      Hash `length` bytes of `key`.
+uint32_t config_hash(const char *key, size_t length);
+
+//: config_index_build
+//      Index the first occurrence of every key of the `count` entries
+//      of `keys`. Returns 0 on success, -1 on error.
+int config_index_build(config_index_t *index, config_key_fn key_of, const void *keys, int count);
+
+//: config_index_build_hashed
+//      Like `config_index_build()` with the hash of every key already
+//      worked out (`hashes[i]`, 0 for an entry with no key).
+int config_index_build_hashed(config_index_t *index, config_key_fn key_of, const void *keys,
+                              int count, const uint32_t *hashes);
+
+//: config_index_add
+//      Index entry number `entry` of `keys` (which now has `count`
+//      entries), growing the index when needed.
+//      Returns 0 on success, -1 on error.
+int config_index_add(config_index_t *index, config_key_fn key_of, const void *keys,
+                     int count, int entry);
+
+//: config_index_find
+//      Find the entry for `key`. Returns the entry number, or -1.
+int config_index_find(config_index_t *index, config_key_fn key_of, const void *keys,
+                      const char *key);
+
+//: config_index_free
+//      Release the memory held by `index`.
+void config_index_free(config_index_t *index);
+
+#endif /* CONFIG_INDEX_H */
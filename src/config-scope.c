@@ -0,0 +1,368 @@
+#include "config-scope.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define SCOPE_MAX_DEPTH 64                              /* deeper blocks are not indexed */
+
+/**
+ *: scope_key
+ * @brief               Reads the full path of a node (for the index).
+ *
+ * @param keys          The scope index.
+ * @param entry         The node.
+ * @param length        Set to the length of the path.
+ *
+ * @return const char*  The path.
+ */
+static const char *scope_key(const void *keys, int entry, size_t *length) {
+    const config_scope_t *scope = keys;
+    *length = scope->nodes[entry].path_length;
+    return scope->paths + scope->nodes[entry].path;
+}
+
+/**
+ *: add_segment
+ * @brief               Finds (or adds) the child of a node for one
+ *                      path segment.
+ *
+ * @param scope         The scope index.
+ * @param parent        The parent node, or -1 for the top level.
+ * @param segment       The segment.
+ * @param length        The length of `segment`.
+ *
+ * @return int          The node, or -1 when out of memory.
+ */
+static int add_segment(config_scope_t *scope, int parent, const char *segment, size_t length) {
+    // Write the full path at the end of `paths`; it is kept only if the
+    // node is new.
+    size_t prefix = parent >= 0 ? scope->nodes[parent].path_length + 1 : 0;
+    size_t needed = scope->paths_length + prefix + length + 1;
+    if (needed > scope->paths_capacity) {
+        size_t capacity = scope->paths_capacity * 2;
+        while (capacity < needed) capacity *= 2;
+        char *grown = realloc(scope->paths, capacity);
+        if (grown == NULL)
+            return -1;
+        scope->paths = grown;
+        scope->paths_capacity = capacity;
+    }
+    char *path = scope->paths + scope->paths_length;
+    if (parent >= 0) {
+        memcpy(path, scope->paths + scope->nodes[parent].path, prefix - 1);
+        path[prefix - 1] = '.';
+    }
+    memcpy(path + prefix, segment, length);
+    path[prefix + length] = '\0';
+
+    int found = config_index_find(&scope->index, scope_key, scope, path);
+    if (found >= 0) {
+        return found;
+    }
+
+    if (scope->node_count == scope->node_capacity) {
+        scope_node_t *grown = realloc(scope->nodes, scope->node_capacity * 2 * sizeof(scope_node_t));
+        if (grown == NULL)
+            return -1;
+        scope->nodes = grown;
+        scope->node_capacity *= 2;
+    }
+    int id = scope->node_count++;
+    scope_node_t *node = &scope->nodes[id];
+    node->path = scope->paths_length;
+    node->path_length = prefix + length;
+    node->parent = parent;
+    node->first_child = node->last_child = node->next_sibling = -1;
+    node->line = node->open_line = node->close_line = -1;
+    scope->paths_length = needed;
+
+    int *last = parent >= 0 ? &scope->nodes[parent].last_child : &scope->last;
+    if (*last >= 0)
+        scope->nodes[*last].next_sibling = id;
+    else if (parent >= 0)
+        scope->nodes[parent].first_child = id;
+    else
+        scope->first = id;
+    *last = id;
+
+    if (config_index_add(&scope->index, scope_key, scope, scope->node_count, id) < 0)
+        return -1;
+    return id;
+}
+
+/**
+ *: add_path
+ * @brief               Finds (or adds) the nodes for a dotted key.
+ *
+ * @param scope         The scope index.
+ * @param parent        The block the key is in, or -1.
+ * @param key           The key.
+ * @param length        The length of `key`.
+ * @param node          Set to the node of the last segment (-1 for a
+ *                      key with no segments).
+ *
+ * @return 0 on success, -1 when out of memory.
+ */
+static int add_path(config_scope_t *scope, int parent, const char *key, size_t length, int *node) {
+    size_t start = 0;
+    *node = -1;
+    for (size_t i = 0; i <= length; i++) {
+        if (i < length && key[i] != '.')
+            continue;
+        if (i > start) {
+            *node = add_segment(scope, parent, key + start, i - start);
+            if (*node < 0)
+                return -1;
+            parent = *node;
+        }
+        start = i + 1;
+    }
+    return 0;
+}
+
+/**
+ *: close_block
+ * @brief               Closes the innermost open block; a block that
+ *                      is opened more than once keeps its first close.
+ *
+ * @param scope         The scope index.
+ * @param blocks        The open blocks.
+ * @param depth         The number of open blocks (updated).
+ * @param hidden        Open blocks too deep to index (updated).
+ * @param line          The line that closes it.
+ */
+static void close_block(config_scope_t *scope, const int *blocks, int *depth, int *hidden, int line) {
+    if (*hidden > 0) {
+        (*hidden)--;
+    } else if (*depth > 0) {
+        scope_node_t *node = &scope->nodes[blocks[--*depth]];
+        if (node->close_line < 0)
+            node->close_line = line;
+    }
+}
+
+/**
+ *: build_scope
+ * @brief               Indexes the blocks and dotted keys of a file.
+ *
+ * A line whose last token is `{` (or whose key ends with one) opens a
+ * block named by its key, a line starting with `}` closes it, and a
+ * `{` on a line of its own opens a block named by the line before.
+ *
+ * @param scope         The index to fill.
+ * @param syntax        The file's syntax tree (must stay loaded).
+ *
+ * @return 0 on success, -1 when out of memory.
+ */
+int build_scope(config_scope_t *scope, const config_syntax_t *syntax) {
+    memset(scope, 0, sizeof(*scope));
+    scope->syntax = syntax;
+    scope->first = scope->last = -1;
+    scope->paths_capacity = 4096;
+    scope->paths = malloc(scope->paths_capacity);
+    scope->node_capacity = 16;
+    scope->nodes = malloc(scope->node_capacity * sizeof(scope_node_t));
+    if (!scope->paths || !scope->nodes || \
+        config_index_build(&scope->index, scope_key, scope, 0) < 0) {
+        free_scope(scope);
+        return -1;
+    }
+
+    const char *data = syntax->buffer.data;
+    int blocks[SCOPE_MAX_DEPTH];                        /* the open blocks */
+    int depth = 0;
+    int hidden = 0;                                     /* open blocks past SCOPE_MAX_DEPTH */
+    int previous = -1;                                  /* node of the last entry line */
+    int previous_line = -1;
+    for (int l = 0; l < (int)syntax->line_count; l++) {
+        const syntax_line_t *line = &syntax->lines[l];
+        if (line->key.length == 0)
+            continue;
+        const char *key = data + line->key.offset;
+        size_t length = line->key.length;
+        const span_t *last = line->token_count ? \
+                             &syntax->tokens[line->first_token + line->token_count - 1] : NULL;
+        int parent = depth > 0 ? blocks[depth - 1] : -1;
+
+        if (key[0] == '}') {
+            close_block(scope, blocks, &depth, &hidden, l);
+            continue;
+        }
+
+        int opens = key[length - 1] == '{' || \
+                    (last != NULL && last->length == 1 && data[last->offset] == '{');
+        int closes = last != NULL && last->length == 1 && data[last->offset] == '}';
+        int node;
+        if (key[0] == '{' && length == 1) {
+            node = previous;                            /* `name` then `{` */
+            if (node >= 0 && scope->nodes[node].line == previous_line)
+                scope->nodes[node].line = -1;           /* (the name was not an entry) */
+        } else {
+            if (key[length - 1] == '{')
+                length--;
+            if (add_path(scope, parent, key, length, &node) < 0)
+                goto fail;
+        }
+        previous = node;
+        previous_line = l;
+        if (node < 0)
+            continue;
+
+        if (opens) {
+            if (scope->nodes[node].open_line < 0)
+                scope->nodes[node].open_line = l;
+            if (depth < SCOPE_MAX_DEPTH)
+                blocks[depth++] = node;
+            else
+                hidden++;
+        } else {
+            if (scope->nodes[node].line < 0)
+                scope->nodes[node].line = l;
+            if (closes)
+                close_block(scope, blocks, &depth, &hidden, l);
+        }
+    }
+    return 0;
+
+fail:
+    free_scope(scope);
+    return -1;
+}
+
+/**
+ *: find_scope
+ * @brief               Looks up a full path.
+ *
+ * @param scope         The scope index.
+ * @param path          The path (like `web.ip4.addr`).
+ *
+ * @return int          The node, or -1.
+ */
+int find_scope(config_scope_t *scope, const char *path) {
+    return config_index_find(&scope->index, scope_key, scope, path);
+}
+
+// The results of `match_scope()`
+typedef struct {
+    int *nodes;
+    int count;
+    int capacity;
+} scope_matches_t;
+
+/**
+ *: add_match
+ * @brief               Adds a node to the results if it has an entry.
+ *
+ * @return 0 on success, -1 when out of memory.
+ */
+static int add_match(const config_scope_t *scope, scope_matches_t *matches, int node) {
+    if (scope->nodes[node].line < 0)
+        return 0;
+    if (matches->count == matches->capacity) {
+        int capacity = matches->capacity ? matches->capacity * 2 : 16;
+        int *grown = realloc(matches->nodes, capacity * sizeof(int));
+        if (grown == NULL)
+            return -1;
+        matches->nodes = grown;
+        matches->capacity = capacity;
+    }
+    matches->nodes[matches->count++] = node;
+    return 0;
+}
+
+/**
+ *: match_below
+ * @brief               Adds a node and everything below it.
+ *
+ * @return 0 on success, -1 when out of memory.
+ */
+static int match_below(const config_scope_t *scope, scope_matches_t *matches, int node) {
+    if (add_match(scope, matches, node) < 0)
+        return -1;
+    for (int c = scope->nodes[node].first_child; c >= 0; c = scope->nodes[c].next_sibling) {
+        if (match_below(scope, matches, c) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+/**
+ *: match_nodes
+ * @brief               Matches the rest of a pattern against a list of
+ *                      sibling nodes.
+ *
+ * @param scope         The scope index.
+ * @param matches       The results.
+ * @param first         The first sibling.
+ * @param pattern       The rest of the pattern (no leading '.').
+ *
+ * @return 0 on success, -1 when out of memory.
+ */
+static int match_nodes(const config_scope_t *scope, scope_matches_t *matches, int first,
+                       const char *pattern) {
+    const char *dot = strchr(pattern, '.');
+    size_t length = dot ? (size_t)(dot - pattern) : strlen(pattern);
+    int any = length == 1 && pattern[0] == '*';
+
+    for (int c = first; c >= 0; c = scope->nodes[c].next_sibling) {
+        const scope_node_t *node = &scope->nodes[c];
+        size_t prefix = node->parent >= 0 ? scope->nodes[node->parent].path_length + 1 : 0;
+        const char *segment = scope->paths + node->path + prefix;
+        if (!any && (node->path_length - prefix != length || memcmp(segment, pattern, length) != 0))
+            continue;
+
+        int rc;
+        if (dot != NULL)
+            rc = match_nodes(scope, matches, node->first_child, dot + 1);
+        else if (any)
+            rc = match_below(scope, matches, c);
+        else
+            rc = add_match(scope, matches, c);
+        if (rc < 0)
+            return -1;
+    }
+    return 0;
+}
+
+/**
+ *: match_scope
+ * @brief               Finds the entries a pattern matches.
+ *
+ * @param scope         The scope index.
+ * @param pattern       The pattern (`*` = any segment, or everything
+ *                      below when last).
+ * @param nodes         Set to a malloc'd array of the nodes, or NULL.
+ *
+ * @return int          The number of nodes, or -1 when out of memory.
+ */
+int match_scope(config_scope_t *scope, const char *pattern, int **nodes) {
+    scope_matches_t matches = { NULL, 0, 0 };
+    *nodes = NULL;
+
+    // No wildcard; one probe.
+    if (strchr(pattern, '*') == NULL) {
+        int node = find_scope(scope, pattern);
+        if (node >= 0 && add_match(scope, &matches, node) < 0)
+            return -1;
+    } else if (match_nodes(scope, &matches, scope->first, pattern) < 0) {
+        free(matches.nodes);
+        return -1;
+    }
+    *nodes = matches.nodes;
+    return matches.count;
+}
+
+/**
+ *: free_scope
+ * @brief               Releases the index (not the syntax tree).
+ *
+ * @param scope         The index to release.
+ */
+void free_scope(config_scope_t *scope) {
+    config_index_free(&scope->index);
+    free(scope->nodes);
+    free(scope->paths);
+    scope->nodes = NULL;
+    scope->paths = NULL;
+    scope->node_count = 0;
+}
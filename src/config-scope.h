@@ -0,0 +1,88 @@
+/**
+ * This code indexes the nesting of a configuration file--`name { ... }`
+ * blocks, as in jail.conf, and dot-separated keys--so a key can be
+ * addressed by its full path:
+ *
+ *      web {                           web
+ *          host.hostname = "web";      web.host.hostname
+ *          ip4.addr = 10.0.0.2;        web.ip4.addr
+ *      }
+ *      exec.clean;                     exec.clean
+ *
+ * Every path segment is a node of a trie (children in file order), and
+ * the full path of every node is kept in a hash index (see
+ * config-index.h), so an exact path is one probe and a pattern only
+ * walks the part of the trie it can match. In a pattern `*` stands for
+ * any one segment, or--as the last segment--for everything below:
+ *
+ *      web.ip4.addr        the entry for ip4.addr in block web
+ *      web.*               every entry in block web
+ *      *.exec.start        exec.start in every block
+ *
+ * The index is built on a syntax tree (see config-syntax.h) and only
+ * refers to its lines, so a change can be spliced into the addressed
+ * block alone. The first line for a path is the one used, as with
+ * `get_value()`.
+ *
+ *      config_scope_t scope;
+ *      if (build_scope(&scope, &syntax) == 0) {
+ *          int node = find_scope(&scope, "web.ip4.addr");
+ *          if (node >= 0 && scope.nodes[node].line >= 0)
+ *              ...syntax.lines[scope.nodes[node].line]...
+ *          free_scope(&scope);
+ *      }
+ */
+#ifndef CONFIG_SCOPE_H
+#define CONFIG_SCOPE_H
+
+#include "config-syntax.h"
+#include "config-index.h"
+
+// A path segment
+typedef struct {
+    size_t path;                                        /* full path, in `paths` (nul-terminated) */
+    size_t path_length;
+    int parent;                                         /* -1 = top level */
+    int first_child;                                    /* -1 = none */
+    int last_child;
+    int next_sibling;                                   /* -1 = none */
+    int line;                                           /* first entry line for the path, or -1 */
+    int open_line;                                      /* line opening a block of this name, or -1 */
+    int close_line;                                     /* line closing it, or -1 */
+} scope_node_t;
+
+// The scope index of a file
+typedef struct {
+    const config_syntax_t *syntax;
+    scope_node_t *nodes;
+    int node_count;
+    int node_capacity;
+    int first;                                          /* first top level node, or -1 */
+    int last;
+    char *paths;
+    size_t paths_length;
+    size_t paths_capacity;
+    config_index_t index;                               /* path -> node */
+} config_scope_t;
+
+//: build_scope
+//      Index the blocks and dotted keys of `syntax` (which must stay
+//      loaded). Returns 0 on success, -1 when out of memory.
+int build_scope(config_scope_t *scope, const config_syntax_t *syntax);
+
+//: find_scope
+//      The node for the full path `path`, or -1.
+int find_scope(config_scope_t *scope, const char *path);
+
+//: match_scope
+//      The nodes with an entry line that `pattern` matches, in the
+//      order their paths first appear in the file. Sets `*nodes` to
+//      a malloc'd array (NULL when there are none) and returns how
+//      many, or -1 when out of memory.
+int match_scope(config_scope_t *scope, const char *pattern, int **nodes);
+
+//: free_scope
+//      Release the index (not the syntax tree).
+void free_scope(config_scope_t *scope);
+
+#endif /* CONFIG_SCOPE_H */
@@ -0,0 +1,219 @@
+#include "config-syntax.h"
+#include "delim-scan.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+
+/**
+ *: parse_syntax_line
+ * @brief               Finds the parts of an entry line.
+ *
+ * @param data          The file.
+ * @param line          The line; `start` and `end` are set, the
+ *                      rest is filled in.
+ * @param str           Offset of the first non-space character.
+ * @param delims        The delimiter set.
+ * @param syntax        The tree (value tokens are appended to it).
+ * @param token_capacity  Allocated size of `syntax->tokens`.
+ *
+ * @return 0 on success, -1 when out of memory.
+ */
+static int parse_syntax_line(const char *data, syntax_line_t *line, size_t str,
+                             const delim_set_t *delims, config_syntax_t *syntax,
+                             size_t *token_capacity) {
+    size_t eol = line->end;
+    while (eol > str && (data[eol - 1] == '\n' || data[eol - 1] == '\r')) eol--;
+
+    // key
+    size_t p = str + delim_span(delims, data + str, eol - str);
+    line->key.offset = p;
+    p += delim_find(delims, data + p, eol - p);
+    line->key.length = p - line->key.offset;
+
+    // separator and opening quote, up to the first value token
+    line->first_token = syntax->token_count;
+    size_t value_end = p;
+    while (p < eol && delims->table[(unsigned char)data[p]]) {
+        char c = data[p];
+        if ((c == '=' || c == ':') && line->separator.length == 0 && line->open_quote.length == 0) {
+            line->separator.offset = p;
+            line->separator.length = 1;
+        } else if ((c == '"' || c == '\'') && line->open_quote.length == 0) {
+            line->open_quote.offset = p;
+            line->open_quote.length = 1;
+        }
+        p++;
+    }
+    // (where a value goes if there is none)
+    if (line->open_quote.length) {
+        line->value.offset = line->open_quote.offset + 1;
+    } else {
+        size_t q = line->separator.length ? line->separator.offset + 1 : value_end;
+        while (q < p && isspace((unsigned char)data[q])) q++;
+        line->value.offset = q;
+    }
+
+    // value tokens, up to an inline comment
+    while (p < eol && data[p] != '#') {
+        size_t token = p;
+        p += delim_find(delims, data + p, eol - p);
+        if (syntax->token_count == *token_capacity) {
+            span_t *grown = realloc(syntax->tokens, *token_capacity * 2 * sizeof(span_t));
+            if (grown == NULL)
+                return -1;
+            syntax->tokens = grown;
+            *token_capacity *= 2;
+        }
+        if (line->token_count == 0)
+            line->value.offset = token;
+        syntax->tokens[syntax->token_count].offset = token;
+        syntax->tokens[syntax->token_count].length = p - token;
+        syntax->token_count++;
+        line->token_count++;
+        value_end = p;
+        p += delim_span(delims, data + p, eol - p);
+    }
+    line->value.length = line->token_count ? value_end - line->value.offset : 0;
+    if (line->token_count == 0)
+        value_end = line->value.offset;
+
+    // closing quote and terminator, between the value and the comment
+    for (size_t q = value_end; q < p; q++) {
+        char c = data[q];
+        if (line->open_quote.length && !line->close_quote.length && c == data[line->open_quote.offset]) {
+            line->close_quote.offset = q;
+            line->close_quote.length = 1;
+        } else if (c == ';' && !line->terminator.length) {
+            line->terminator.offset = q;
+            line->terminator.length = 1;
+        }
+    }
+
+    if (p < eol) {
+        line->comment.offset = p;
+        line->comment.length = eol - p;
+    }
+    return 0;
+}
+
+/**
+ *: parse_syntax
+ * @brief               Loads a config file and builds its syntax tree.
+ *
+ * @param filename      The config file.
+ * @param delimiters    The delimiters `parse_config()` is used with.
+ * @param syntax        The tree to fill.
+ *
+ * @return 0 on success, -1 on error with `errno` set.
+ */
+int parse_syntax(const char *filename, const char *delimiters, config_syntax_t *syntax) {
+    file_buffer_t buffer;
+
+    memset(syntax, 0, sizeof(*syntax));
+    if (load_file(filename, &buffer) < 0) {
+        return -1;
+    }
+    return parse_syntax_buffer(&buffer, delimiters, syntax);
+}
+
+/**
+ *: parse_syntax_buffer
+ * @brief               Builds the syntax tree of a file already in
+ *                      memory.
+ *
+ * @param buffer        The file; the tree takes it over (it is released
+ *                      by `free_syntax()`, or here on error).
+ * @param delimiters    The delimiters `parse_config()` is used with.
+ * @param syntax        The tree to fill.
+ *
+ * @return 0 on success, -1 on error with `errno` set.
+ */
+int parse_syntax_buffer(file_buffer_t *buffer, const char *delimiters, config_syntax_t *syntax) {
+    delim_set_t delims;
+    size_t line_capacity = 64, token_capacity = 128;
+
+    memset(syntax, 0, sizeof(*syntax));
+    syntax->buffer = *buffer;
+    delim_init(&delims, delimiters);
+
+    syntax->lines = malloc(line_capacity * sizeof(syntax_line_t));
+    syntax->tokens = malloc(token_capacity * sizeof(span_t));
+    if (!syntax->lines || !syntax->tokens) {
+        goto fail;
+    }
+
+    const char *data = syntax->buffer.data;
+    size_t length = syntax->buffer.length;
+    size_t pos = 0;
+    while (pos < length) {
+        const char *eol = memchr(data + pos, '\n', length - pos);
+        size_t next = eol ? (size_t)(eol - data) + 1 : length;
+
+        if (syntax->line_count == line_capacity) {
+            syntax_line_t *grown = realloc(syntax->lines, line_capacity * 2 * sizeof(syntax_line_t));
+            if (grown == NULL)
+                goto fail;
+            syntax->lines = grown;
+            line_capacity *= 2;
+        }
+        syntax_line_t *line = &syntax->lines[syntax->line_count++];
+        memset(line, 0, sizeof(*line));
+        line->start = pos;
+        line->end = next;
+
+        // Only the lines `parse_config()` reads are entries.
+        size_t str = pos;
+        while (str < next && isspace((unsigned char)data[str])) str++;
+        if (str < next && !skip_line(data[str])) {
+            if (parse_syntax_line(data, line, str, &delims, syntax, &token_capacity) < 0)
+                goto fail;
+        }
+        pos = next;
+    }
+    return 0;
+
+fail:
+    free_syntax(syntax);
+    errno = ENOMEM;
+    return -1;
+}
+
+/**
+ *: find_syntax_line
+ * @brief               Finds the next line for a key.
+ *
+ * @param syntax        The syntax tree.
+ * @param key           The key (exact match).
+ * @param after         Search after this line (NULL = from the start).
+ *
+ * @return syntax_line_t*  The line, or NULL if there is none.
+ */
+const syntax_line_t *find_syntax_line(const config_syntax_t *syntax, const char *key,
+                                      const syntax_line_t *after) {
+    size_t length = strlen(key);
+    const syntax_line_t *line = after ? after + 1 : syntax->lines;
+    const syntax_line_t *end = syntax->lines + syntax->line_count;
+    for (; line < end; line++) {
+        if (line->key.length == length && \
+            memcmp(syntax->buffer.data + line->key.offset, key, length) == 0)
+            return line;
+    }
+    return NULL;
+}
+
+/**
+ *: free_syntax
+ * @brief               Releases a syntax tree and its file.
+ *
+ * @param syntax        The tree to release.
+ */
+void free_syntax(config_syntax_t *syntax) {
+    free(syntax->lines);
+    free(syntax->tokens);
+    unload_file(&syntax->buffer);
+    syntax->lines = NULL;
+    syntax->tokens = NULL;
+    syntax->line_count = syntax->token_count = 0;
+}
@@ -0,0 +1,83 @@
+/**
+ * This code builds a lossless syntax tree of a configuration file: one
+ * node per line, recording the byte offsets of every part of an entry
+ * so a change can be spliced into the file without re-creating (and
+ * guessing at the formatting of) the rest of the line.
+ *
+ *      ␣␣key1␣=␣"value1 value2";␣␣# comment
+ *        |   | |||            ||  |
+ *        |   | |||            ||  comment (to the end of the line)
+ *        |   | |||            |terminator
+ *        |   | |||            close_quote
+ *        |   | ||value (first value token to last)
+ *        |   | |open_quote
+ *        |   separator
+ *        key
+ *
+ * Every byte of the file belongs to exactly one line node (`start` to
+ * `end`, including the newline), so writing the file back from the
+ * nodes reproduces it byte for byte. Lines the parser ignores (blank,
+ * comment and section lines) have an empty `key`. A part that is not
+ * present has a length of 0; an empty `value` still records where a
+ * value would go.
+ *
+ *      config_syntax_t syntax;
+ *      if (parse_syntax("rc.conf", delimiters, &syntax) == 0) {
+ *          const syntax_line_t *line = find_syntax_line(&syntax, "hostname", NULL);
+ *          ...syntax.buffer.data + line->value.offset...
+ *          free_syntax(&syntax);
+ *      }
+ */
+#ifndef CONFIG_SYNTAX_H
+#define CONFIG_SYNTAX_H
+
+#include "parse-config.h"
+#include "read-config.h"
+
+// One line of a configuration file (offsets are into the file)
+typedef struct {
+    size_t start;                                       /* first byte of the line */
+    size_t end;                                         /* past the line's newline */
+    span_t key;
+    span_t separator;                                   /* '=' or ':'; empty for a space */
+    span_t open_quote;
+    span_t value;                                       /* first value token to last */
+    span_t close_quote;
+    span_t terminator;                                  /* ';' */
+    span_t comment;                                     /* '#' to the end of the line */
+    size_t first_token;                                 /* value tokens in `tokens` ... */
+    int token_count;                                    /* ... and their number */
+} syntax_line_t;
+
+// A configuration file and its syntax tree
+typedef struct {
+    file_buffer_t buffer;                               /* the file */
+    syntax_line_t *lines;
+    size_t line_count;
+    span_t *tokens;                                     /* value tokens of all lines */
+    size_t token_count;
+} config_syntax_t;
+
+//: parse_syntax
+//      Load `filename` and build its syntax tree. Returns 0 on
+//      success, -1 on error with `errno` set.
+int parse_syntax(const char *filename, const char *delimiters, config_syntax_t *syntax);
+
+//: parse_syntax_buffer
+//      Build the syntax tree of a file already loaded in `buffer`,
+//      which the tree takes over (even on error). Returns 0 on
+//      success, -1 on error with `errno` set.
+int parse_syntax_buffer(file_buffer_t *buffer, const char *delimiters, config_syntax_t *syntax);
+
+//: find_syntax_line
+//      Find the next line for `key` (exact match) after `after`, or
+//      from the first line if `after` is NULL. Returns NULL if there
+//      is none.
+const syntax_line_t *find_syntax_line(const config_syntax_t *syntax, const char *key,
+                                      const syntax_line_t *after);
+
+//: free_syntax
+//      Release a syntax tree and its file.
+void free_syntax(config_syntax_t *syntax);
+
+#endif /* CONFIG_SYNTAX_H */
@@ -0,0 +1,675 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE                                     /* struct ucred, accept4() */
+#endif
+
+#include "daemon-config.h"
+#include "parse-config.h"
+#include "print-config.h"
+#include "commit-config.h"
+#include "read-config.h"
+#include "stats.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#define DAEMON_INOTIFY                                  /* changes are noticed with inotify */
+#endif
+
+#define DAEMON_MAGIC    0x73797363                      /* "sysc" */
+#define DAEMON_MAX_ARGS 4096                            /* most strings in a request */
+
+// The head of a request (followed by `length` bytes of `count`
+// nul-terminated strings)
+typedef struct {
+    uint32_t magic;
+    uint32_t count;
+    uint32_t length;
+} request_head_t;
+
+// The head of an answer (followed by the output, then the errors)
+typedef struct {
+    int32_t status;                                     /* exit status, -1 = not answered */
+    uint32_t output_length;
+    uint32_t errors_length;
+    uint32_t micros;                                    /* time the daemon took */
+} answer_head_t;
+
+/**
+ *: micros_now
+ * @brief               Reads the monotonic clock in microseconds.
+ */
+static uint64_t micros_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+/**
+ *: read_full
+ * @brief               Reads exactly `length` bytes from a socket.
+ *
+ * @return 0 on success, -1 on error or end of input.
+ */
+static int read_full(int fd, void *data, size_t length) {
+    char *p = data;
+    while (length > 0) {
+        ssize_t n = read(fd, p, length);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return -1;
+        p += n;
+        length -= (size_t)n;
+    }
+    return 0;
+}
+
+/**
+ *: write_full
+ * @brief               Writes all of `length` bytes to a socket.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int write_full(int fd, const void *data, size_t length) {
+    const char *p = data;
+    while (length > 0) {
+        ssize_t n = write(fd, p, length);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return -1;
+        p += n;
+        length -= (size_t)n;
+    }
+    return 0;
+}
+
+/**
+ *: socket_address
+ * @brief               Fills in the address of a Unix domain socket.
+ *
+ * @return 0 on success, -1 if the path is too long.
+ */
+static int socket_address(struct sockaddr_un *address, const char *socket_path) {
+    memset(address, 0, sizeof(*address));
+    address->sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(address->sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    strcpy(address->sun_path, socket_path);
+    return 0;
+}
+
+/**
+ *: daemon_socket
+ * @brief               The path of the daemon's socket.
+ *
+ * @return const char*  `$SYSCONF_SOCKET`, or the default for this user;
+ *                      NULL if `$SYSCONF_SOCKET` is "".
+ */
+const char *daemon_socket(void) {
+    static char path[64];
+    const char *env = getenv(DAEMON_SOCKET_ENV);
+    if (env != NULL)
+        return *env ? env : NULL;
+    if (geteuid() == 0)
+        return "/var/run/sysconfd.sock";
+    snprintf(path, sizeof(path), "/tmp/sysconfd.%u.sock", (unsigned)geteuid());
+    return path;
+}
+
+//---[ CLIENT ]------------------------------------------------------
+
+/**
+ *: ask_daemon
+ * @brief               Sends a request to the daemon and copies its
+ *                      answer out.
+ *
+ * Only a socket owned by this user is trusted. The round trip (and the
+ * part of it the daemon took) is added to the `--stats` counters.
+ *
+ * @param socket_path   The daemon's socket (NULL = none).
+ * @param request       The request.
+ * @param out           Where the request's output goes.
+ * @param errors        Where its errors go.
+ *
+ * @return int          The exit status of the request, or -1 if it was
+ *                      not answered (nothing was printed).
+ */
+int ask_daemon(const char *socket_path, const daemon_request_t *request, FILE *out, FILE *errors) {
+    struct stat st;
+    struct sockaddr_un address;
+    if (socket_path == NULL || stat(socket_path, &st) < 0 || !S_ISSOCK(st.st_mode) || \
+        st.st_uid != geteuid() || socket_address(&address, socket_path) < 0) {
+        return -1;
+    }
+
+    // -The daemon runs elsewhere; name the file absolutely.
+    char *path = realpath(request->filename, NULL);
+    if (path == NULL) {
+        return -1;
+    }
+    const char *strings[request->arg_count + 3];
+    strings[0] = request->command;
+    strings[1] = path;
+    strings[2] = request->option ? request->option : "";
+    request_head_t head = { DAEMON_MAGIC, (uint32_t)request->arg_count + 3, 0 };
+    for (int i = 0; i < request->arg_count; i++)
+        strings[i + 3] = request->args[i];
+    for (uint32_t i = 0; i < head.count; i++)
+        head.length += strlen(strings[i]) + 1;
+
+    char *body = head.length <= DAEMON_MAX_REQUEST ? malloc(head.length) : NULL;
+    int fd = body ? socket(AF_UNIX, SOCK_STREAM, 0) : -1;
+    if (fd < 0) {
+        free(body);
+        free(path);
+        return -1;
+    }
+    size_t pos = 0;
+    for (uint32_t i = 0; i < head.count; i++) {
+        size_t length = strlen(strings[i]) + 1;
+        memcpy(body + pos, strings[i], length);
+        pos += length;
+    }
+    free(path);
+
+    // -Ask, and wait for the whole answer before printing any of it.
+    uint64_t start = micros_now();
+    answer_head_t answer;
+    char *data = NULL;
+    int status = -1;
+    if (connect(fd, (struct sockaddr *)&address, sizeof(address)) == 0 && \
+        write_full(fd, &head, sizeof(head)) == 0 && \
+        write_full(fd, body, head.length) == 0 && \
+        read_full(fd, &answer, sizeof(answer)) == 0 && answer.status >= 0) {
+        size_t length = (size_t)answer.output_length + answer.errors_length;
+        data = malloc(length ? length : 1);
+        if (data != NULL && read_full(fd, data, length) == 0) {
+            fwrite(data, 1, answer.output_length, out);
+            fwrite(data + answer.output_length, 1, answer.errors_length, errors);
+            status = answer.status;
+            stats.daemon_requests++;
+            stats.daemon_micros += answer.micros;
+            stats.round_trip_micros += micros_now() - start;
+        }
+    }
+    close(fd);
+    free(data);
+    free(body);
+    return status;
+}
+
+//---[ DAEMON ]------------------------------------------------------
+
+// A config file the daemon keeps parsed
+typedef struct {
+    char *path;
+    const char *name;                                   /* the last part of `path` */
+    config_t *config;                                   /* NULL = read it when next asked */
+    int count;
+    int watch;                                          /* inotify watch of its directory, -1 = none */
+    struct stat st;                                     /* the file that was read */
+    uint64_t used;                                      /* when it was last asked for */
+} cached_file_t;
+
+// The daemon
+typedef struct {
+    char *delimiters;
+    cached_file_t files[DAEMON_MAX_FILES];
+    int file_count;
+    uint64_t clock;                                     /* counts requests (for `used`) */
+    int notify;                                         /* inotify instance, or -1 */
+} daemon_t;
+
+static volatile sig_atomic_t stopping = 0;
+
+/**
+ *: stop_daemon
+ * @brief               Signal handler; the daemon stops after the
+ *                      request it is answering.
+ */
+static void stop_daemon(int signal_number) {
+    (void)signal_number;
+    stopping = 1;
+}
+
+/**
+ *: drop_file
+ * @brief               Forgets the parsed copy of a file (it is read
+ *                      again when next asked for).
+ */
+static void drop_file(cached_file_t *file) {
+    if (file->config != NULL) {
+        free_config(file->config, file->count);
+        free(file->config);
+        file->config = NULL;
+        file->count = 0;
+    }
+}
+
+/**
+ *: release_watch
+ * @brief               Gives up a file's watch of its directory; the
+ *                      watch itself is removed once no other file kept
+ *                      uses it (inotify gives one per directory).
+ *
+ * @param daemon        The daemon.
+ * @param file          The file.
+ */
+static void release_watch(daemon_t *daemon, cached_file_t *file) {
+#ifdef DAEMON_INOTIFY
+    if (daemon->notify >= 0 && file->watch >= 0) {
+        int users = 0;                                  /* (the watch's reference count) */
+        for (int i = 0; i < daemon->file_count; i++) {
+            if (daemon->files[i].watch == file->watch)
+                users++;
+        }
+        if (users == 1)
+            inotify_rm_watch(daemon->notify, file->watch);
+    }
+#else
+    (void)daemon;
+#endif
+    file->watch = -1;
+}
+
+/**
+ *: same_file
+ * @brief               Tells if a file's status is that of the file
+ *                      that was read.
+ */
+static int same_file(const struct stat *a, const struct stat *b) {
+    return a->st_dev == b->st_dev && a->st_ino == b->st_ino && a->st_size == b->st_size && \
+           a->st_mtime == b->st_mtime &&
+#if defined(__APPLE__)
+           a->st_mtimespec.tv_nsec == b->st_mtimespec.tv_nsec;
+#else
+           a->st_mtim.tv_nsec == b->st_mtim.tv_nsec;
+#endif
+}
+
+/**
+ *: notice_changes
+ * @brief               Drops the files inotify says were changed,
+ *                      replaced or removed (without waiting for any).
+ *
+ * @param daemon        The daemon.
+ */
+static void notice_changes(daemon_t *daemon) {
+#ifdef DAEMON_INOTIFY
+    char events[16 * 1024] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t length;
+    while (daemon->notify >= 0 && (length = read(daemon->notify, events, sizeof(events))) > 0) {
+        for (char *p = events; p < events + length; ) {
+            const struct inotify_event *event = (const struct inotify_event *)p;
+            p += sizeof(struct inotify_event) + event->len;
+            for (int i = 0; i < daemon->file_count; i++) {
+                cached_file_t *file = &daemon->files[i];
+                if (event->mask & IN_Q_OVERFLOW) {
+                    drop_file(file);                    /* events were lost */
+                } else if (file->watch != event->wd) {
+                    continue;
+                } else if (event->mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF)) {
+                    drop_file(file);                    /* the directory went away */
+                    file->watch = -1;
+                } else if (event->len > 0 && strcmp(event->name, file->name) == 0) {
+                    drop_file(file);
+                }
+            }
+        }
+    }
+#else
+    (void)daemon;
+#endif
+}
+
+/**
+ *: open_file
+ * @brief               The parsed copy of a file, read (again) if it
+ *                      is not kept or has changed.
+ *
+ * @param daemon        The daemon.
+ * @param path          The file (absolute).
+ *
+ * @return cached_file_t*  The file, or NULL if it is not there or could
+ *                         not be parsed.
+ */
+static cached_file_t *open_file(daemon_t *daemon, const char *path) {
+    cached_file_t *file = NULL;
+    for (int i = 0; i < daemon->file_count && file == NULL; i++) {
+        if (strcmp(daemon->files[i].path, path) == 0)
+            file = &daemon->files[i];
+    }
+
+    // -A new file; make room for it.
+    if (file == NULL) {
+        if (daemon->file_count < DAEMON_MAX_FILES) {
+            file = &daemon->files[daemon->file_count++];
+        } else {
+            file = &daemon->files[0];
+            for (int i = 1; i < DAEMON_MAX_FILES; i++) {
+                if (daemon->files[i].used < file->used)
+                    file = &daemon->files[i];
+            }
+            drop_file(file);
+            release_watch(daemon, file);
+            free(file->path);
+        }
+        memset(file, 0, sizeof(*file));
+        file->watch = -1;
+        file->path = strdup(path);
+        if (file->path == NULL) {
+            *file = daemon->files[--daemon->file_count];   /* (give the slot up) */
+            return NULL;
+        }
+        file->name = strrchr(file->path, '/') + 1;
+    }
+    file->used = ++daemon->clock;
+
+    // -Without a watch, check the file itself.
+    struct stat st;
+    if (stat(path, &st) < 0 || !S_ISREG(st.st_mode)) {
+        drop_file(file);                                /* (`parse_config()` would create it) */
+        return NULL;
+    }
+    if (file->config != NULL && file->watch < 0 && !same_file(&st, &file->st))
+        drop_file(file);
+    if (file->config != NULL)
+        return file;
+
+#ifdef DAEMON_INOTIFY
+    if (daemon->notify >= 0 && file->watch < 0) {
+        size_t dir_length = (size_t)(file->name - file->path);
+        char dir[dir_length + 1];
+        memcpy(dir, file->path, dir_length);
+        dir[dir_length] = '\0';
+        file->watch = inotify_add_watch(daemon->notify, dir,
+                                        IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_CREATE | IN_DELETE | \
+                                        IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF);
+    }
+#endif
+    file->st = st;
+    file->config = parse_config(path, &file->count, daemon->delimiters);
+    return file->config ? file : NULL;
+}
+
+/**
+ *: print_values
+ * @brief               Prints the values of an entry the way `sysconf
+ *                      -f file key` does.
+ */
+static void print_values(FILE *out, char **values, int keyvalue_output) {
+    if (keyvalue_output)
+        fprintf(out, "%s: ", values[0]);
+    for (values += 1; *values; values++) {
+        if (memcmp(*values, "#", 1) == 0)
+            break;
+        fprintf(out, "%s ", *values);
+    }
+    fputs("\n", out);
+}
+
+/**
+ *: answer_request
+ * @brief               Does what `sysconf` would do for a request.
+ *
+ * @param daemon        The daemon.
+ * @param strings       The request: command, file, option, arguments.
+ * @param count         The number of strings (3 or more).
+ * @param out           Where the output goes.
+ * @param errors        Where errors go.
+ *
+ * @return int          The exit status, or -1 to leave the request to
+ *                      the client.
+ */
+static int answer_request(daemon_t *daemon, char **strings, int count, FILE *out, FILE *errors) {
+    const char *command = strings[0];
+    const char *path = strings[1];
+    const char *option = strings[2];
+    char **args = strings + 3;
+    int arg_count = count - 3;
+    if (path[0] != '/')
+        return -1;
+
+    if (strcmp(command, "set") == 0 && arg_count == 1) {
+        int status = commit_change(path, args[0], daemon->delimiters, out, errors);
+        for (int i = 0; i < daemon->file_count; i++) {
+            if (strcmp(daemon->files[i].path, path) == 0)
+                drop_file(&daemon->files[i]);
+        }
+        return status;
+    }
+
+    cached_file_t *file = open_file(daemon, path);
+    if (file == NULL)
+        return -1;
+
+    if (strcmp(command, "list") == 0 && arg_count == 0) {
+        int format = strcmp(option, "raw") == 0 ? PRINT_RAW : \
+                     strcmp(option, "nul") == 0 ? PRINT_NUL : PRINT_ALIGNED;
+        return print_config_stream(file->config, file->count, format, out) < 0 ? 1 : 0;
+    }
+    if (strcmp(command, "get") != 0 || arg_count == 0)
+        return -1;
+
+    // -A key the index does not have may be a dotted key inside a
+    //  block (see config-scope.h); those are the client's to look up.
+    for (int k = 0; k < arg_count; k++) {
+        if (get_value(file->config, file->count, args[k]) == NULL && \
+            (strchr(args[k], '.') != NULL || strchr(args[k], '*') != NULL))
+            return -1;
+    }
+    int keyvalue_output = strcmp(option, "-n") == 0;
+    int status = 0;
+    for (int k = 0; k < arg_count; k++) {
+        char **values = get_value(file->config, file->count, args[k]);
+        if (values != NULL) {
+            print_values(out, values, keyvalue_output);
+        } else if (arg_count == 1) {
+            fputs("sysconf *ERROR*: Error: key not found\n", errors);
+            status = 1;
+        } else {
+            fprintf(errors, "Error: key not found: %s\n", args[k]);
+            fputs("\n", out);
+            status = 1;
+        }
+    }
+    return status;
+}
+
+/**
+ *: peer_uid
+ * @brief               The user of the process at the other end of a
+ *                      connection.
+ *
+ * @return int          0 on success, -1 on error.
+ */
+static int peer_uid(int fd, uid_t *uid) {
+#ifdef SO_PEERCRED
+    struct ucred cred;
+    socklen_t length = sizeof(cred);
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &length) < 0)
+        return -1;
+    *uid = cred.uid;
+    return 0;
+#else
+    gid_t gid;
+    return getpeereid(fd, uid, &gid);
+#endif
+}
+
+/**
+ *: serve_request
+ * @brief               Reads one request from a connection and answers
+ *                      it.
+ *
+ * @param daemon        The daemon.
+ * @param client        The connection.
+ */
+static void serve_request(daemon_t *daemon, int client) {
+    uid_t uid;
+    if (peer_uid(client, &uid) < 0 || uid != geteuid())
+        return;                                         /* not ours to answer */
+
+    // -A client gets a moment to send its request, not the daemon.
+    struct timeval timeout = { 2, 0 };
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    request_head_t head;
+    if (read_full(client, &head, sizeof(head)) < 0 || head.magic != DAEMON_MAGIC || \
+        head.count < 3 || head.count > DAEMON_MAX_ARGS || \
+        head.length == 0 || head.length > DAEMON_MAX_REQUEST)
+        return;
+    char *body = malloc(head.length);
+    char **strings = malloc(head.count * sizeof(char *));
+    if (body == NULL || strings == NULL || read_full(client, body, head.length) < 0 || \
+        body[head.length - 1] != '\0') {
+        free(body);
+        free(strings);
+        return;
+    }
+    uint32_t count = 0;
+    for (char *p = body; p < body + head.length && count < head.count; p += strlen(p) + 1)
+        strings[count++] = p;
+
+    // -Answer into memory, then send it all.
+    uint64_t start = micros_now();
+    char *output = NULL, *errors = NULL;
+    size_t output_length = 0, errors_length = 0;
+    FILE *out = open_memstream(&output, &output_length);
+    FILE *err = open_memstream(&errors, &errors_length);
+    answer_head_t answer = { -1, 0, 0, 0 };
+    if (out != NULL && err != NULL && count == head.count) {
+        notice_changes(daemon);
+        answer.status = answer_request(daemon, strings, (int)count, out, err);
+    }
+    if (out != NULL) fclose(out);
+    if (err != NULL) fclose(err);
+    if (answer.status >= 0) {
+        answer.output_length = (uint32_t)output_length;
+        answer.errors_length = (uint32_t)errors_length;
+    }
+    answer.micros = (uint32_t)(micros_now() - start);
+
+    if (write_full(client, &answer, sizeof(answer)) == 0 && answer.status >= 0 && \
+        write_full(client, output, output_length) == 0)
+        write_full(client, errors, errors_length);
+    free(output);
+    free(errors);
+    free(body);
+    free(strings);
+}
+
+/**
+ *: run_daemon
+ * @brief               Answers requests on a Unix domain socket until
+ *                      SIGINT or SIGTERM.
+ *
+ * @param socket_path   The socket to make.
+ * @param delimiters    Tokenizer delimiters.
+ *
+ * @return 0, or 1 if the socket could not be made.
+ */
+int run_daemon(const char *socket_path, char *delimiters) {
+    struct sockaddr_un address;
+    if (socket_path == NULL || socket_address(&address, socket_path) < 0) {
+        fprintf(stderr, "sysconfd: no usable socket path\n");
+        return 1;
+    }
+
+    // -Another daemon may already answer there; a socket nobody
+    //  answers on is left over and is replaced.
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        fprintf(stderr, "sysconfd: %s\n", strerror(errno));
+        return 1;
+    }
+    if (connect(listener, (struct sockaddr *)&address, sizeof(address)) == 0) {
+        fprintf(stderr, "sysconfd: a daemon is already answering on %s\n", socket_path);
+        close(listener);
+        return 1;
+    }
+    close(listener);
+    struct stat st;
+    if (lstat(socket_path, &st) == 0 && S_ISSOCK(st.st_mode))
+        unlink(socket_path);
+
+    listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    mode_t mask = umask(077);                           /* only this user may connect */
+    int bound = listener >= 0 ? bind(listener, (struct sockaddr *)&address, sizeof(address)) : -1;
+    umask(mask);
+    if (bound < 0 || listen(listener, 64) < 0) {
+        fprintf(stderr, "sysconfd: %s: %s\n", socket_path, strerror(errno));
+        if (listener >= 0) close(listener);
+        return 1;
+    }
+    fcntl(listener, F_SETFD, FD_CLOEXEC);
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = stop_daemon;                    /* (no SA_RESTART; poll() returns) */
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    // -Files are kept for long and may be truncated by others; read
+    //  them rather than map them. Change reports go to the clients.
+    set_load_mmap(0);
+    set_change_output(NULL);
+
+    daemon_t *daemon = calloc(1, sizeof(daemon_t));
+    if (daemon == NULL) {
+        close(listener);
+        unlink(socket_path);
+        return 1;
+    }
+    daemon->delimiters = delimiters;
+    daemon->notify = -1;
+#ifdef DAEMON_INOTIFY
+    daemon->notify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+
+    while (!stopping) {
+        struct pollfd polls[2] = { { listener, POLLIN, 0 }, { daemon->notify, POLLIN, 0 } };
+        if (poll(polls, daemon->notify >= 0 ? 2 : 1, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        if (daemon->notify >= 0 && (polls[1].revents & POLLIN))
+            notice_changes(daemon);
+        if (polls[0].revents & POLLIN) {
+            int client = accept(listener, NULL, NULL);
+            if (client >= 0) {
+                serve_request(daemon, client);
+                close(client);
+            }
+        }
+    }
+
+    close(listener);
+    unlink(socket_path);
+    if (daemon->notify >= 0)
+        close(daemon->notify);
+    for (int i = 0; i < daemon->file_count; i++) {
+        drop_file(&daemon->files[i]);
+        free(daemon->files[i].path);
+    }
+    free(daemon);
+    return 0;
+}
@@ -0,0 +1,69 @@
+/**
+ * This code is sysconfd, the resident lookup daemon (`sysconf --daemon`)
+ * and the client side `sysconf` uses to talk to it.
+ *
+ * The daemon keeps parsed and indexed copies of the config files it is
+ * asked about and answers requests for them on a Unix domain socket,
+ * so a script that asks for the same few files over and over pays for
+ * one round trip per call instead of a `parse_config()`. A file that is
+ * changed by anyone else is noticed with inotify (on Linux; elsewhere
+ * its status is checked on each request) and read again the next time
+ * it is asked for.
+ *
+ * Requests, one per connection (all strings nul-terminated):
+ *
+ *      get     file  "-n" or ""  key ...       look up keys
+ *      set     file  ""          key=value     make a change (see commit-config.h)
+ *      list    file  format                    list the whole file
+ *
+ * The answer is what `sysconf` would have printed--its STDOUT, its
+ * STDERR and its exit status--and how long the daemon took. A request
+ * the daemon cannot answer (a dotted key that is not in the file's own
+ * index, a file that is not there) is answered with a status of -1, and
+ * the client does the work itself; so does a client that finds no
+ * daemon.
+ *
+ * The socket is `$SYSCONF_SOCKET`, or `/var/run/sysconfd.sock` for root
+ * and `/tmp/sysconfd.<uid>.sock` for anybody else. It is only answered
+ * for (and only trusted by) processes of the user the daemon runs as.
+ *
+ *      % sysconf --daemon &
+ *      % sysconf -f /etc/rc.conf hostname      (answered by the daemon)
+ */
+#ifndef DAEMON_CONFIG_H
+#define DAEMON_CONFIG_H
+
+#include <stdio.h>
+
+#define DAEMON_SOCKET_ENV   "SYSCONF_SOCKET"            /* overrides the socket ("" = no daemon) */
+#define DAEMON_MAX_FILES    64                          /* files kept parsed (least recently used go) */
+#define DAEMON_MAX_REQUEST  (64 * 1024)                 /* largest request */
+
+// A request to the daemon
+typedef struct {
+    const char *command;                                /* "get", "set" or "list" */
+    const char *filename;                               /* (made absolute by `ask_daemon()`) */
+    const char *option;                                 /* get: "-n" or ""; list: "aligned", "raw" or "nul" */
+    const char **args;                                  /* get: the keys; set: the change */
+    int arg_count;
+} daemon_request_t;
+
+//: daemon_socket
+//      The path of the daemon's socket, or NULL if `$SYSCONF_SOCKET`
+//      is set to "" (do not use a daemon).
+const char *daemon_socket(void);
+
+//: run_daemon
+//      Answer requests on `socket_path` until SIGINT or SIGTERM.
+//      Returns 0, or 1 if the socket could not be made (or another
+//      daemon is answering on it).
+int run_daemon(const char *socket_path, char *delimiters);
+
+//: ask_daemon
+//      Send `request` to the daemon on `socket_path` and copy its
+//      answer to `out` and `errors`. Returns the exit status of the
+//      request, or -1 if no daemon (of this user) answered or it could
+//      not answer; then nothing was printed.
+int ask_daemon(const char *socket_path, const daemon_request_t *request, FILE *out, FILE *errors);
+
+#endif /* DAEMON_CONFIG_H */
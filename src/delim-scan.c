@@ -0,0 +1,386 @@
+#include "delim-scan.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#define DELIM_SSE2
+#include <emmintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define DELIM_AVX2                                      /* compiled per function; used if the cpu has it */
+#include <immintrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define ALWAYS_INLINE   inline __attribute__((always_inline))
+#define lowest_bit(x)   ((unsigned)__builtin_ctzll(x))
+#else
+#define ALWAYS_INLINE   inline
+static unsigned lowest_bit(uint64_t x) { unsigned b = 0; while (!(x & 1)) { x >>= 1; b++; } return b; }
+#endif
+
+#define BLOCK           64                              /* bytes per mask */
+
+// A function that marks the delimiters in `n` (<= BLOCK) bytes.
+typedef uint64_t (*mask_fn)(const delim_set_t *, const char *, size_t);
+
+/**
+ *: table_mask
+ * @brief               Marks the delimiters in up to 64 bytes, one byte
+ *                      at a time.
+ *
+ * @param set           The delimiter set.
+ * @param p             The bytes.
+ * @param n             The number of bytes (at most 64).
+ *
+ * @return uint64_t     Bit `i` is set if `p[i]` is a delimiter.
+ */
+static ALWAYS_INLINE uint64_t table_mask(const delim_set_t *set, const char *p, size_t n) {
+    const unsigned char *s = (const unsigned char *)p;
+    uint64_t mask = 0;
+    for (size_t i = 0; i < n; i++) {
+        mask |= (uint64_t)(set->table[s[i]] != 0) << i;
+    }
+    return mask;
+}
+
+/**
+ *: block_tokens
+ * @brief               Reads the token starts and ends off the
+ *                      delimiter mask of one block.
+ *
+ * @param delim         The delimiter mask of the block.
+ * @param n             The number of bytes in the block.
+ * @param base          Offset of the block in the buffer.
+ * @param in_token      1 if a token runs into the block (updated).
+ * @param start         Offset of the open token (updated).
+ * @param spans         Filled with the tokens.
+ * @param max           The number of elements in `spans`.
+ * @param tokens        Tokens found so far.
+ *
+ * @return int          Tokens found so far.
+ */
+static ALWAYS_INLINE int block_tokens(uint64_t delim, size_t n, size_t base, uint64_t *in_token,
+                                      size_t *start, span_t *spans, int max, int tokens) {
+    uint64_t valid = n == BLOCK ? ~(uint64_t)0 : (((uint64_t)1 << n) - 1);
+    uint64_t token = ~delim & valid;
+    uint64_t before = (token << 1) | *in_token;         /* byte before is a token byte */
+    uint64_t events = (token & ~before) | (~token & before & valid);
+
+    while (events) {
+        unsigned b = lowest_bit(events);
+        if ((token >> b) & 1) {                         /* a token starts */
+            *start = base + b;
+        } else {                                        /* a token ended */
+            if (tokens < max) {
+                spans[tokens].offset = *start;
+                spans[tokens].length = base + b - *start;
+            }
+            tokens++;
+        }
+        events &= events - 1;
+    }
+    *in_token = (token >> (n - 1)) & 1;
+    return tokens;
+}
+
+/**
+ *: scan_tokens
+ * @brief               Finds the tokens in a buffer a block at a time.
+ *
+ * @param set           The delimiter set.
+ * @param p             The buffer.
+ * @param length        The number of bytes in `p`.
+ * @param spans         Filled with the tokens.
+ * @param max           The number of elements in `spans`.
+ * @param mask          Marks the delimiters of a block.
+ *
+ * @return int          The number of tokens.
+ */
+static ALWAYS_INLINE int scan_tokens(const delim_set_t *set, const char *p, size_t length,
+                                     span_t *spans, int max, mask_fn mask) {
+    uint64_t in_token = 0;
+    size_t start = 0;
+    int tokens = 0;
+    for (size_t i = 0; i < length; i += BLOCK) {
+        size_t n = length - i < BLOCK ? length - i : BLOCK;
+        tokens = block_tokens(mask(set, p + i, n), n, i, &in_token, &start, spans, max, tokens);
+    }
+    if (in_token) {
+        if (tokens < max) {
+            spans[tokens].offset = start;
+            spans[tokens].length = length - start;
+        }
+        tokens++;
+    }
+    return tokens;
+}
+
+/**
+ *: scan_find
+ * @brief               Finds the first delimiter (`want` = 1) or
+ *                      non-delimiter (`want` = 0) a block at a time.
+ *
+ * @return size_t       Its offset, or `length`.
+ */
+static ALWAYS_INLINE size_t scan_find(const delim_set_t *set, const char *p, size_t length,
+                                      int want, mask_fn mask) {
+    for (size_t i = 0; i < length; i += BLOCK) {
+        size_t n = length - i < BLOCK ? length - i : BLOCK;
+        uint64_t valid = n == BLOCK ? ~(uint64_t)0 : (((uint64_t)1 << n) - 1);
+        uint64_t m = mask(set, p + i, n);
+        if (!want)
+            m = ~m & valid;
+        if (m)
+            return i + lowest_bit(m);
+    }
+    return length;
+}
+
+/**
+ *: table_find
+ * @brief               Finds the first delimiter, one byte at a time.
+ *
+ * @param set           The delimiter set.
+ * @param p             The buffer.
+ * @param length        The number of bytes in `p`.
+ *
+ * @return size_t       Offset of the first delimiter, or `length`.
+ */
+static size_t table_find(const delim_set_t *set, const char *p, size_t length) {
+    const unsigned char *s = (const unsigned char *)p;
+    size_t i = 0;
+    while (i < length && !set->table[s[i]]) i++;
+    return i;
+}
+
+/**
+ *: table_span
+ * @brief               Finds the first non-delimiter, one byte at a time.
+ *
+ * @param set           The delimiter set.
+ * @param p             The buffer.
+ * @param length        The number of bytes in `p`.
+ *
+ * @return size_t       Offset of the first non-delimiter, or `length`.
+ */
+static size_t table_span(const delim_set_t *set, const char *p, size_t length) {
+    const unsigned char *s = (const unsigned char *)p;
+    size_t i = 0;
+    while (i < length && set->table[s[i]]) i++;
+    return i;
+}
+
+/**
+ *: table_tokens
+ * @brief               Finds the tokens in a buffer, one byte at a time.
+ *
+ * @param set           The delimiter set.
+ * @param p             The buffer.
+ * @param length        The number of bytes in `p`.
+ * @param spans         Filled with the tokens.
+ * @param max           The number of elements in `spans`.
+ *
+ * @return int          The number of tokens.
+ */
+static int table_tokens(const delim_set_t *set, const char *p, size_t length, span_t *spans, int max) {
+    size_t i = 0;
+    int tokens = 0;
+    while (i < length) {
+        i += table_span(set, p + i, length - i);
+        if (i == length) break;
+        size_t start = i;
+        i += table_find(set, p + i, length - i);
+        if (tokens < max) {
+            spans[tokens].offset = start;
+            spans[tokens].length = i - start;
+        }
+        tokens++;
+    }
+    return tokens;
+}
+
+#ifdef DELIM_SSE2
+/**
+ *: sse2_match
+ * @brief               Marks the delimiters in 16 bytes (one compare
+ *                      per delimiter character).
+ *
+ * @param set           The delimiter set.
+ * @param p             The 16 bytes.
+ *
+ * @return unsigned     Bit `i` is set if `p[i]` is a delimiter.
+ */
+static ALWAYS_INLINE unsigned sse2_match(const delim_set_t *set, const char *p) {
+    __m128i bytes = _mm_loadu_si128((const __m128i *)p);
+    __m128i found = _mm_setzero_si128();
+    for (int d = 0; d < set->count; d++) {
+        found = _mm_or_si128(found, _mm_cmpeq_epi8(bytes, _mm_set1_epi8((char)set->chars[d])));
+    }
+    return (unsigned)_mm_movemask_epi8(found);
+}
+
+/**
+ *: sse2_mask
+ * @brief               Like `table_mask()`, 16 bytes at a time.
+ */
+static ALWAYS_INLINE uint64_t sse2_mask(const delim_set_t *set, const char *p, size_t n) {
+    uint64_t mask = 0;
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        mask |= (uint64_t)sse2_match(set, p + i) << i;
+    }
+    return mask | (i < n ? table_mask(set, p + i, n - i) << i : 0);
+}
+
+static size_t sse2_find(const delim_set_t *set, const char *p, size_t length) {
+    return scan_find(set, p, length, 1, sse2_mask);
+}
+
+static size_t sse2_span(const delim_set_t *set, const char *p, size_t length) {
+    return scan_find(set, p, length, 0, sse2_mask);
+}
+
+static int sse2_tokens(const delim_set_t *set, const char *p, size_t length, span_t *spans, int max) {
+    return scan_tokens(set, p, length, spans, max, sse2_mask);
+}
+#endif /* DELIM_SSE2 */
+
+#ifdef DELIM_AVX2
+/**
+ *: avx2_match
+ * @brief               Marks the delimiters in 32 bytes (two nibble
+ *                      table lookups).
+ *
+ * @param set           The delimiter set (with exact nibble tables).
+ * @param p             The 32 bytes.
+ *
+ * @return uint32_t     Bit `i` is set if `p[i]` is a delimiter.
+ */
+__attribute__((target("avx2")))
+static ALWAYS_INLINE uint32_t avx2_match(const delim_set_t *set, const char *p) {
+    __m256i bytes = _mm256_loadu_si256((const __m256i *)p);
+    __m256i nibble = _mm256_set1_epi8(0x0f);
+    __m256i low = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)set->low));
+    __m256i high = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)set->high));
+    low = _mm256_shuffle_epi8(low, _mm256_and_si256(bytes, nibble));
+    high = _mm256_shuffle_epi8(high, _mm256_and_si256(_mm256_srli_epi16(bytes, 4), nibble));
+    __m256i none = _mm256_cmpeq_epi8(_mm256_and_si256(low, high), _mm256_setzero_si256());
+    return ~(uint32_t)_mm256_movemask_epi8(none);
+}
+
+/**
+ *: avx2_mask
+ * @brief               Like `table_mask()`, 32 bytes at a time.
+ */
+__attribute__((target("avx2")))
+static ALWAYS_INLINE uint64_t avx2_mask(const delim_set_t *set, const char *p, size_t n) {
+    uint64_t mask = 0;
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        mask |= (uint64_t)avx2_match(set, p + i) << i;
+    }
+    for (; i + 16 <= n; i += 16) {
+        mask |= (uint64_t)sse2_match(set, p + i) << i;
+    }
+    return mask | (i < n ? table_mask(set, p + i, n - i) << i : 0);
+}
+
+__attribute__((target("avx2")))
+static size_t avx2_find(const delim_set_t *set, const char *p, size_t length) {
+    return scan_find(set, p, length, 1, avx2_mask);
+}
+
+__attribute__((target("avx2")))
+static size_t avx2_span(const delim_set_t *set, const char *p, size_t length) {
+    return scan_find(set, p, length, 0, avx2_mask);
+}
+
+__attribute__((target("avx2")))
+static int avx2_tokens(const delim_set_t *set, const char *p, size_t length, span_t *spans, int max) {
+    return scan_tokens(set, p, length, spans, max, avx2_mask);
+}
+#endif /* DELIM_AVX2 */
+
+/**
+ *: delim_init_table
+ * @brief               Builds a delimiter set that uses the lookup
+ *                      table only.
+ *
+ * @param set           The set to fill.
+ * @param delimiters    The delimiter characters.
+ */
+void delim_init_table(delim_set_t *set, const char *delimiters) {
+    memset(set, 0, sizeof(*set));
+    set->table['\0'] = 1;
+    for (const char *d = delimiters; *d; d++) set->table[(unsigned char)*d] = 1;
+
+    // The distinct delimiters, and their nibbles, for the vector code.
+    set->nibbles = 1;
+    for (int c = 0; c < 256; c++) {
+        if (!set->table[c])
+            continue;
+        if (set->count < DELIM_MAX_SIMD)
+            set->chars[set->count] = (unsigned char)c;
+        set->count++;
+        if ((c >> 4) < 8) {
+            set->low[c & 15] |= 1 << (c >> 4);
+            set->high[c >> 4] = 1 << (c >> 4);
+        } else {
+            set->nibbles = 0;                           /* only 8 high nibbles fit in a byte */
+        }
+    }
+    if (set->count > DELIM_MAX_SIMD)
+        set->count = 0;                                 /* too many; table only */
+
+    set->find = table_find;
+    set->span = table_span;
+    set->tokens = table_tokens;
+}
+
+/**
+ *: delim_init
+ * @brief               Builds a delimiter set and picks the fastest
+ *                      scanner for this processor.
+ *
+ * @param set           The set to fill.
+ * @param delimiters    The delimiter characters.
+ */
+void delim_init(delim_set_t *set, const char *delimiters) {
+    delim_init_table(set, delimiters);
+    if (set->count == 0)
+        return;
+#ifdef DELIM_AVX2
+    if (set->nibbles && __builtin_cpu_supports("avx2")) {
+        set->find = avx2_find;
+        set->span = avx2_span;
+        set->tokens = avx2_tokens;
+        return;
+    }
+#endif
+#ifdef DELIM_SSE2
+    set->find = sse2_find;
+    set->span = sse2_span;
+    set->tokens = sse2_tokens;
+#endif
+}
+
+/**
+ *: delim_scanner
+ * @brief               Names the scanner `delim_init()` picks (for the
+ *                      usual delimiters).
+ *
+ * @return const char*  "avx2", "sse2" or "table".
+ */
+const char *delim_scanner(void) {
+#ifdef DELIM_AVX2
+    if (__builtin_cpu_supports("avx2"))
+        return "avx2";
+#endif
+#ifdef DELIM_SSE2
+    return "sse2";
+#else
+    return "table";
+#endif
+}
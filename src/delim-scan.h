@@ -0,0 +1,72 @@
+/**
+ * This code finds token boundaries in a buffer several bytes at a
+ * time.
+ *
+ * On x86 each block of the buffer is turned into a bit mask of its
+ * delimiters: 16 bytes at a time with SSE2 (one compare per delimiter
+ * character), or 32 bytes at a time with AVX2 when the processor has
+ * it (checked once, at run time; two nibble table lookups, whatever
+ * the number of delimiters). Token starts and ends are then read off
+ * the masks with bit operations, so a line is tokenized without
+ * looking at its bytes one at a time. Elsewhere, and for the last few
+ * bytes of a buffer, a 256 entry lookup table is used. The buffer does
+ * not have to be nul-terminated, and nothing past `length` is read.
+ *
+ *      delim_set_t delims;
+ *      span_t spans[16];
+ *      delim_init(&delims, " \t\n\"\':=;");
+ *      int n = delim_tokens(&delims, line, length, spans, 16);
+ *      ...token i is line[spans[i].offset .. +spans[i].length)...
+ */
+#ifndef DELIM_SCAN_H
+#define DELIM_SCAN_H
+
+#include "parse-config.h"
+
+#include <stddef.h>
+
+#define DELIM_MAX_SIMD  16                              /* larger sets use the table only */
+
+// A set of delimiters
+typedef struct delim_set {
+    unsigned char table[256];                           /* non-zero for delimiters (and '\0') */
+    unsigned char chars[DELIM_MAX_SIMD];                /* the delimiters (SSE2) */
+    int count;                                          /* number of `chars`; 0 = table only */
+    unsigned char low[16];                              /* nibble tables (AVX2): a byte is a */
+    unsigned char high[16];                             /* delimiter if low[b & 15] & high[b >> 4] */
+    int nibbles;                                        /* 1 = the nibble tables are exact */
+    size_t (*find)(const struct delim_set *, const char *, size_t);
+    size_t (*span)(const struct delim_set *, const char *, size_t);
+    int (*tokens)(const struct delim_set *, const char *, size_t, span_t *, int);
+} delim_set_t;
+
+//: delim_init
+//      Build a delimiter set from a delimiter string ('\0' is always
+//      a delimiter) and pick the fastest scanner for this processor.
+void delim_init(delim_set_t *set, const char *delimiters);
+
+//: delim_init_table
+//      Like `delim_init()`, but always use the lookup table (for
+//      testing and benchmarks).
+void delim_init_table(delim_set_t *set, const char *delimiters);
+
+//: delim_find
+//      Offset of the first delimiter in `p[0 .. length)`, or `length`.
+#define delim_find(set, p, length)      ((set)->find((set), (p), (length)))
+
+//: delim_span
+//      Offset of the first non-delimiter in `p[0 .. length)`, or `length`.
+#define delim_span(set, p, length)      ((set)->span((set), (p), (length)))
+
+//: delim_tokens
+//      Find the tokens in `p[0 .. length)`; stores up to `max` spans
+//      and returns the number of tokens.
+#define delim_tokens(set, p, length, spans, max) \
+                                        ((set)->tokens((set), (p), (length), (spans), (max)))
+
+//: delim_scanner
+//      Name of the scanner `delim_init()` picks: "avx2", "sse2" or
+//      "table".
+const char *delim_scanner(void);
+
+#endif /* DELIM_SCAN_H */
@@ -0,0 +1,439 @@
+#include "libsysconf.h"
+#include "parse-config.h"
+#include "print-config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+// A staged change
+typedef struct {
+    char *key;
+    char *argument;                                     /* "key=value", or NULL to delete the key */
+    char **tokens;                                      /* the argument's tokens (the key first) */
+    int token_count;
+    int entry;                                          /* first entry of the key in the file, or -1 */
+} sysconf_change_t;
+
+struct sysconf {
+    char *filename;
+    char *delimiters;
+    config_t *config;                                   /* the file as loaded */
+    int count;
+    config_view_t view;                                 /* its tokens, in place */
+    sysconf_change_t *changes;
+    int change_count;
+    int change_capacity;
+    char *error;                                        /* problems of the last commit */
+};
+
+/**
+ *: load_handle
+ * @brief               Parses the file of a handle (again), replacing
+ *                      what was loaded only if it worked.
+ *
+ * The handle keeps the file for as long as it is open, so it reads a
+ * copy rather than mapping it: another process may truncate the file
+ * in the meantime.
+ *
+ * @param conf          The handle.
+ *
+ * @return 0 on success, -1 on error with `errno` set.
+ */
+static int load_handle(sysconf_t *conf) {
+    int count = 0;
+    config_t *config = parse_config_read(conf->filename, &count, conf->delimiters);
+    if (config == NULL)
+        return -1;
+    if (conf->config != NULL) {
+        free_config(conf->config, conf->count);
+        free(conf->config);
+    }
+    conf->config = config;
+    conf->count = count;
+    config_view(config, &conf->view);
+    return 0;
+}
+
+/**
+ *: entry_tokens
+ * @brief               Reads the tokens of an entry of the loaded file
+ *                      (up to an inline comment) without copying them.
+ *
+ * @param conf          The handle.
+ * @param entry         The entry.
+ * @param tokens        Filled with up to `max` tokens.
+ * @param max           The size of `tokens`.
+ * @param from          The first token (0 = the key, 1 = its values).
+ *
+ * @return int          The number of tokens.
+ */
+static int entry_tokens(const sysconf_t *conf, int entry, sysconf_value_t *tokens, int max, int from) {
+    const config_t *config = &conf->config[entry];
+    const span_t *spans = NULL;
+    int count = config->value_count;
+    if (config->values == NULL && (count = config_view_tokens(&conf->view, entry, &spans)) < 0)
+        count = 0;                                      /* (out of memory) */
+    int n = 0;
+    for (int i = from; i < count; i++) {
+        const char *data;
+        size_t length;
+        if (config->values != NULL) {
+            data = config->values[i];
+            length = strlen(data);
+        } else {
+            const span_t *span = &spans[i];
+            data = conf->view.data + span->offset;
+            length = span->length;
+        }
+        if (i > 0 && length > 0 && data[0] == '#')
+            break;
+        if (n < max) {
+            tokens[n].data = data;
+            tokens[n].length = length;
+        }
+        n++;
+    }
+    return n;
+}
+
+/**
+ *: change_tokens
+ * @brief               Reads the tokens of a staged change, like
+ *                      `entry_tokens()`.
+ */
+static int change_tokens(const sysconf_change_t *change, sysconf_value_t *tokens, int max, int from) {
+    int n = 0;
+    for (int i = from; i < change->token_count; i++) {
+        if (i > 0 && change->tokens[i][0] == '#')
+            break;
+        if (n < max) {
+            tokens[n].data = change->tokens[i];
+            tokens[n].length = strlen(change->tokens[i]);
+        }
+        n++;
+    }
+    return n;
+}
+
+/**
+ *: find_change
+ * @brief               Finds the staged change of a key.
+ *
+ * @param conf          The handle.
+ * @param key           The key (not nul-terminated).
+ * @param length        Its length.
+ *
+ * @return int          The change, or -1.
+ */
+static int find_change(const sysconf_t *conf, const char *key, size_t length) {
+    for (int c = 0; c < conf->change_count; c++) {
+        if (strlen(conf->changes[c].key) == length && memcmp(conf->changes[c].key, key, length) == 0)
+            return c;
+    }
+    return -1;
+}
+
+/**
+ *: free_change
+ * @brief               Releases what a staged change holds (not the
+ *                      key).
+ */
+static void free_change(sysconf_change_t *change) {
+    for (int i = 0; i < change->token_count; i++) free(change->tokens[i]);
+    free(change->tokens);
+    free(change->argument);
+    change->tokens = NULL;
+    change->token_count = 0;
+    change->argument = NULL;
+}
+
+/**
+ *: clear_changes
+ * @brief               Drops every staged change.
+ */
+static void clear_changes(sysconf_t *conf) {
+    for (int c = 0; c < conf->change_count; c++) {
+        free_change(&conf->changes[c]);
+        free(conf->changes[c].key);
+    }
+    conf->change_count = 0;
+}
+
+/**
+ *: stage_change
+ * @brief               Stages a change of a key, in place of the one
+ *                      staged before for it.
+ *
+ * @param conf          The handle.
+ * @param key           The key.
+ * @param argument      The `key=value` argument (taken over), or NULL
+ *                      to delete the key.
+ * @param tokens        Its tokens (taken over).
+ * @param token_count   The number of tokens.
+ *
+ * @return 0 on success, -1 when out of memory (nothing is taken over).
+ */
+static int stage_change(sysconf_t *conf, const char *key, char *argument, char **tokens, int token_count) {
+    int c = find_change(conf, key, strlen(key));
+    if (c < 0) {
+        if (conf->change_count == conf->change_capacity) {
+            int capacity = conf->change_capacity ? conf->change_capacity * 2 : 8;
+            sysconf_change_t *grown = realloc(conf->changes, capacity * sizeof(sysconf_change_t));
+            if (grown == NULL)
+                return -1;
+            conf->changes = grown;
+            conf->change_capacity = capacity;
+        }
+        char *copy = strdup(key);
+        if (copy == NULL)
+            return -1;
+        c = conf->change_count++;
+        conf->changes[c].key = copy;
+        conf->changes[c].entry = find_config_entry(conf->config, conf->count, key);
+    } else {
+        free_change(&conf->changes[c]);
+    }
+    conf->changes[c].argument = argument;
+    conf->changes[c].tokens = tokens;
+    conf->changes[c].token_count = token_count;
+    return 0;
+}
+
+/**
+ *: sysconf_open
+ * @brief               Opens (parses) a configuration file.
+ *
+ * @param filename      The config file.
+ * @param delimiters    Tokenizer delimiters, or NULL for
+ *                      SYSCONF_DELIMITERS.
+ *
+ * @return sysconf_t*   The handle, or NULL with `errno` set.
+ */
+sysconf_t *sysconf_open(const char *filename, const char *delimiters) {
+    sysconf_t *conf = calloc(1, sizeof(sysconf_t));
+    if (conf == NULL)
+        return NULL;
+    conf->filename = strdup(filename);
+    conf->delimiters = strdup(delimiters ? delimiters : SYSCONF_DELIMITERS);
+    if (conf->filename == NULL || conf->delimiters == NULL || load_handle(conf) < 0) {
+        int error = errno ? errno : EINVAL;
+        sysconf_close(conf);
+        errno = error;
+        return NULL;
+    }
+    return conf;
+}
+
+/**
+ *: sysconf_get
+ * @brief               Looks up the values of a key.
+ *
+ * @param conf          The handle.
+ * @param key           The key (exact match, first occurrence).
+ * @param values        Filled with up to `max` values.
+ * @param max           The size of `values`.
+ *
+ * @return int          The number of values, or -1 if the key is not
+ *                      there.
+ */
+int sysconf_get(sysconf_t *conf, const char *key, sysconf_value_t *values, int max) {
+    int c = find_change(conf, key, strlen(key));
+    if (c >= 0) {
+        const sysconf_change_t *change = &conf->changes[c];
+        return change->argument ? change_tokens(change, values, max, 1) : -1;
+    }
+    int entry = find_config_entry(conf->config, conf->count, key);
+    return entry < 0 ? -1 : entry_tokens(conf, entry, values, max, 1);
+}
+
+/**
+ *: sysconf_next
+ * @brief               Reads the next entry.
+ *
+ * The entries of the file come first, in order, with the staged value
+ * of a changed key on its first line (its other lines, and the lines
+ * of a deleted key, are skipped); then the keys staged that the file
+ * does not have.
+ *
+ * @param conf          The handle.
+ * @param position      Where to read (0 to start); moved past the
+ *                      entry.
+ * @param tokens        Filled with up to `max` tokens, the key first.
+ * @param max           The size of `tokens`.
+ *
+ * @return int          The number of tokens, or -1 after the last
+ *                      entry.
+ */
+int sysconf_next(sysconf_t *conf, int *position, sysconf_value_t *tokens, int max) {
+    while (*position < conf->count) {
+        int entry = (*position)++;
+        if (conf->change_count == 0)
+            return entry_tokens(conf, entry, tokens, max, 0);
+
+        sysconf_value_t key;
+        entry_tokens(conf, entry, &key, 1, 0);
+        int c = find_change(conf, key.data, key.length);
+        if (c < 0)
+            return entry_tokens(conf, entry, tokens, max, 0);
+        if (conf->changes[c].argument != NULL && conf->changes[c].entry == entry)
+            return change_tokens(&conf->changes[c], tokens, max, 0);
+    }
+    while (*position - conf->count < conf->change_count) {
+        const sysconf_change_t *change = &conf->changes[(*position)++ - conf->count];
+        if (change->argument != NULL && change->entry < 0)
+            return change_tokens(change, tokens, max, 0);
+    }
+    return -1;
+}
+
+/**
+ *: sysconf_set
+ * @brief               Stages a new value for a key.
+ *
+ * The value is split into values the way `sysconf -f file key=value`
+ * splits its argument.
+ *
+ * @param conf          The handle.
+ * @param key           The key.
+ * @param value         The value(s).
+ *
+ * @return 0 on success, -1 with `errno` set (EINVAL for a key that is
+ *         not one token, or no value).
+ */
+int sysconf_set(sysconf_t *conf, const char *key, const char *value) {
+    size_t key_length = strlen(key);
+    if (key_length == 0 || key[key_length - 1] == '+' || key[key_length - 1] == '-') {
+        errno = EINVAL;                                 /* (those are `+=` and `-=`) */
+        return -1;
+    }
+    size_t size = key_length + strlen(value) + 2;
+    char *argument = malloc(size);
+    if (argument == NULL)
+        return -1;
+    snprintf(argument, size, "%s=%s", key, value);
+
+    char **tokens = NULL;
+    int token_count = make_argv(argument, conf->delimiters, &tokens);
+    int error = ENOMEM;
+    if (token_count >= 2 && strcmp(tokens[0], key) == 0) {
+        if (stage_change(conf, key, argument, tokens, token_count) == 0)
+            return 0;
+    } else if (token_count >= 0) {
+        error = EINVAL;
+    }
+    for (int i = 0; i < token_count; i++) free(tokens[i]);
+    free(tokens);
+    free(argument);
+    errno = error;
+    return -1;
+}
+
+/**
+ *: sysconf_delete
+ * @brief               Stages the removal of a key.
+ *
+ * @param conf          The handle.
+ * @param key           The key.
+ *
+ * @return 0 on success, -1 with `errno` set (ENOENT if the key is not
+ *         there).
+ */
+int sysconf_delete(sysconf_t *conf, const char *key) {
+    if (sysconf_get(conf, key, NULL, 0) < 0) {
+        errno = ENOENT;
+        return -1;
+    }
+    return stage_change(conf, key, NULL, NULL, 0);
+}
+
+/**
+ *: sysconf_commit
+ * @brief               Makes the staged changes in one rewrite of the
+ *                      file (under its lock) and loads it again.
+ *
+ * Each change is checked and made as `sysconf` would make it, against
+ * the file as it is now, so changes other writers made since it was
+ * opened are kept. If the file could not be locked or written the
+ * changes stay staged.
+ *
+ * @param conf          The handle.
+ *
+ * @return 0 on success, -1 on error (see `sysconf_error()`).
+ */
+int sysconf_commit(sysconf_t *conf) {
+    free(conf->error);
+    conf->error = NULL;
+    size_t error_size = 0;
+    FILE *errors = open_memstream(&conf->error, &error_size);
+    if (errors == NULL)
+        return -1;
+
+    int rc = 0;
+    int written = 1;
+    if (conf->change_count > 0) {
+        FILE *previous = set_change_output(NULL);
+        if (begin_changes(conf->filename) < 0) {
+            fprintf(errors, "Unable to lock %s: %s\n", conf->filename, strerror(errno));
+            rc = -1;
+            written = 0;
+        } else {
+            for (int c = 0; c < conf->change_count; c++) {
+                const sysconf_change_t *change = &conf->changes[c];
+                if (change->argument != NULL) {
+                    if (changevariable(change->argument, conf->filename, conf->delimiters, errors) != 0)
+                        rc = -1;
+                } else if (removevariable(change->key, conf->filename) < 0) {
+                    fprintf(errors, "Unable to remove %s\n", change->key);
+                    rc = -1;
+                }
+            }
+            if (end_changes() < 0) {
+                fprintf(errors, "Unable to write %s\n", conf->filename);
+                rc = -1;
+                written = 0;
+            }
+        }
+        set_change_output(previous);
+    }
+
+    if (written) {
+        clear_changes(conf);
+        if (load_handle(conf) < 0) {
+            fprintf(errors, "Unable to read %s: %s\n", conf->filename, strerror(errno));
+            rc = -1;
+        }
+    }
+    fclose(errors);
+    return rc;
+}
+
+/**
+ *: sysconf_error
+ * @brief               Returns the problems of the last commit.
+ */
+const char *sysconf_error(const sysconf_t *conf) {
+    return conf->error ? conf->error : "";
+}
+
+/**
+ *: sysconf_close
+ * @brief               Releases a handle.
+ *
+ * @param conf          The handle (may be NULL).
+ */
+void sysconf_close(sysconf_t *conf) {
+    if (conf == NULL)
+        return;
+    clear_changes(conf);
+    free(conf->changes);
+    if (conf->config != NULL) {
+        free_config(conf->config, conf->count);
+        free(conf->config);
+    }
+    free(conf->error);
+    free(conf->delimiters);
+    free(conf->filename);
+    free(conf);
+}
@@ -0,0 +1,103 @@
+/**
+ * This code is libsysconf, the handle API for programs that read and
+ * change configuration files themselves instead of running `sysconf`
+ * for each question (`make lib` builds `libsysconf.a` and
+ * `libsysconf.so`).
+ *
+ * A handle is a parsed file. Lookups return views into the loaded file
+ * (`data`/`length`, not nul-terminated), so nothing is copied; they are
+ * valid until the next `sysconf_commit()` or `sysconf_close()`.
+ *
+ * Changes are staged on the handle, and lookups and iteration see them
+ * straight away. `sysconf_commit()` makes them all under the lock of
+ * the file, in one rewrite (see `begin_changes()`), and loads the file
+ * again. Until then the file is not touched.
+ *
+ *      sysconf_t *conf = sysconf_open("/etc/rc.conf", NULL);
+ *      sysconf_value_t values[8];
+ *      int n = sysconf_get(conf, "hostname", values, 8);
+ *      if (n > 0)
+ *          printf("%.*s\n", (int)values[0].length, values[0].data);
+ *
+ *      sysconf_set(conf, "sshd_enable", "YES");
+ *      sysconf_delete(conf, "ntpd_enable");
+ *      if (sysconf_commit(conf) < 0)
+ *          fprintf(stderr, "%s", sysconf_error(conf));
+ *
+ *      int position = 0;
+ *      while ((n = sysconf_next(conf, &position, values, 8)) >= 0)
+ *          printf("%.*s\n", (int)values[0].length, values[0].data);
+ *      sysconf_close(conf);
+ *
+ * A handle is used by one thread at a time, and a process commits to
+ * one file at a time.
+ */
+#ifndef LIBSYSCONF_H
+#define LIBSYSCONF_H
+
+#include <stddef.h>
+
+// The library is built with `-fvisibility=hidden`; only these
+// functions are exported from `libsysconf.so`.
+#if defined(__GNUC__)
+#define SYSCONF_API __attribute__((visibility("default")))
+#else
+#define SYSCONF_API
+#endif
+
+#define SYSCONF_DELIMITERS  " \t\n\"\':=;"              /* the tokenizer delimiters of `sysconf` */
+
+// An open configuration file
+typedef struct sysconf sysconf_t;
+
+// A token: `length` bytes at `data` (not nul-terminated)
+typedef struct {
+    const char *data;
+    size_t length;
+} sysconf_value_t;
+
+//: sysconf_open
+//      Parse `filename` (with `delimiters`, or SYSCONF_DELIMITERS when
+//      NULL); like `sysconf`, a file that is not there is created.
+//      Returns the handle, or NULL with `errno` set.
+SYSCONF_API sysconf_t *sysconf_open(const char *filename, const char *delimiters);
+
+//: sysconf_get
+//      Look up a key (exact match, first occurrence). Stores up to
+//      `max` of its values--without the key, up to an inline
+//      comment--and returns the number of values, or -1 if the key is
+//      not there (or was deleted).
+SYSCONF_API int sysconf_get(sysconf_t *conf, const char *key, sysconf_value_t *values, int max);
+
+//: sysconf_next
+//      Read the entry at `*position` (start at 0) and move past it.
+//      Stores up to `max` of its tokens, the key first, and returns
+//      the number of tokens, or -1 after the last entry. Staged
+//      changes are shown in place; new keys come last.
+SYSCONF_API int sysconf_next(sysconf_t *conf, int *position, sysconf_value_t *tokens, int max);
+
+//: sysconf_set
+//      Stage `key = value` (`value` may hold several values). Returns
+//      0, or -1 with `errno` set.
+SYSCONF_API int sysconf_set(sysconf_t *conf, const char *key, const char *value);
+
+//: sysconf_delete
+//      Stage the removal of every line of a key. Returns 0, or -1 if
+//      the key is not there.
+SYSCONF_API int sysconf_delete(sysconf_t *conf, const char *key);
+
+//: sysconf_commit
+//      Write the staged changes in one rewrite and load the file
+//      again. Returns 0, or -1 if a change could not be made (see
+//      `sysconf_error()`); the changes that could are written.
+SYSCONF_API int sysconf_commit(sysconf_t *conf);
+
+//: sysconf_error
+//      The problems the last `sysconf_commit()` ran into, or "".
+SYSCONF_API const char *sysconf_error(const sysconf_t *conf);
+
+//: sysconf_close
+//      Release a handle; staged changes are dropped.
+SYSCONF_API void sysconf_close(sysconf_t *conf);
+
+#endif /* LIBSYSCONF_H */
@@ -0,0 +1,144 @@
+#include "overlay-config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/**
+ *: overlay_key
+ * @brief               Reads the key of a merged entry (for the index).
+ *
+ * @param keys          The overlay.
+ * @param entry         The number of the entry in `refs`.
+ * @param length        Set to the length of the key.
+ *
+ * @return const char*  The key (not nul-terminated when it is still a
+ *                      span of the file), or NULL.
+ */
+static const char *overlay_key(const void *keys, int entry, size_t *length) {
+    const config_overlay_t *overlay = keys;
+    const overlay_ref_t *ref = &overlay->refs[entry];
+    const config_t *config = &overlay->configs[ref->layer][ref->entry];
+    if (config->values != NULL) {
+        if (config->values[0] == NULL)
+            return NULL;
+        *length = strlen(config->values[0]);
+        return config->values[0];
+    }
+    return config_view_key(&overlay->views[ref->layer], ref->entry, length);
+}
+
+/**
+ *: open_overlay
+ * @brief               Parses a stack of files and merges their keys.
+ *
+ * @param overlay       Filled in.
+ * @param sources       The files, lowest first.
+ * @param source_count  The number of files.
+ * @param delimiters    The tokenizer delimiters.
+ * @param threads       The most files to parse at once (0 = one per CPU).
+ *
+ * @return 0 on success, -1 on error (nothing is left to close).
+ */
+int open_overlay(config_overlay_t *overlay, const char **sources, int source_count,
+                 char *delimiters, int threads) {
+    memset(overlay, 0, sizeof(*overlay));
+    overlay->sources = calloc(source_count > 0 ? source_count : 1, sizeof(char *));
+    overlay->configs = calloc(source_count > 0 ? source_count : 1, sizeof(config_t *));
+    overlay->counts = calloc(source_count > 0 ? source_count : 1, sizeof(int));
+    overlay->views = calloc(source_count > 0 ? source_count : 1, sizeof(config_view_t));
+    if (!overlay->sources || !overlay->configs || !overlay->counts || !overlay->views) {
+        close_overlay(overlay);
+        return -1;
+    }
+
+    // A file that is not there sets nothing (and is not created, as
+    // `parse_config()` would).
+    struct stat st;
+    for (int i = 0; i < source_count; i++) {
+        if (stat(sources[i], &st) == 0)
+            overlay->sources[overlay->layer_count++] = sources[i];
+    }
+    if (threads <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? (int)cpus : 1;
+    }
+    if (overlay->layer_count > 0 && \
+        parse_config_files(overlay->sources, overlay->layer_count, delimiters,
+                           overlay->configs, overlay->counts, threads) < 0) {
+        close_overlay(overlay);
+        return -1;
+    }
+
+    // List every entry with the highest file first; the index keeps the
+    // first entry it sees for a key, so the last file to set a key wins
+    // and, inside a file, its first entry does.
+    int total = 0;
+    for (int l = 0; l < overlay->layer_count; l++) {
+        config_view(overlay->configs[l], &overlay->views[l]);
+        total += overlay->counts[l];
+    }
+    overlay->refs = malloc((total > 0 ? total : 1) * sizeof(overlay_ref_t));
+    if (overlay->refs == NULL) {
+        close_overlay(overlay);
+        return -1;
+    }
+    for (int l = overlay->layer_count - 1; l >= 0; l--) {
+        for (int e = 0; e < overlay->counts[l]; e++) {
+            overlay->refs[overlay->ref_count].layer = l;
+            overlay->refs[overlay->ref_count].entry = e;
+            overlay->ref_count++;
+        }
+    }
+    if (config_index_build(&overlay->index, overlay_key, overlay, overlay->ref_count) < 0) {
+        close_overlay(overlay);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ *: overlay_get
+ * @brief               Looks up the effective values of a key.
+ *
+ * @param overlay       The stack from `open_overlay()`.
+ * @param key           The key.
+ * @param source        Set to the file the values came from (may be NULL).
+ *
+ * @return char**       The values (the key first), or NULL.
+ */
+char **overlay_get(config_overlay_t *overlay, const char *key, const char **source) {
+    int found = config_index_find(&overlay->index, overlay_key, overlay, key);
+    if (found < 0) {
+        return NULL;
+    }
+    const overlay_ref_t *ref = &overlay->refs[found];
+    if (source != NULL) {
+        *source = overlay->sources[ref->layer];
+    }
+    return config_entry_values(overlay->configs[ref->layer], ref->entry);
+}
+
+/**
+ *: close_overlay
+ * @brief               Releases the files and the index.
+ *
+ * @param overlay       The stack from `open_overlay()`.
+ */
+void close_overlay(config_overlay_t *overlay) {
+    for (int l = 0; overlay->configs && l < overlay->layer_count; l++) {
+        if (overlay->configs[l]) {
+            free_config(overlay->configs[l], overlay->counts[l]);
+            free(overlay->configs[l]);
+        }
+    }
+    config_index_free(&overlay->index);
+    free(overlay->refs);
+    free(overlay->views);
+    free(overlay->counts);
+    free(overlay->configs);
+    free(overlay->sources);
+    memset(overlay, 0, sizeof(*overlay));
+}
@@ -0,0 +1,65 @@
+/**
+ * This code resolves keys across an ordered stack of configuration
+ * files--for example a defaults file, the main file and the files of
+ * a `.d` directory in lexical order--where the last file to set a key
+ * wins. Within one file the first entry for a key is used, as with
+ * `get_value()`.
+ *
+ * The files are parsed at the same time (see `parse_config_files()`)
+ * and their entries are merged into one hash index (see
+ * config-index.h), so a lookup is one probe no matter how many files
+ * there are, and it also says which file the value came from. Files
+ * that do not exist are skipped.
+ *
+ *      const char *stack[] = { "/etc/defaults/rc.conf", "/etc/rc.conf",
+ *                              "/etc/rc.conf.d/ntpd" };
+ *      config_overlay_t overlay;
+ *      if (open_overlay(&overlay, stack, 3, delimiters, 0) == 0) {
+ *          const char *source;
+ *          char **values = overlay_get(&overlay, "ntpd_enable", &source);
+ *          ...values[1] .. is the effective value, set in `source`...
+ *          close_overlay(&overlay);
+ *      }
+ */
+#ifndef OVERLAY_CONFIG_H
+#define OVERLAY_CONFIG_H
+
+#include "parse-config.h"
+#include "config-index.h"
+
+// An entry of one of the files
+typedef struct {
+    int layer;                                          /* the file */
+    int entry;                                          /* the entry in that file */
+} overlay_ref_t;
+
+// A stack of parsed configuration files
+typedef struct {
+    int layer_count;                                    /* files that were found */
+    const char **sources;                               /* their names, lowest first */
+    config_t **configs;
+    int *counts;
+    config_view_t *views;
+    overlay_ref_t *refs;                                /* every entry, highest file first */
+    int ref_count;
+    config_index_t index;                               /* over `refs` */
+} config_overlay_t;
+
+//: open_overlay
+//      Parse the `source_count` files of `sources` (lowest first) on up
+//      to `threads` threads (0 = one per CPU) and index their keys.
+//      Returns 0 on success, -1 if a file could not be parsed.
+int open_overlay(config_overlay_t *overlay, const char **sources, int source_count,
+                 char *delimiters, int threads);
+
+//: overlay_get
+//      The effective values of `key` (the key first, like `get_value()`)
+//      and the name of the file that set them (`source` may be NULL).
+//      Returns NULL if no file has the key.
+char **overlay_get(config_overlay_t *overlay, const char *key, const char **source);
+
+//: close_overlay
+//      Release the files and the index.
+void close_overlay(config_overlay_t *overlay);
+
+#endif /* OVERLAY_CONFIG_H */
@@ -1,52 +1,335 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE                                     /* memmem() */
+#endif
 #include "parse-config.h"
+#include "read-config.h"
+#include "arena.h"
+#include "config-index.h"
+#include "delim-scan.h"
+#include "stats.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>  /* for isstring() */
 #include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <pthread.h>
+
+// Where an entry is in the loaded file. Only its key is found while
+// the file is parsed; the rest of its tokens when they are asked for.
+typedef struct {
+    span_t key;                                         /* the key */
+    size_t end;                                         /* the end of its line */
+    const span_t *tokens;                               /* its tokens (in the arena), NULL until found */
+} entry_line_t;
 
 /**
- *: count_tokes
- * @brief Counts the number of tokens in the input string based on the delimiters.
+ * Every array returned by `parse_config()` keeps the loaded file,
+ * where each entry's line and key are, an arena for the token spans
+ * and C strings made from them on demand, and a hash index over its
+ * keys. These are found again from the array pointer through this
+ * (short) list so the public `config_t`/count interface does not have
+ * to change.
  *
- * @param input_string  A string to parse.
- * @param delimiters    A string of delimiters.
+ * An entry's line is only tokenized when its tokens are asked for
+ * (see `entry_tokens()`); until then its `value_count` is 0. Its
+ * `values` stay NULL until they are asked for (see
+ * `config_entry_values()`). Entries that have been changed
+ * (`set_config_item()`) have their `values` and no longer use the
+ * line.
+ */
+typedef struct config_file {
+    config_t *config;                                   /* array handed to the caller */
+    size_t capacity;                                    /* entries allocated in `config` and `lines` */
+    arena_t arena;                                      /* token spans and C strings behind `config` */
+    config_index_t index;                               /* key index over `config` */
+    file_buffer_t buffer;                               /* the loaded file */
+    delim_set_t delims;                                 /* (to tokenize the lines with) */
+    entry_line_t *lines;                                /* where each entry is */
+    struct config_file *next;
+} config_file_t;
+
+static config_file_t *config_files = NULL;
+static pthread_mutex_t config_files_lock = PTHREAD_MUTEX_INITIALIZER;   /* files may be parsed on several threads */
+
+/**
+ *: find_config_file
+ * @brief               Finds the bookkeeping for a parsed config array.
  *
- * @return The number of tokens found, or -1 on error.
+ * @param config        An array returned by `parse_config()`.
+ *
+ * @return config_file_t*  The record, or NULL if `config` was not
+ *                         made by `parse_config()`.
  */
-int count_tokens(const char *input_string, const char *delimiters) {
-    if (input_string == NULL || delimiters == NULL) {
-        return -1;
+static config_file_t *find_config_file(const config_t *config) {
+    config_file_t *file;
+    pthread_mutex_lock(&config_files_lock);
+    for (file = config_files; file; file = file->next) {
+        if (file->config == config)
+            break;
     }
+    pthread_mutex_unlock(&config_files_lock);
+    return file;
+}
 
-    // Skip leading delimiters
-    const char *stash = input_string + strspn(input_string, delimiters);
+/**
+ *: entry_key
+ * @brief               Reads the key of an entry (for the key index).
+ *
+ * @param keys          The bookkeeping of a parsed file.
+ * @param entry         The entry number.
+ * @param length        Set to the length of the key.
+ *
+ * @return const char*  The key (not nul-terminated when it is still a
+ *                      span of the file), or NULL.
+ */
+static const char *entry_key(const void *keys, int entry, size_t *length) {
+    const config_file_t *file = keys;
+    const config_t *config = &file->config[entry];
+    if (config->values != NULL) {
+        if (config->values[0] == NULL)
+            return NULL;
+        *length = strlen(config->values[0]);
+        return config->values[0];
+    }
+    const span_t *key = &file->lines[entry].key;
+    *length = key->length;
+    return file->buffer.data + key->offset;
+}
 
-    // Check if stash is empty
-    if (*stash == '\0') {
-        return 0;                                       // No tokens found
+/**
+ *: line_tokens
+ * @brief               Tokenizes the line of an entry into spans of the
+ *                      loaded file, without keeping them.
+ *
+ * @param file          The bookkeeping of a parsed file.
+ * @param entry         The entry number.
+ * @param spans         Filled with up to `max` tokens, the key first.
+ * @param max           The size of `spans`.
+ *
+ * @return int          The number of tokens (may be more than `max`).
+ */
+static int line_tokens(const config_file_t *file, int entry, span_t *spans, int max) {
+    // (the key is the first token; the tokens before it are delimiters)
+    const entry_line_t *line = &file->lines[entry];
+    const char *start = file->buffer.data + line->key.offset;
+    int tokens = span_tokens(start, line->end - line->key.offset, &file->delims, spans, max);
+    for (int i = 0; i < tokens && i < max; i++) {
+        spans[i].offset += line->key.offset;
     }
+    stats.tokens += tokens <= max ? tokens : 0;
+    return tokens;
+}
 
-    // Duplicate the string
-    char *tokenized_string = strdup(stash);
-    if (tokenized_string == NULL) {
-        return -1;                                      // Memory allocation failed
+/**
+ *: entry_tokens
+ * @brief               Tokenizes (once) the line of an entry, keeping
+ *                      the spans in the arena, and sets its
+ *                      `value_count`.
+ *
+ * @param file          The bookkeeping of a parsed file.
+ * @param entry         The entry number.
+ *
+ * @return const span_t*  The entry's tokens, the key first, or NULL
+ *                        when out of memory.
+ */
+static const span_t *entry_tokens(config_file_t *file, int entry) {
+    entry_line_t *line = &file->lines[entry];
+    if (line->tokens != NULL) {
+        return line->tokens;
     }
 
-    char *saveptr;
-    int tokens = 0;
+    span_t found[32];
+    int tokens = line_tokens(file, entry, found, 32);
+    span_t *spans = arena_alloc(&file->arena, tokens * sizeof(span_t));
+    if (spans == NULL) {
+        return NULL;
+    }
+    if (tokens > 32) {
+        line_tokens(file, entry, spans, tokens);
+    } else {
+        memcpy(spans, found, tokens * sizeof(span_t));
+    }
+    file->config[entry].value_count = tokens;
+    line->tokens = spans;
+    return spans;
+}
 
-    // Count tokens
-    if (strtok_r(tokenized_string, delimiters, &saveptr) != NULL) {
-        tokens = 1;
-        while (strtok_r(NULL, delimiters, &saveptr) != NULL) {
-            tokens++;
+/**
+ *: entry_values
+ * @brief               Makes (once) the C strings of an entry from its
+ *                      spans.
+ *
+ * @param file          The bookkeeping of a parsed file.
+ * @param entry         The entry number.
+ *
+ * @return char**       The entry's values, or NULL when out of memory.
+ */
+static char **entry_values(config_file_t *file, int entry) {
+    config_t *config = &file->config[entry];
+    if (config->values != NULL) {
+        return config->values;
+    }
+
+    const span_t *spans = entry_tokens(file, entry);
+    if (spans == NULL) {
+        return NULL;
+    }
+    char **argv = arena_alloc(&file->arena, (config->value_count + 1) * sizeof(char *));
+    if (argv == NULL) {
+        return NULL;
+    }
+    for (int i = 0; i < config->value_count; i++) {
+        argv[i] = arena_strndup(&file->arena, file->buffer.data + spans[i].offset, spans[i].length);
+        if (argv[i] == NULL) {
+            return NULL;
         }
     }
+    argv[config->value_count] = NULL;
+    config->values = argv;
+    return argv;
+}
+
+/**
+ *: all_entry_values
+ * @brief               Makes the C strings of every entry (before the
+ *                      array is rearranged).
+ *
+ * @param file          The bookkeeping of a parsed file.
+ * @param count         The number of entries.
+ *
+ * @return 0 on success, -1 when out of memory.
+ */
+static int all_entry_values(config_file_t *file, int count) {
+    for (int i = 0; i < count; i++) {
+        if (entry_values(file, i) == NULL)
+            return -1;
+    }
+    return 0;
+}
 
-    free(tokenized_string);
-    return tokens;
+/**
+ *: config_entry_values
+ * @brief               Returns the values of an entry as C strings,
+ *                      making them the first time they are asked for.
+ *
+ * @param config        A pointer to the configuration data.
+ * @param entry         The entry number.
+ *
+ * @return char**       The values (the key first), or NULL.
+ */
+char **config_entry_values(config_t *config, int entry) {
+    config_file_t *file = find_config_file(config);
+    return file ? entry_values(file, entry) : config[entry].values;
+}
+
+/**
+ *: config_view
+ * @brief               Gives read access to the tokens of a parsed file
+ *                      without copying them (for printing it all).
+ *
+ * @param config        A pointer to the configuration data.
+ * @param view          Filled in; all NULL for an array not made by
+ *                      `parse_config()`.
+ */
+void config_view(const config_t *config, config_view_t *view) {
+    config_file_t *file = find_config_file(config);
+    view->data = file ? file->buffer.data : NULL;
+    view->file = file;
+}
+
+/**
+ *: config_view_key
+ * @brief               Reads the key of an entry in place, without
+ *                      tokenizing its line.
+ *
+ * @param view          A view from `config_view()`.
+ * @param entry         The entry number.
+ * @param length        Set to the length of the key.
+ *
+ * @return const char*  The key (not nul-terminated), or NULL for an
+ *                      entry that has its `values`.
+ */
+const char *config_view_key(const config_view_t *view, int entry, size_t *length) {
+    config_file_t *file = view->file;
+    if (file == NULL || file->config[entry].values != NULL) {
+        return NULL;
+    }
+    *length = file->lines[entry].key.length;
+    return file->buffer.data + file->lines[entry].key.offset;
+}
+
+/**
+ *: config_view_tokens
+ * @brief               Reads the tokens of an entry in place,
+ *                      tokenizing its line the first time.
+ *
+ * @param view          A view from `config_view()`.
+ * @param entry         The entry number.
+ * @param spans         Set to the tokens (the key first), as spans of
+ *                      `view->data`.
+ *
+ * @return int          The number of tokens, or -1 for an entry that
+ *                      has its `values` (or when out of memory).
+ */
+int config_view_tokens(const config_view_t *view, int entry, const span_t **spans) {
+    config_file_t *file = view->file;
+    if (file == NULL || file->config[entry].values != NULL) {
+        return -1;
+    }
+    if ((*spans = entry_tokens(file, entry)) == NULL) {
+        return -1;
+    }
+    return file->config[entry].value_count;
+}
+
+/**
+ *: config_view_scan
+ * @brief               Reads the tokens of an entry in place without
+ *                      keeping them (for reading each entry once).
+ *
+ * @param view          A view from `config_view()`.
+ * @param entry         The entry number.
+ * @param spans         Filled with up to `max` tokens (the key first),
+ *                      as spans of `view->data`.
+ * @param max           The size of `spans`.
+ *
+ * @return int          The number of tokens (more than `max` if they
+ *                      did not fit), or -1 for an entry that has its
+ *                      `values`.
+ */
+int config_view_scan(const config_view_t *view, int entry, span_t *spans, int max) {
+    config_file_t *file = view->file;
+    if (file == NULL || file->config[entry].values != NULL) {
+        return -1;
+    }
+    if (file->lines[entry].tokens != NULL) {
+        int tokens = file->config[entry].value_count;
+        memcpy(spans, file->lines[entry].tokens, (tokens < max ? tokens : max) * sizeof(span_t));
+        return tokens;
+    }
+    return line_tokens(file, entry, spans, max);
+}
+
+/**
+ *: count_tokes
+ * @brief Counts the number of tokens in the input string based on the delimiters.
+ *
+ * @param input_string  A string to parse.
+ * @param delimiters    A string of delimiters.
+ *
+ * @return The number of tokens found, or -1 on error.
+ */
+int count_tokens(const char *input_string, const char *delimiters) {
+    if (input_string == NULL || delimiters == NULL) {
+        return -1;
+    }
+
+    delim_set_t delims;
+    delim_init(&delims, delimiters);
+    return span_tokens(input_string, strlen(input_string), &delims, NULL, 0);
 }
 
 /**
@@ -61,33 +344,24 @@ int count_tokens(const char *input_string, const char *delimiters) {
  * @return 0 on success, -1 on error.
  */
 int populate_array(const char *input_string, const char *delimiters, char ***argvp, int tokens) {
-    const char *stash = input_string + strspn(input_string, delimiters);
-    char *tokenized_string = strndup(stash, strlen(stash));
-    if (tokenized_string == NULL) {
-        return -1;
-    }
-
-    char *saveptr;
-    char *token = strtok_r(tokenized_string, delimiters, &saveptr);
-    for (int i = 0; i < tokens; i++) {
-        if (token == NULL) {
-            break;                                      // Exit the loop if no more tokens are available
-        }
+    delim_set_t delims;
+    delim_init(&delims, delimiters);
 
-        if (((*argvp)[i] = strndup(token, strlen(token))) == NULL) {
+    size_t length = strlen(input_string);
+    size_t p = delim_span(&delims, input_string, length);
+    for (int i = 0; i < tokens && p < length; i++) {
+        size_t token_length = delim_find(&delims, input_string + p, length - p);
+        if (((*argvp)[i] = strndup(input_string + p, token_length)) == NULL) {
             // Free previously allocated strings on error
             for (int j = 0; j < i; j++) {
                 free((*argvp)[j]);
             }
             free(*argvp);
-            free(tokenized_string);
             return -1;
         }
-
-        token = strtok_r(NULL, delimiters, &saveptr);
+        p += token_length;
+        p += delim_span(&delims, input_string + p, length - p);
     }
-
-    free(tokenized_string);
     return 0;
 }
 
@@ -102,47 +376,92 @@ int populate_array(const char *input_string, const char *delimiters, char ***arg
  * @return The number of elements in the array, or -1 on error.
  */
 int make_argv(const char *input_string, const char *delimiters, char ***argvp) {
-    int tokens = count_tokens(input_string, delimiters);
-    if (tokens < 0) {
-        *argvp = NULL;
+    *argvp = NULL;
+    if (input_string == NULL || delimiters == NULL) {
         return -1;
     }
 
-    // Allocate memory for the string array
-    if ((*argvp = calloc(tokens + 1, sizeof(char *))) == NULL) {
-        return -1;
+    delim_set_t delims;
+    delim_init(&delims, delimiters);
+
+    // Find the tokens (one pass; a very long line is scanned again).
+    size_t length = strlen(input_string);
+    span_t stack_spans[32];
+    span_t *spans = stack_spans;
+    int tokens = span_tokens(input_string, length, &delims, spans, 32);
+    if (tokens > 32) {
+        if ((spans = malloc(tokens * sizeof(span_t))) == NULL) {
+            return -1;
+        }
+        span_tokens(input_string, length, &delims, spans, tokens);
     }
 
-    // Populate the array with tokens
-    if (populate_array(input_string, delimiters, argvp, tokens) < 0) {
-        free(*argvp);
-        *argvp = NULL;
+    // Copy them into the string array
+    char **argv = calloc(tokens + 1, sizeof(char *));
+    for (int i = 0; argv != NULL && i < tokens; i++) {
+        if ((argv[i] = strndup(input_string + spans[i].offset, spans[i].length)) == NULL) {
+            for (int j = 0; j < i; j++) free(argv[j]);
+            free(argv);
+            argv = NULL;
+        }
+    }
+    if (spans != stack_spans) {
+        free(spans);
+    }
+    if (argv == NULL) {
         return -1;
     }
 
+    *argvp = argv;
     return tokens;
 }
 
+/**
+ *: find_config_entry
+ * @brief               Finds the first entry for a key.
+ *
+ * Arrays made by `parse_config()` are looked up through their hash
+ * index; any other array is scanned.
+ *
+ * @param config        A pointer to the configuration data.
+ * @param count         The number of configuration entries.
+ * @param name          The key to find (exact match).
+ *
+ * @return int          The entry number, or -1 if not found.
+ */
+int find_config_entry(config_t *config, int count, const char *name) {
+    config_file_t *file = find_config_file(config);
+    if (file != NULL) {
+        return config_index_find(&file->index, entry_key, file, name);
+    }
+
+    for (int i = 0; i < count; i++) {
+        stats.probes++;
+        if (config[i].values != NULL && \
+            config[i].values[0] != NULL && \
+            strcmp(config[i].values[0], name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
 /**
  *: find_config_item
  * @brief               This procedure will search and array for a given value.
  *
- * @param array         An array of char arrays to search.
- * @param value         A char array to search for.
+ * @param config        A pointer to the configuration data.
+ * @param name          The key to find (exact match).
+ * @param count         The number of configuration entries.
  *
- * @returns 0 = Not found. 1 = Item found.
+ * @returns config_t*   The first entry for `name`, or NULL if not found.
  */
 config_t* find_config_item(config_t* config, const char* name, int count) {
-  for (int i = 0; i < count; i++) {
-    if (config[i].values != NULL && \
-        config[i].values[0] != NULL) {
-//:~        if (strncmp(config[i].values[0], name, strlen(config[i].values[0])) == 0) {
-      if (strcmp(config[i].values[0], name) == 0) {
-        return &config[i];
-      }
+    int i = find_config_entry(config, count, name);
+    if (i < 0 || config_entry_values(config, i) == NULL) {
+        return NULL;
     }
-  }
-  return NULL;
+    return &config[i];
 }
 
 /**
@@ -165,11 +484,583 @@ int contains(char **array, int size, const char *value) {
     return 0; // Not found
 }
 
+/**
+ *: config_allocations
+ * @brief               Reports the heap allocations behind a parsed
+ *                      config array (not counting the array itself).
+ *
+ * @param config        An array returned by `parse_config()`.
+ *
+ * @return size_t       The number of arena blocks in use, or 0 if
+ *                      `config` was not made by `parse_config()`.
+ */
+size_t config_allocations(const config_t *config) {
+    config_file_t *file = find_config_file(config);
+    return file ? file->arena.blocks + (file->lines != NULL) : 0;
+}
+
+/**
+ *: skip_line
+ * @brief               Decides if a line should be ignored by the parser.
+ *
+ * @param c             The first non-space character on the line.
+ *
+ * @return 1 = skip (blank/comment/section), 0 = parse.
+ */
+int skip_line(char c) {
+    return c == '\0' || \
+           c == '#' || \
+           c == ';' || \
+           c == '/' || \
+           c == '*' || \
+           c == '\n'|| \
+           c == '[';
+}
+
+/**
+ *: find_config_line
+ * @brief               `next_config_line()`, counting the lines looked
+ *                      at in `*lines` (a worker thread's own counter).
+ *
+ * @param pos           Current position; advanced past the line found.
+ * @param end           End of the buffer.
+ * @param line_end      Set to the end of the line found (past '\n').
+ * @param lines         Incremented for every line looked at.
+ *
+ * @return const char*  The first non-space character of the line, or
+ *                      NULL when the buffer is exhausted.
+ */
+static const char *find_config_line(const char **pos, const char *end, const char **line_end,
+                                    uint64_t *lines) {
+    while (*pos < end) {
+        const char *eol = memchr(*pos, '\n', end - *pos);
+        const char *next = eol ? eol + 1 : end;
+        const char *str = *pos;
+        *pos = next;
+        (*lines)++;
+
+        while (str < next && isspace((unsigned char)*str)) str++;
+        if (str == next || skip_line(*str)) {
+            continue;
+        }
+        *line_end = next;
+        return str;
+    }
+    return NULL;
+}
+
+/**
+ *: next_config_line
+ * @brief               Finds the next line worth parsing in a buffer.
+ *
+ * @param pos           Current position; advanced past the line found.
+ * @param end           End of the buffer.
+ * @param line_end      Set to the end of the line found (past '\n').
+ *
+ * @return const char*  The first non-space character of the line, or
+ *                      NULL when the buffer is exhausted.
+ */
+const char *next_config_line(const char **pos, const char *end, const char **line_end) {
+    return find_config_line(pos, end, line_end, &stats.lines);
+}
+
+/**
+ *: span_tokens
+ * @brief               Finds the tokens in a (not nul-terminated) line
+ *                      without copying them.
+ *
+ * @param line          Start of the text to tokenize.
+ * @param length        Number of bytes in `line`.
+ * @param delims        The delimiter set (see delim-scan.h).
+ * @param spans         Filled with the position (relative to `line`)
+ *                      and length of each token.
+ * @param max           The number of elements in `spans`.
+ *
+ * @return int          The number of tokens in the line (only the
+ *                      first `max` are stored).
+ */
+int span_tokens(const char *line, size_t length, const delim_set_t *delims,
+                span_t *spans, int max) {
+    return delim_tokens(delims, line, length, spans, max);
+}
+
+/**
+ *: open_config
+ * @brief               Loads a configuration file, creating it if it
+ *                      cannot be read.
+ *
+ * @param filename      The name of the configuration file.
+ * @param file          The buffer to load the file into.
+ * @param may_map       1 = load it with `load_file()`, 0 = always read
+ *                      it into memory (see `read_file()`).
+ *
+ * @return 0 on success, -1 on error (reported on stderr).
+ */
+static int open_config(const char *filename, file_buffer_t *file, int may_map) {
+    // If we cannot open the file for 'read', assume it doesn't exist
+    // and open for 'write' (to create it).
+    if ((may_map ? load_file(filename, file) : read_file(filename, file)) < 0) {
+        FILE *created = fopen(filename, "w");
+        // If we still don't have a file, we must have some situation
+        // where we cannot create one. Report why and exit.
+        if (!created) {
+            fprintf(stderr, "%s\n", strerror(errno));
+            return -1;
+        }
+        fclose(created);
+        file->data = NULL;
+        file->length = 0;
+        file->mapped = 0;
+    }
+    return 0;
+}
+
+/**
+ *: new_config_file
+ * @brief               Allocates the bookkeeping for a parsed file.
+ *
+ * @param file          The loaded file (now owned by the record).
+ * @param capacity      The number of entries to allocate first.
+ * @param delims        The delimiter set its lines are tokenized with.
+ *
+ * @return config_file_t*  The record, or NULL on error (`file` is
+ *                      unloaded).
+ */
+static config_file_t *new_config_file(file_buffer_t *file, size_t capacity, const delim_set_t *delims) {
+    config_file_t *record = malloc(sizeof(config_file_t));
+    if (record == NULL) {
+        unload_file(file);
+        return NULL;
+    }
+    // Only the values that are asked for are copied, so a small
+    // first block will do.
+    arena_init(&record->arena, 4096);
+    memset(&record->index, 0, sizeof(record->index));
+    record->buffer = *file;
+    record->delims = *delims;
+    record->capacity = capacity;
+    record->config = malloc(capacity * sizeof(config_t));
+    record->lines = malloc(capacity * sizeof(entry_line_t));
+    if (!record->config || !record->lines) {
+        free(record->config);
+        free(record->lines);
+        unload_file(&record->buffer);
+        free(record);
+        return NULL;
+    }
+    stats.allocations += 3;
+    stats.allocated_bytes += sizeof(config_file_t) + capacity * (sizeof(config_t) + sizeof(entry_line_t));
+    return record;
+}
+
+/**
+ *: release_config_file
+ * @brief               Releases the bookkeeping of a parsed file (not
+ *                      the config_t array).
+ *
+ * @param record        The record to release.
+ */
+static void release_config_file(config_file_t *record) {
+    config_index_free(&record->index);
+    arena_free(&record->arena);
+    free(record->lines);
+    unload_file(&record->buffer);
+    free(record);
+}
+
+/**
+ *: append_entry
+ * @brief               Appends an entry to a growing config_t array.
+ *
+ * @param config        The array (may be moved).
+ * @param capacity      The number of entries allocated.
+ * @param entries       The number of entries used.
+ * @param argv          The tokens for the entry.
+ * @param argc          The number of tokens.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int append_entry(config_t **config, size_t *capacity, int *entries, char **argv, int argc) {
+    if ((size_t)*entries == *capacity) {
+        config_t *grown = realloc(*config, *capacity * 2 * sizeof(config_t));
+        if (grown == NULL) {
+            return -1;
+        }
+        *config = grown;
+        *capacity *= 2;
+        stats.allocations++;
+        stats.allocated_bytes += *capacity * sizeof(config_t);
+    }
+    (*config)[*entries].values = argv;
+    (*config)[*entries].value_count = argc;
+    (*entries)++;
+    return 0;
+}
+
+/**
+ *: line_key
+ * @brief               Finds the key of a line (its first token) and
+ *                      records where the entry is.
+ *
+ * @param delims        The delimiter set.
+ * @param base          The loaded file.
+ * @param line          The line (in `base`).
+ * @param length        Number of bytes in `line`.
+ * @param entry         Filled in.
+ *
+ * @return int          1, or 0 for a line with no tokens.
+ */
+static int line_key(const delim_set_t *delims, const char *base, const char *line, size_t length,
+                    entry_line_t *entry) {
+    size_t start = delim_span(delims, line, length);
+    if (start == length) {
+        return 0;
+    }
+    entry->key.offset = line + start - base;
+    entry->key.length = delim_find(delims, line + start, length - start);
+    entry->end = line + length - base;
+    entry->tokens = NULL;
+    return 1;
+}
+
+/**
+ *: append_line
+ * @brief               Records a line as a new entry; only its key is
+ *                      found now, its tokens and C strings later, if
+ *                      asked for (see `entry_tokens()`).
+ *
+ * @param record        The bookkeeping of the file being parsed.
+ * @param entries       The number of entries used (updated).
+ * @param line          The line (in `record->buffer`).
+ * @param length        Number of bytes in `line`.
+ *
+ * @return int          1, 0 for a line with no tokens, or -1 on error.
+ */
+static int append_line(config_file_t *record, int *entries, const char *line, size_t length) {
+    entry_line_t entry;
+    if (line_key(&record->delims, record->buffer.data, line, length, &entry) == 0) {
+        return 0;
+    }
+    if (*entries == INT_MAX) {                          /* the count is an int */
+        errno = EOVERFLOW;
+        return -1;
+    }
+
+    if ((size_t)*entries == record->capacity) {
+        entry_line_t *lines = realloc(record->lines, record->capacity * 2 * sizeof(entry_line_t));
+        if (lines == NULL) {
+            return -1;
+        }
+        record->lines = lines;
+        stats.allocations++;
+        stats.allocated_bytes += record->capacity * 2 * sizeof(entry_line_t);
+    }
+    record->lines[*entries] = entry;
+    if (append_entry(&record->config, &record->capacity, entries, NULL, 0) < 0) {
+        return -1;
+    }
+    return 1;
+}
+
+/**
+ *: register_config
+ * @brief               Indexes a parsed array and records it so it can
+ *                      be found again by the lookup and free functions.
+ *                      On error everything is released.
+ *
+ * @param record        The bookkeeping (holds the array).
+ * @param entries       The number of parsed entries.
+ * @param hashes        The hash of each key, or NULL (see
+ *                      `config_index_build_hashed()`).
+ *
+ * @return config_t*    The array, or NULL on error.
+ */
+static config_t *register_config(config_file_t *record, int entries, const uint32_t *hashes) {
+    if (config_index_build_hashed(&record->index, entry_key, record, entries, hashes) < 0) {
+        free(record->config);
+        release_config_file(record);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&config_files_lock);
+    record->next = config_files;
+    config_files = record;
+    pthread_mutex_unlock(&config_files_lock);
+    return record->config;
+}
+
+static int parse_threads = 1;                           /* see set_parse_threads() */
+static size_t parse_parallel_bytes = PARSE_PARALLEL_MIN_BYTES;
+
+/**
+ *: set_parse_threads
+ * @brief               Sets how many threads `parse_config()` may use
+ *                      and how big a file must be before it does.
+ *
+ * @param threads       The number of threads; 0 = one per CPU, 1 =
+ *                      parse on the calling thread only (the default).
+ * @param min_bytes     Smaller files are parsed on the calling thread.
+ */
+void set_parse_threads(int threads, size_t min_bytes) {
+    if (threads <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? (int)cpus : 1;
+    }
+    parse_threads = threads;
+    parse_parallel_bytes = min_bytes;
+}
+
+// The part of a file one thread parses, and what it found
+typedef struct {
+    const char *start;                                  /* whole lines of the file */
+    const char *end;
+    const char *base;                                   /* the file; spans are relative to it */
+    const delim_set_t *delims;
+    entry_line_t *lines;                                /* per entry: where it is ... */
+    uint32_t *hashes;                                   /* ... and the hash of its key */
+    size_t entries;
+    size_t capacity;
+    uint64_t line_count;                                /* counters for `stats` */
+    uint64_t allocations;
+    uint64_t allocated_bytes;
+    int failed;
+} parse_chunk_t;
+
+/**
+ *: grow_chunk
+ * @brief               Makes room in a chunk's tables for one more
+ *                      entry.
+ *
+ * @param chunk         The chunk.
+ *
+ * @return 0 on success, -1 when out of memory.
+ */
+static int grow_chunk(parse_chunk_t *chunk) {
+    if (chunk->entries == chunk->capacity) {
+        size_t capacity = chunk->capacity ? chunk->capacity * 2 : 256;
+        entry_line_t *lines = realloc(chunk->lines, capacity * sizeof(entry_line_t));
+        if (lines != NULL)
+            chunk->lines = lines;
+        uint32_t *hashes = realloc(chunk->hashes, capacity * sizeof(uint32_t));
+        if (hashes != NULL)
+            chunk->hashes = hashes;
+        if (!lines || !hashes)
+            return -1;
+        chunk->capacity = capacity;
+        chunk->allocations += 2;
+        chunk->allocated_bytes += capacity * (sizeof(entry_line_t) + sizeof(uint32_t));
+    }
+    return 0;
+}
+
+/**
+ *: parse_chunk
+ * @brief               Finds the keys of the lines of a chunk and
+ *                      hashes them (runs on a worker thread).
+ *
+ * @param arg           The parse_chunk_t to fill.
+ *
+ * @return NULL.
+ */
+static void *parse_chunk(void *arg) {
+    parse_chunk_t *chunk = arg;
+    const char *pos = chunk->start;
+    const char *line_end;
+    const char *str;
+    entry_line_t entry;
+
+    while ((str = find_config_line(&pos, chunk->end, &line_end, &chunk->line_count)) != NULL) {
+        if (line_key(chunk->delims, chunk->base, str, line_end - str, &entry) == 0)
+            continue;
+        if (grow_chunk(chunk) < 0) {
+            chunk->failed = 1;
+            break;
+        }
+        chunk->lines[chunk->entries] = entry;
+        chunk->hashes[chunk->entries] = config_hash(chunk->base + entry.key.offset, entry.key.length);
+        chunk->entries++;
+    }
+    return NULL;
+}
+
+/**
+ *: parse_parallel
+ * @brief               Parses a loaded file on several threads.
+ *
+ * The file is cut into one chunk per thread at line boundaries; each
+ * thread finds the keys of its lines and hashes them. The chunks are
+ * then copied, in file order, into the tables `parse_config()` would
+ * have built, so the entries and the first occurrence of each key are
+ * the same as for a serial parse.
+ *
+ * @param record        The bookkeeping of the file (tables replaced).
+ * @param threads       The number of threads (2 or more).
+ * @param hashesp       Set to the hash of every entry's key.
+ *
+ * @return int          The number of entries, or -1 on error.
+ */
+static int parse_parallel(config_file_t *record, int threads, uint32_t **hashesp) {
+    const char *data = record->buffer.data;
+    size_t length = record->buffer.length;
+    parse_chunk_t chunks[threads];
+    pthread_t workers[threads];
+    int started[threads];
+
+    // Cut the file into even shares, moved on to the next line.
+    const char *start = data;
+    for (int t = 0; t < threads; t++) {
+        const char *end = data + length;
+        const char *share = data + length / threads * (t + 1);
+        if (t == threads - 1) {
+            // (the rest of the file)
+        } else if (share <= start) {
+            end = start;                                /* a long line took this share */
+        } else {
+            const char *eol = memchr(share - 1, '\n', end - (share - 1));
+            end = eol ? eol + 1 : end;
+        }
+        memset(&chunks[t], 0, sizeof(parse_chunk_t));
+        chunks[t].start = start;
+        chunks[t].end = end;
+        chunks[t].base = data;
+        chunks[t].delims = &record->delims;
+        start = end;
+    }
+
+    // The calling thread parses the first chunk itself.
+    for (int t = 1; t < threads; t++) {
+        started[t] = pthread_create(&workers[t], NULL, parse_chunk, &chunks[t]) == 0;
+        if (!started[t])
+            parse_chunk(&chunks[t]);
+    }
+    parse_chunk(&chunks[0]);
+    for (int t = 1; t < threads; t++) {
+        if (started[t])
+            pthread_join(workers[t], NULL);
+    }
+
+    size_t entries = 0;
+    int failed = 0;
+    for (int t = 0; t < threads; t++) {
+        entries += chunks[t].entries;
+        failed |= chunks[t].failed;
+        stats.lines += chunks[t].line_count;
+        stats.allocations += chunks[t].allocations;
+        stats.allocated_bytes += chunks[t].allocated_bytes;
+    }
+    if (!failed && entries > INT_MAX) {                 /* the count is an int */
+        errno = EOVERFLOW;
+        failed = 1;
+    }
+
+    // Stitch the chunks together, in order.
+    uint32_t *hashes = NULL;
+    if (!failed) {
+        size_t capacity = entries > 16 ? entries : 16;
+        config_t *config = realloc(record->config, capacity * sizeof(config_t));
+        if (config != NULL)
+            record->config = config;
+        entry_line_t *lines = realloc(record->lines, capacity * sizeof(entry_line_t));
+        if (lines != NULL)
+            record->lines = lines;
+        hashes = malloc(capacity * sizeof(uint32_t));
+        failed = !config || !lines || !hashes;
+        if (!failed) {
+            record->capacity = capacity;
+            stats.allocations += 3;
+            stats.allocated_bytes += capacity * (sizeof(config_t) + sizeof(entry_line_t) + sizeof(uint32_t));
+        }
+    }
+
+    size_t entry = 0;
+    for (int t = 0; t < threads; t++) {
+        parse_chunk_t *chunk = &chunks[t];
+        if (!failed) {
+            memcpy(record->lines + entry, chunk->lines, chunk->entries * sizeof(entry_line_t));
+            memcpy(hashes + entry, chunk->hashes, chunk->entries * sizeof(uint32_t));
+            for (size_t i = 0; i < chunk->entries; i++, entry++) {
+                record->config[entry].values = NULL;
+                record->config[entry].value_count = 0;
+            }
+        }
+        free(chunk->lines);
+        free(chunk->hashes);
+    }
+    if (failed) {
+        free(hashes);
+        return -1;
+    }
+
+    *hashesp = hashes;
+    return (int)entries;
+}
+
+/**
+ *: parse_loaded
+ * @brief               `parse_config()` for a file already in memory.
+ *
+ * @param file          The loaded file (now owned by the result).
+ * @param count         A pointer to store the number of entries.
+ * @param delimiters    A char array of delimiters for tokenization.
+ *
+ * @return config_t*    The parsed configuration data, or NULL on error.
+ */
+static config_t *parse_loaded(file_buffer_t *file, int *count, char *delimiters) {
+    delim_set_t delims;                                 /* delimiter scanner */
+    delim_init(&delims, delimiters);
+
+    int entries = 0;                                    /* entries used in `config` */
+    config_file_t *record = new_config_file(file, 16, &delims);
+    if (record == NULL) {
+        return NULL;
+    }
+
+    // A big file may be split between threads (see set_parse_threads()).
+    if (parse_threads > 1 && record->buffer.length >= parse_parallel_bytes) {
+        uint32_t *hashes;
+        entries = parse_parallel(record, parse_threads, &hashes);
+        if (entries < 0) {
+            free(record->config);
+            release_config_file(record);
+            return NULL;
+        }
+        *count = entries;
+        config_t *config = register_config(record, entries, hashes);
+        free(hashes);
+        return config;
+    }
+
+    const char *pos = record->buffer.data;
+    const char *end = pos + record->buffer.length;
+    const char *line_end;
+    const char *str;
+    while ((str = next_config_line(&pos, end, &line_end)) != NULL) {
+        if (append_line(record, &entries, str, line_end - str) < 0) {
+            free(record->config);
+            release_config_file(record);
+            return NULL;
+        }
+    }
+
+    *count = entries;
+    return register_config(record, entries, NULL);
+}
+
 /**
  *: parse_config
  *  @brief  Parse the configuration file and store the data in a
  *          config_t array.
  *
+ * The file is loaded in one piece (see `load_file()`) and walked once;
+ * the config_t array grows as entries are found so there is no
+ * separate counting pass. Only each line's key is found (an (offset,
+ * length) span of the loaded file) and where the line ends; the line
+ * is tokenized the first time its tokens are asked for (see
+ * `config_view_tokens()`), and an entry's `values` stay NULL until
+ * they are asked for with `config_entry_values()` (or found with
+ * `get_value()`/`find_config_item()`). Both go into one arena per
+ * file which `free_config()` releases in one go.
+ *
  * @param filename      The name of the configuration file.
  * @param count         A pointer to store the number of configuration
  *                      entries.
@@ -179,79 +1070,551 @@ int contains(char **array, int size, const char *value) {
  *                      NULL on error.
  */
 config_t* parse_config(const char* filename, int* count, char *delimiters) {
-    // Open the configuration file
-    FILE* file = fopen(filename, "r");
-    // If we cannot open the file for 'read', assume it doesn't exist
-    // and open for 'write' (to create it).
-    if (!file) {
-      file = fopen(filename, "w");
+    file_buffer_t file;
+    if (open_config(filename, &file, 1) < 0) {
+        return NULL;
     }
-    // If we still don't have a file, we must have some situation
-    // where we cannot create one. Report why and exit.
-    if (!file) {
-        fprintf(stderr, "%s\n", strerror(errno));
+    return parse_loaded(&file, count, delimiters);
+}
+
+/**
+ *: parse_config_read
+ *  @brief  Like `parse_config()`, but the file is read into memory,
+ *          never mapped.
+ *
+ * An array that is kept while other processes may change the file
+ * needs its own copy: the pages of a mapped file that is truncated
+ * fault (SIGBUS) when they are read.
+ *
+ * @param filename      The name of the configuration file.
+ * @param count         A pointer to store the number of configuration
+ *                      entries.
+ * @param delimiters    A char array of delimiters for tokenization.
+ *
+ * @return config_t*    A pointer to the parsed configuration data, or
+ *                      NULL on error.
+ */
+config_t* parse_config_read(const char* filename, int* count, char *delimiters) {
+    file_buffer_t file;
+    if (open_config(filename, &file, 0) < 0) {
         return NULL;
     }
+    return parse_loaded(&file, count, delimiters);
+}
+
+// The files `parse_config_files()` shares out between its threads, in
+// the order they are loaded
+typedef struct {
+    const char **filenames;
+    char *delimiters;
+    config_t **configs;
+    int *counts;
+    int file_count;
+    file_buffer_t *buffers;                             /* each file, once loaded */
+    int *errors;                                        /* errno of a file that did not load */
+    int *ready;                                         /* the files loaded so far, in order */
+    int ready_count;
+    int next;                                           /* the next of `ready` to take */
+    int loading;                                        /* 1 = more files are coming */
+    int failed;
+    stats_t stats;                                      /* the worker threads' counters */
+    pthread_mutex_t lock;
+    pthread_cond_t more;                                /* a file was loaded (or all were) */
+} parse_jobs_t;
+
+/**
+ *: file_loaded
+ * @brief               Queues a file that `load_files()` has loaded.
+ *
+ * @param arg           The parse_jobs_t.
+ * @param file          The file number.
+ * @param buffer        The file, or NULL.
+ * @param error         The errno if it did not load.
+ */
+static void file_loaded(void *arg, int file, file_buffer_t *buffer, int error) {
+    parse_jobs_t *jobs = arg;
+    pthread_mutex_lock(&jobs->lock);
+    if (buffer != NULL)
+        jobs->buffers[file] = *buffer;
+    jobs->errors[file] = buffer != NULL ? 0 : error;
+    jobs->ready[jobs->ready_count++] = file;
+    pthread_cond_signal(&jobs->more);
+    pthread_mutex_unlock(&jobs->lock);
+}
+
+/**
+ *: parse_jobs
+ * @brief               Parses files as they are loaded until there are
+ *                      none left (runs on each thread).
+ *
+ * @param arg           The parse_jobs_t.
+ *
+ * @return NULL.
+ */
+static void *parse_jobs(void *arg) {
+    parse_jobs_t *jobs = arg;
+    for (;;) {
+        pthread_mutex_lock(&jobs->lock);
+        while (jobs->next == jobs->ready_count && jobs->loading)
+            pthread_cond_wait(&jobs->more, &jobs->lock);
+        int i = jobs->next < jobs->ready_count ? jobs->ready[jobs->next++] : -1;
+        pthread_mutex_unlock(&jobs->lock);
+        if (i < 0)
+            break;
+
+        // A file that did not load is skipped (not created, as
+        // `parse_config()` would); its array stays NULL.
+        if (jobs->errors[i] == 0)
+            jobs->configs[i] = parse_loaded(&jobs->buffers[i], &jobs->counts[i], jobs->delimiters);
+        if (jobs->configs[i] == NULL) {
+            pthread_mutex_lock(&jobs->lock);
+            jobs->failed = 1;
+            pthread_mutex_unlock(&jobs->lock);
+        }
+    }
+    return NULL;
+}
 
-    int lines = 0;                                      /* Count the number of lines */
-    char buffer[1024];                                  /* buffer stores the line */
-    char **argv;
-    int argc;
-
-    // Parse the configuration file
-    while (fgets(buffer, sizeof(buffer), file)) {
-      char *str = buffer;
-      while (isspace(*str)) str++;
-      if (*str == '\0' || \
-          *str == '#' || \
-          *str == ';' || \
-          *str == '/' || \
-          *str == '*' || \
-          *str == '\n'|| \
-          *str == '[') {
-        continue;
-      }
-
-      lines++;
-    }
-
-    // Allocate memory for the configuration data
-    config_t* config = malloc((lines * 1) * sizeof(config_t));
-    if (!config) {
-        fclose(file);
+/**
+ *: worker_jobs
+ * @brief               `parse_jobs()` on a worker thread; its counters
+ *                      are handed back when it is done.
+ *
+ * @param arg           The parse_jobs_t.
+ *
+ * @return NULL.
+ */
+static void *worker_jobs(void *arg) {
+    parse_jobs_t *jobs = arg;
+    parse_jobs(jobs);
+    pthread_mutex_lock(&jobs->lock);
+    stats_add(&jobs->stats, &stats);
+    pthread_mutex_unlock(&jobs->lock);
+    return NULL;
+}
+
+/**
+ *: parse_config_files
+ *  @brief  Parse several configuration files at the same time.
+ *
+ * The calling thread loads the files (see `load_files()`, which
+ * batches the system calls through io_uring where it can) and up to
+ * `threads` - 1 others parse each one as soon as it is in memory; the
+ * calling thread takes its share once every file is loaded. The
+ * arrays are as if each file had been parsed in turn with
+ * `parse_config()`, except that a file that cannot be read is not
+ * created: its array is left NULL.
+ *
+ * @param filenames     The configuration files.
+ * @param file_count    The number of files.
+ * @param delimiters    A char array of delimiters for tokenization.
+ * @param configs       Set to the array of each file (NULL if it could
+ *                      not be parsed).
+ * @param counts        Set to the number of entries of each file.
+ * @param threads       The most threads to use (0 = one per file).
+ *
+ * @return 0 if every file was parsed, -1 otherwise.
+ */
+int parse_config_files(const char **filenames, int file_count, char *delimiters,
+                       config_t **configs, int *counts, int threads) {
+    parse_jobs_t jobs;
+    memset(&jobs, 0, sizeof(jobs));
+    jobs.filenames = filenames;
+    jobs.delimiters = delimiters;
+    jobs.configs = configs;
+    jobs.counts = counts;
+    jobs.file_count = file_count;
+    jobs.buffers = calloc(file_count > 0 ? file_count : 1, sizeof(file_buffer_t));
+    jobs.errors = calloc(file_count > 0 ? file_count : 1, sizeof(int));
+    jobs.ready = calloc(file_count > 0 ? file_count : 1, sizeof(int));
+    jobs.loading = 1;
+    for (int i = 0; i < file_count; i++) {
+        configs[i] = NULL;
+        counts[i] = 0;
+    }
+    if (!jobs.buffers || !jobs.errors || !jobs.ready) {
+        free(jobs.buffers);
+        free(jobs.errors);
+        free(jobs.ready);
+        return -1;
+    }
+    pthread_mutex_init(&jobs.lock, NULL);
+    pthread_cond_init(&jobs.more, NULL);
+    if (threads <= 0 || threads > file_count)
+        threads = file_count;
+
+    pthread_t workers[threads > 1 ? threads - 1 : 1];
+    int started = 0;
+    for (; started < threads - 1; started++) {
+        if (pthread_create(&workers[started], NULL, worker_jobs, &jobs) != 0)
+            break;
+    }
+    load_files(filenames, file_count, file_loaded, &jobs);
+    pthread_mutex_lock(&jobs.lock);
+    jobs.loading = 0;
+    pthread_cond_broadcast(&jobs.more);
+    pthread_mutex_unlock(&jobs.lock);
+    parse_jobs(&jobs);
+    for (int t = 0; t < started; t++) {
+        pthread_join(workers[t], NULL);
+    }
+
+    stats_add(&stats, &jobs.stats);
+    pthread_cond_destroy(&jobs.more);
+    pthread_mutex_destroy(&jobs.lock);
+    free(jobs.buffers);
+    free(jobs.errors);
+    free(jobs.ready);
+    return jobs.failed ? -1 : 0;
+}
+
+/**
+ *: make_argv_arena
+ * @brief               Like `make_argv()` but reads a (not
+ *                      nul-terminated) span and allocates the tokens
+ *                      and the array from `arena`.
+ *
+ * @param arena         The arena to allocate from.
+ * @param line          Start of the text to tokenize.
+ * @param length        Number of bytes in `line`.
+ * @param delims        The delimiter set (see delim-scan.h).
+ * @param argvp         An array to store the tokens.
+ *
+ * @return The number of elements in the array, or -1 on error.
+ */
+static int make_argv_arena(arena_t *arena, const char *line, size_t length,
+                           const delim_set_t *delims, char ***argvp) {
+    span_t stack_spans[32];                             /* enough for most lines */
+    span_t *spans = stack_spans;
+
+    int tokens = span_tokens(line, length, delims, spans, 32);
+    if (tokens > 32) {
+        if ((spans = malloc(tokens * sizeof(span_t))) == NULL) {
+            return -1;
+        }
+        span_tokens(line, length, delims, spans, tokens);
+    }
+
+    char **argv = arena_alloc(arena, (tokens + 1) * sizeof(char *));
+    for (int i = 0; argv != NULL && i < tokens; i++) {
+        if ((argv[i] = arena_strndup(arena, line + spans[i].offset, spans[i].length)) == NULL) {
+            argv = NULL;
+        }
+    }
+    if (spans != stack_spans) {
+        free(spans);
+    }
+    if (argv == NULL) {
+        return -1;
+    }
+    argv[tokens] = NULL;
+    stats.tokens += tokens;
+
+    *argvp = argv;
+    return tokens;
+}
+
+/**
+ *: scan_config
+ *  @brief  Find a few keys in a configuration file without parsing
+ *          the rest of it.
+ *
+ * The file is streamed a line at a time (see `read_line()`), so this
+ * needs one read buffer plus the longest line whatever the size of
+ * the file, and works on pipes. Only the first token of each line is
+ * looked at (and checked against a small hash set of the wanted
+ * keys) until every key has been found. Only the matching lines are
+ * tokenized. The returned array holds the first entry for each key
+ * that was found and works with `get_value()`, `find_config_item()`
+ * and `free_config()` just like one from `parse_config()`.
+ *
+ * @param filename      The name of the configuration file.
+ * @param count         A pointer to store the number of entries found.
+ * @param delimiters    A char array of delimiters for tokenization.
+ * @param keys          The keys to look for.
+ * @param key_count     The number of keys.
+ *
+ * @return config_t*    A pointer to the entries found, or NULL on error.
+ */
+config_t* scan_config(const char* filename, int* count, char *delimiters,
+                      const char **keys, int key_count) {
+    line_reader_t reader;
+    if (open_lines(filename, &reader, 0) < 0) {
+        // As `open_config()`: create a file that is not there.
+        FILE *created = fopen(filename, "w");
+        if (!created) {
+            fprintf(stderr, "%s\n", strerror(errno));
+            return NULL;
+        }
+        fclose(created);
+        if (open_lines(filename, &reader, 0) < 0) {
+            return NULL;
+        }
+    }
+
+    delim_set_t delims;                                 /* delimiter scanner */
+    delim_init(&delims, delimiters);
+
+    // A small open-addressing set of the wanted keys; slots hold the
+    // key number + 1 (0 = empty).
+    size_t size = 16;
+    while (size < (size_t)key_count * 2) size *= 2;
+    int *slots = calloc(size, sizeof(int));
+    uint32_t *hashes = malloc((key_count + 1) * sizeof(uint32_t));
+    char *found = calloc(key_count + 1, 1);
+    int entries = 0;                                    /* entries used in `config` */
+    file_buffer_t none = { NULL, 0, 0 };                /* (nothing is kept loaded) */
+    config_file_t *record = new_config_file(&none, key_count > 0 ? key_count : 1, &delims);
+    if (!slots || !hashes || !found || !record) {
+        free(slots);
+        free(hashes);
+        free(found);
+        if (record) {
+            free(record->config);
+            release_config_file(record);
+        }
+        close_lines(&reader);
         return NULL;
     }
 
-    // Reset the file pointer to the beginning of the file
-    rewind(file);
+    int wanted = 0;                                     /* distinct keys still to find */
+    for (int k = 0; k < key_count; k++) {
+        hashes[k] = config_hash(keys[k], strlen(keys[k]));
+        size_t slot = hashes[k] & (size - 1);
+        while (slots[slot] != 0 && strcmp(keys[slots[slot] - 1], keys[k]) != 0)
+            slot = (slot + 1) & (size - 1);
+        if (slots[slot] == 0) {
+            slots[slot] = k + 1;
+            wanted++;
+        }
+    }
+
+    const char *line;
+    size_t line_length;
+    while (wanted > 0 && (line = read_line(&reader, &line_length)) != NULL) {
+        const char *pos = line;
+        const char *line_end;
+        const char *str = next_config_line(&pos, line + line_length, &line_end);
+        if (str == NULL) {
+            continue;
+        }
+
+        // Find the key (first token) of the line.
+        const char *key = str + delim_span(&delims, str, line_end - str);
+        const char *key_end = key + delim_find(&delims, key, line_end - key);
+        if (key == key_end) {
+            continue;
+        }
 
-    // Parse the configuration file
-    int i = 0;
-    while (fgets(buffer, sizeof(buffer), file)) {
-      char *str = buffer;
-      while (isspace(*str)) str++;
-      if (*str == '\0' || \
-          *str == '#' || \
-          *str == ';' || \
-          *str == '/' || \
-          *str == '*' || \
-          *str == '\n'|| \
-          *str == '[') {
-        continue;
-      }
+        size_t length = key_end - key;
+        uint32_t hash = config_hash(key, length);
+        size_t slot = hash & (size - 1);
+        int k;
+        while ((k = slots[slot]) != 0) {
+            stats.probes++;
+            if (hashes[k - 1] == hash && \
+                strncmp(keys[k - 1], key, length) == 0 && keys[k - 1][length] == '\0')
+                break;
+            slot = (slot + 1) & (size - 1);
+        }
+        if (k == 0 || found[k - 1]) {
+            continue;
+        }
 
-      argc = make_argv(str, delimiters, &argv);
+        // The line is gone after the next read; copy it now.
+        char **argv;
+        int argc = make_argv_arena(&record->arena, str, line_end - str, &delims, &argv);
+        if (argc < 0 || append_entry(&record->config, &record->capacity, &entries, argv, argc) < 0) {
+            entries = -1;
+            break;
+        }
+        found[k - 1] = 1;
+        wanted--;
+    }
+    if (reader.error) {
+        errno = reader.error;
+        entries = -1;
+    }
 
-      if (argc > 0) {
-        config[i].values = argv;
-        config[i].value_count = argc;
-      }
-      i++;
+    free(slots);
+    free(hashes);
+    free(found);
+    close_lines(&reader);
+    if (entries < 0) {
+        free(record->config);
+        release_config_file(record);
+        return NULL;
     }
 
-    *count = i;
-    fclose(file);
-    return config;
+    *count = entries;
+    return register_config(record, entries, NULL);
+}
+
+/**
+ *: lookup_config
+ *  @brief  Find the first entry for one key in a configuration file
+ *          without tokenizing any other line.
+ *
+ * The loaded file is searched for the key itself (`memmem()`), and a
+ * match only counts if it is the first token of a line the parser
+ * would read; then only that line is recorded and the search stops
+ * (its values are tokenized if they are asked for, as for
+ * `parse_config()`; a check that the key is there never does).
+ * The rest of the line a match that does not count is on is skipped
+ * (its key, if any, came before the match). A mapped file is only read
+ * up to the line that is found, so a key near the top of a big file
+ * costs about as much as in a small one. The returned array holds the
+ * entry, if found, and works like the one from `scan_config()`.
+ *
+ * @param filename      The name of the configuration file.
+ * @param count         Set to 1 if the key was found, 0 if not.
+ * @param delimiters    A char array of delimiters for tokenization.
+ * @param key           The key.
+ *
+ * @return config_t*    A pointer to the entry found, or NULL on error.
+ */
+config_t* lookup_config(const char* filename, int* count, char *delimiters, const char *key) {
+    file_buffer_t file;
+    if (open_config(filename, &file, 1) < 0) {
+        return NULL;
+    }
+
+    delim_set_t delims;                                 /* delimiter scanner */
+    delim_init(&delims, delimiters);
+
+    int entries = 0;
+    config_file_t *record = new_config_file(&file, 1, &delims);
+    if (record == NULL) {
+        return NULL;
+    }
+
+    const char *pos = record->buffer.data;              /* (always the start of a line) */
+    const char *end = pos + record->buffer.length;
+    size_t length = strlen(key);
+    const char *match;
+    while (length > 0 && pos < end && (match = memmem(pos, end - pos, key, length)) != NULL) {
+        const char *str = match;
+        while (str > pos && str[-1] != '\n') str--;
+        const char *eol = memchr(match, '\n', end - match);
+        const char *line_end = eol ? eol + 1 : end;
+        pos = line_end;
+        stats.probes++;
+
+        // Is it the key of a line that is parsed?
+        while (str < line_end && isspace((unsigned char)*str)) str++;
+        if (str == line_end || skip_line(*str) || \
+            str + delim_span(&delims, str, line_end - str) != match || \
+            delim_find(&delims, match, line_end - match) != length) {
+            continue;
+        }
+        stats.lines++;
+        if (append_line(record, &entries, str, line_end - str) < 0) {
+            free(record->config);
+            release_config_file(record);
+            return NULL;
+        }
+        break;
+    }
+
+    *count = entries;
+    return register_config(record, entries, NULL);
+}
+
+/**
+ *: set_config_item
+ * @brief               Sets the values of a key in a parsed config array.
+ *
+ * The first entry for the key is replaced and any later entries for
+ * it are dropped (this is what `replacevariable()` does to the file);
+ * a new key is appended. The strings are copied.
+ *
+ * @param config        An array returned by `parse_config()` (may be moved).
+ * @param count         The number of configuration entries (updated).
+ * @param values        The new entry; `values[0]` is the key.
+ * @param value_count   The number of elements in `values`.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int set_config_item(config_t **config, int *count, char **values, int value_count) {
+    config_file_t *file = find_config_file(*config);
+    if (file == NULL || value_count < 1) {
+        return -1;
+    }
+    // Entries are moved below, away from their spans.
+    if (all_entry_values(file, *count) < 0) {
+        return -1;
+    }
+
+    char **argv = arena_alloc(&file->arena, (value_count + 1) * sizeof(char *));
+    if (argv == NULL) {
+        return -1;
+    }
+    for (int i = 0; i < value_count; i++) {
+        if ((argv[i] = arena_strndup(&file->arena, values[i], strlen(values[i]))) == NULL) {
+            return -1;
+        }
+    }
+    argv[value_count] = NULL;
+
+    int i = config_index_find(&file->index, entry_key, file, argv[0]);
+    if (i >= 0) {
+        (*config)[i].values = argv;
+        (*config)[i].value_count = value_count;
+
+        int entries = i + 1;
+        for (int j = i + 1; j < *count; j++) {
+            if (strcmp((*config)[j].values[0], argv[0]) != 0)
+                (*config)[entries++] = (*config)[j];
+        }
+        if (entries == *count) {
+            return 0;
+        }
+        *count = entries;
+        config_index_free(&file->index);
+        return config_index_build(&file->index, entry_key, file, *count);
+    }
+
+    int entries = *count;
+    if (append_entry(&file->config, &file->capacity, &entries, argv, value_count) < 0) {
+        return -1;
+    }
+    *config = file->config;
+    *count = entries;
+    return config_index_add(&file->index, entry_key, file, *count, *count - 1);
+}
+
+/**
+ *: remove_config_item
+ * @brief               Removes every entry for a key from a parsed
+ *                      config array.
+ *
+ * @param config        An array returned by `parse_config()`.
+ * @param count         The number of configuration entries (updated).
+ * @param name          The key to remove.
+ *
+ * @return int          The number of entries removed, or -1 on error.
+ */
+int remove_config_item(config_t *config, int *count, const char *name) {
+    config_file_t *file = find_config_file(config);
+    if (file == NULL || all_entry_values(file, *count) < 0) {
+        return -1;
+    }
+
+    int entries = 0;
+    for (int j = 0; j < *count; j++) {
+        if (strcmp(config[j].values[0], name) != 0)
+            config[entries++] = config[j];
+    }
+    int removed = *count - entries;
+    if (removed == 0) {
+        return 0;
+    }
+    *count = entries;
+    config_index_free(&file->index);
+    if (config_index_build(&file->index, entry_key, file, entries) < 0) {
+        return -1;
+    }
+    return removed;
 }
 
 /**
@@ -260,17 +1623,14 @@ config_t* parse_config(const char* filename, int* count, char *delimiters) {
  *
  * @param config        A pointer to the configuration data.
  * @param count         The number of configuration entries.
- * @param name          The name of the value to retrieve.
+ * @param name          The name of the value to retrieve (exact match).
  *
- * @return char**       An array of char arrays.
+ * @return char**       An array of char arrays (first occurrence of
+ *                      `name`), or NULL if not found.
  */
 char **get_value(config_t* config, int count, const char* name) {
-    for (int i = 0; i < count; i++) {
-      if (strncmp(config[i].values[0], name, strlen(config[i].values[0])) == 0) {
-        return config[i].values;
-      }
-  }
-    return NULL;
+    int i = find_config_entry(config, count, name);
+    return i < 0 ? NULL : config_entry_values(config, i);
 }
 
 /**
@@ -289,12 +1649,11 @@ char **get_value(config_t* config, int count, const char* name) {
  * @param name          The name of the value to retrieve.
  */
 void print_config_item(config_t* config, int count, const char* name) {
-  for (int i = 0; i < count; i++) {
-    if (strcmp(config[i].values[0], name) == 0) {
+    int i = find_config_entry(config, count, name);
+    if (i >= 0 && config_entry_values(config, i) != NULL && config[i].value_count > 1) {
 //:~        printf("%s =\t %s\n", name, config[i].values[1]);
       printf("%s\n", config[i].values[1]);
     }
-  }
 }
 
 /**
@@ -305,6 +1664,22 @@ void print_config_item(config_t* config, int count, const char* name) {
  * @param count         The number of configuration entries.
  */
 void free_config(config_t *config, int count) {
+    // Arrays from `parse_config()` release their arena (and file) in one go.
+    config_file_t *file = NULL;
+    pthread_mutex_lock(&config_files_lock);
+    for (config_file_t **link = &config_files; *link; link = &(*link)->next) {
+        if ((*link)->config == config) {
+            file = *link;
+            *link = file->next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&config_files_lock);
+    if (file != NULL) {
+        release_config_file(file);
+        return;
+    }
+
     for (int i = 0; i < count; i++) {
         if (config[i].values != NULL) {
             for (int j = 0; j < config[i].value_count; j++) {
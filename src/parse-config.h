@@ -9,15 +9,28 @@
  *               char** values;
  *           } config_t;
  *
- * The `parse_config` function reads the configuration file, counts
- * the number of lines, allocates memory for the configuration data
- * struture, and then passes the configuration line--constructed in
- * the typical `name = value;` syntax to the `make_argv()` function to
- * tokenize the string, and  allocate the memory for an array of
- * pointers to the char arrays. The `get_value` function retrieves a
+ * The `parse_config` function loads the configuration file in one
+ * piece (mapped, or read in large blocks for pipes) and walks it once,
+ * growing the configuration data structure as it goes. For each
+ * configuration line--constructed in the typical `name = value;`
+ * syntax--it only records where the line and its key are; nothing is
+ * tokenized or copied yet.
+ *
+ * NOTE: in an array from `parse_config()` an entry's `values` is NULL
+ * and its `value_count` 0 until they are asked for. Call
+ * `config_entry_values()` (or look the key up with `get_value()` or
+ * `find_config_item()`) before reading `config[i].values` directly;
+ * `config_view_key()` and `config_view_tokens()` read an entry in
+ * place without copying it.
+ *
+ * The keys of a parsed file are kept in a hash index (see
+ * config-index.h) so the `get_value` function, which retrieves a
  * value from the data structure and returns an array of char arrays
- * of the value associated with that name.  The `free_config` function
- * frees the allocated memory for the configuration data.
+ * of the value associated with that name, does not scan the file.
+ * The `free_config` function frees the allocated memory for the
+ * configuration data; the tokens of a parsed file live in a single
+ * arena so this is a few `free()` calls no matter how large the file
+ * was.
  *
  * The configuation file can contain comment lines in either c-style
  * or shell-style. Values should be terminated with a semi-colon (;).
@@ -103,26 +116,149 @@
  *      } ///:~
  *
  */
+#ifndef PARSE_CONFIG_H
+#define PARSE_CONFIG_H
 
-// Configuration data structure
+#include <stddef.h>
+
+// Configuration data structure (in an array from `parse_config()`,
+// `values` is NULL and `value_count` 0 until asked for; see
+// `config_entry_values()`)
 typedef struct {
     int value_count;
     char** values;
 } config_t;
 
+struct delim_set;                                       /* see delim-scan.h */
+
+// A token in a loaded file: `length` bytes starting at `offset`.
+typedef struct {
+    size_t offset;
+    size_t length;
+} span_t;
+
 //: free_config
 //      Free the allocated memory for the configuration data.
 void free_config(config_t *config,int count);
 
+//: config_allocations
+//      Number of heap allocations holding the tokens of a config
+//      array returned by `parse_config()` (0 for any other array).
+size_t config_allocations(const config_t *config);
+
 //: get_value
-//      Function to find a configuration item by name.
+//      Function to find a configuration item by name (exact match,
+//      first occurrence).
 char **get_value(config_t *config,int count,const char *name);
 
+//: find_config_entry
+//      Find the entry number of the first entry for a key (exact
+//      match), or -1; nothing is copied out of the file.
+int find_config_entry(config_t *config, int count, const char *name);
+
+//: config_entry_values
+//      The values of entry `entry` (the key first), copied out of the
+//      file the first time they are asked for.
+char **config_entry_values(config_t *config, int entry);
+
+// The tokens of a parsed file, read in place (see `config_view_key()`
+// and `config_view_tokens()`); an entry whose `values` are set uses
+// those instead.
+struct config_file;
+typedef struct {
+    const char *data;
+    struct config_file *file;
+} config_view_t;
+
+//: config_view
+//      Read access to the tokens of an array from `parse_config()`
+//      without copying them (valid until the array changes).
+void config_view(const config_t *config, config_view_t *view);
+
+//: config_view_key
+//      The key of entry `entry`, in place (not nul-terminated), without
+//      tokenizing its line; NULL if the entry has its `values`.
+const char *config_view_key(const config_view_t *view, int entry, size_t *length);
+
+//: config_view_tokens
+//      Set `spans` to the tokens of entry `entry` (the key first) in
+//      `data`, tokenizing its line the first time. Returns the number
+//      of tokens, or -1 if the entry has its `values`.
+int config_view_tokens(const config_view_t *view, int entry, const span_t **spans);
+
+//: config_view_scan
+//      Like `config_view_tokens()`, but fill `spans` (up to `max`)
+//      without keeping the tokens. Returns the number of tokens (more
+//      than `max` if they did not fit), or -1.
+int config_view_scan(const config_view_t *view, int entry, span_t *spans, int max);
+
+#define PARSE_PARALLEL_MIN_BYTES   (64 * 1024 * 1024)   /* default size for threads */
+
+//: set_parse_threads
+//      Let `parse_config()` split files of at least `min_bytes` bytes
+//      between `threads` threads (0 = one per CPU; 1, the default,
+//      keeps to the calling thread). The result is the same either way.
+void set_parse_threads(int threads, size_t min_bytes);
+
 //: parse_config
 //      Parse the configuration file and store the data in a config_t
 //      array.
 config_t *parse_config(const char *filename,int *count, char *delimiters);
 
+//: parse_config_read
+//      Like `parse_config()`, but read the file into memory instead of
+//      mapping it (for an array kept while others may truncate it).
+config_t *parse_config_read(const char *filename, int *count, char *delimiters);
+
+//: skip_line
+//      Decide if a line starting (after spaces) with `c` is ignored by
+//      the parser (blank, comment or section line).
+int skip_line(char c);
+
+//: next_config_line
+//      Find the next line `parse_config()` would parse (not blank or
+//      a comment) in the buffer at `*pos`; returns its first non-space
+//      character and sets `*line_end`, or NULL at `end`.
+const char *next_config_line(const char **pos, const char *end, const char **line_end);
+
+//: span_tokens
+//      Find the tokens of a line without copying them; stores up to
+//      `max` spans and returns the number of tokens.
+int span_tokens(const char *line, size_t length, const struct delim_set *delims,
+                span_t *spans, int max);
+
+//: parse_config_files
+//      Parse `file_count` files at the same time, on up to `threads`
+//      threads (0 = one per file). Sets `configs[i]` and `counts[i]`
+//      for each file (NULL for one that cannot be read; it is not
+//      created); returns 0 if every file was parsed, -1 otherwise.
+int parse_config_files(const char **filenames, int file_count, char *delimiters,
+                       config_t **configs, int *counts, int threads);
+
+//: scan_config
+//      Find the first entry for each of `keys` in the configuration
+//      file without tokenizing the lines that do not match. The
+//      result is used like the array from `parse_config()`.
+config_t *scan_config(const char *filename, int *count, char *delimiters,
+                      const char **keys, int key_count);
+
+//: lookup_config
+//      Find the first entry for one key by searching the file for the
+//      key and tokenizing only the line it is the key of. The result
+//      (0 or 1 entries) is used like the array from `parse_config()`.
+config_t *lookup_config(const char *filename, int *count, char *delimiters, const char *key);
+
+//: set_config_item
+//      Set the values of a key (`values[0]`) in an array returned by
+//      `parse_config()`; later entries for the key are dropped and a
+//      new key is appended (`config` may move).
+int set_config_item(config_t **config, int *count, char **values, int value_count);
+
+//: remove_config_item
+//      Remove every entry for a key from an array returned by
+//      `parse_config()`.
+int remove_config_item(config_t *config, int *count, const char *name);
+
 //: print_config_item
 //      Function to print a configuration item's value to STDOUT.
 //      NOTE: only the first value is printed.
@@ -157,3 +293,5 @@ int populate_array(const char *input_string, const char *delimiters, char ***arg
 //      However the one listed in the book had a memmory leak, I have
 //      made this version to correct that issue and be a bit more robust.
 int make_argv(const char *buf, const char *delimiters, char ***argvp);
+
+#endif /* PARSE_CONFIG_H */
@@ -1,11 +1,292 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE                                     /* copy_file_range(), sendfile() */
+#endif
+
 #include "parse-config.h"
 #include "print-config.h"
+#include "cache-config.h"
+#include "config-syntax.h"
+#include "config-scope.h"
+#include "stats.h"
+#include "config-index.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
 #include <ctype.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+
+#ifdef __linux__
+#include <sys/sendfile.h>
+#if defined(__GLIBC__)
+#if __GLIBC_PREREQ(2, 27)
+#define HAVE_COPY_FILE_RANGE                            /* glibc 2.27 and later */
+#endif
+#endif
+#endif
+
+static FILE *change_output = NULL;                      /* where change reports go; see set_change_output() */
+static int change_output_set = 0;
+
+/**
+ *: set_change_output
+ * @brief               Sets where the "key: old -> new" style reports
+ *                      of `replacevariable()` and `writevariable()` go.
+ *
+ * @param stream        The stream to report to, or NULL for no reports.
+ *
+ * @return FILE*        The stream reports went to until now.
+ */
+FILE *set_change_output(FILE *stream) {
+    FILE *previous = change_output_set ? change_output : stdout;
+    change_output = stream;
+    change_output_set = 1;
+    return previous;
+}
+
+/**
+ *: report_change
+ * @brief               printf() to the change report stream (STDOUT
+ *                      unless changed with `set_change_output()`).
+ */
+static void report_change(const char *format, ...) {
+    FILE *stream = change_output_set ? change_output : stdout;
+    if (stream == NULL)
+        return;
+
+    va_list args;
+    va_start(args, format);
+    vfprintf(stream, format, args);
+    va_end(args);
+}
+
+#define OUTPUT_BUFFER   (256 * 1024)                    /* bytes formatted per write() */
+
+// Output being formatted into one buffer
+typedef struct {
+    int fd;
+    FILE *stream;                                       /* written to instead of `fd`, if set */
+    char *data;
+    size_t length;
+    int failed;
+} output_t;
+
+/**
+ *: output_flush
+ * @brief               Writes out what has been formatted so far.
+ *
+ * @param out           The output.
+ */
+static void output_flush(output_t *out) {
+    if (out->stream != NULL) {
+        if (out->length > 0 && fwrite(out->data, 1, out->length, out->stream) != out->length)
+            out->failed = 1;
+        out->length = 0;
+        return;
+    }
+    const char *data = out->data;
+    while (out->length > 0 && !out->failed) {
+        ssize_t n = write(out->fd, data, out->length);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0) {
+            out->failed = 1;
+            break;
+        }
+        data += n;
+        out->length -= (size_t)n;
+    }
+    out->length = 0;
+}
+
+/**
+ *: output_bytes
+ * @brief               Adds bytes to the output (writing it out when
+ *                      the buffer is full).
+ *
+ * @param out           The output.
+ * @param data          The bytes.
+ * @param length        The number of bytes.
+ */
+static void output_bytes(output_t *out, const char *data, size_t length) {
+    while (length > 0) {
+        if (out->length == OUTPUT_BUFFER)
+            output_flush(out);
+        size_t n = OUTPUT_BUFFER - out->length;
+        if (n > length)
+            n = length;
+        memcpy(out->data + out->length, data, n);
+        out->length += n;
+        data += n;
+        length -= n;
+    }
+}
+
+/**
+ *: print_config
+ * @brief               Formats every entry of a config array (see
+ *                      `print_config_file()`).
+ *
+ * @param config        The array to pull data from.
+ * @param count         The number of items in `config`.
+ * @param format        One of the PRINT_ formats.
+ * @param out           The output (its buffer is released).
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int print_config(config_t *config, int count, int format, output_t *out) {
+    if (out->data == NULL) {
+        return -1;
+    }
+
+    config_view_t view;
+    config_view(config, &view);
+
+    span_t line[32];                                    /* enough for most lines */
+    for (int i = 0; i < count && !out->failed; i++) {
+        const span_t *spans = NULL;
+        int tokens = config[i].value_count;
+        if (config[i].values == NULL && view.data != NULL) {
+            // Each line is read once; only a long one is kept.
+            tokens = config_view_scan(&view, i, line, 32);
+            spans = line;
+            if (tokens > 32)
+                tokens = config_view_tokens(&view, i, &spans);
+            if (tokens < 0) {
+                out->failed = 1;
+                break;
+            }
+        }
+        for (int j = 0; j < tokens; j++) {
+            const char *token;
+            size_t length;
+            if (spans != NULL) {
+                token = view.data + spans[j].offset;
+                length = spans[j].length;
+            } else {
+                token = config[i].values[j];
+                length = strlen(token);
+            }
+            if (j > 0 && token[0] == '#')               /* do not print comments. */
+                break;
+
+            if (j == 0) {
+                output_bytes(out, token, length);
+                if (format == PRINT_ALIGNED) {
+                    for (; length < 10; length++)
+                        output_bytes(out, " ", 1);
+                    output_bytes(out, "\t=\t", 3);
+                } else {
+                    output_bytes(out, "=", 1);
+                }
+            } else {
+                if (format != PRINT_ALIGNED && j > 1)
+                    output_bytes(out, " ", 1);
+                output_bytes(out, token, length);
+                if (format == PRINT_ALIGNED)
+                    output_bytes(out, " ", 1);
+            }
+        }
+        output_bytes(out, format == PRINT_NUL ? "" : "\n", 1);
+    }
+    output_flush(out);
+
+    free(out->data);
+    return out->failed ? -1 : 0;
+}
+
+/**
+ *: print_config_file
+ * @brief               Prints every entry of a config array in one
+ *                      pass.
+ *
+ * The tokens are read where they are in the loaded file (see
+ * `config_view()`) and formatted into one large buffer which is
+ * written with a few `write()` calls. Formats:
+ *
+ *      PRINT_ALIGNED   key<padded to 10>\t=\tvalue value \n
+ *      PRINT_RAW       key=value value\n
+ *      PRINT_NUL       key=value value\0
+ *
+ * Inline comments are not printed.
+ *
+ * @param config        The array to pull data from.
+ * @param count         The number of items in `config`.
+ * @param format        One of the PRINT_ formats.
+ * @param fd            The file descriptor to write to.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int print_config_file(config_t *config, int count, int format, int fd) {
+    output_t out = { fd, NULL, malloc(OUTPUT_BUFFER), 0, 0 };
+    return print_config(config, count, format, &out);
+}
+
+/**
+ *: print_config_keys
+ * @brief               Prints the key of every entry of a config array,
+ *                      one per line (`\0`-terminated for PRINT_NUL).
+ *
+ * The keys are read where they are in the loaded file (see
+ * `config_view_key()`); no line is tokenized.
+ *
+ * @param config        The array to pull data from.
+ * @param count         The number of items in `config`.
+ * @param format        One of the PRINT_ formats.
+ * @param fd            The file descriptor to write to.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int print_config_keys(config_t *config, int count, int format, int fd) {
+    output_t out = { fd, NULL, malloc(OUTPUT_BUFFER), 0, 0 };
+    if (out.data == NULL) {
+        return -1;
+    }
+
+    config_view_t view;
+    config_view(config, &view);
+
+    for (int i = 0; i < count && !out.failed; i++) {
+        size_t length;
+        const char *key = config_view_key(&view, i, &length);
+        if (key == NULL) {
+            if (config[i].values == NULL || config[i].values[0] == NULL)
+                continue;
+            key = config[i].values[0];
+            length = strlen(key);
+        }
+        output_bytes(&out, key, length);
+        output_bytes(&out, format == PRINT_NUL ? "" : "\n", 1);
+    }
+    output_flush(&out);
+
+    free(out.data);
+    return out.failed ? -1 : 0;
+}
+
+/**
+ *: print_config_stream
+ * @brief               Like `print_config_file()`, to a stream.
+ *
+ * @param config        The array to pull data from.
+ * @param count         The number of items in `config`.
+ * @param format        One of the PRINT_ formats.
+ * @param stream        The stream to write to.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int print_config_stream(config_t *config, int count, int format, FILE *stream) {
+    output_t out = { -1, stream, malloc(OUTPUT_BUFFER), 0, 0 };
+    return print_config(config, count, format, &out);
+}
+
+
 
 /**
  *: Printconfifile
@@ -15,27 +296,139 @@
  * @param array_count   The number of items in `config_array`.
  */
 void printconfigfile(config_t* config_array, int array_count ){
+  fflush(stdout);
+  print_config_file(config_array, array_count, PRINT_ALIGNED, STDOUT_FILENO);
+}
 
-  // No argument (key = value or key) given so just print the config values.
-  for (int i = 0; i < array_count; i++) {
+// A value of a defaults entry (in the set `report_duplicates()` uses)
+typedef struct {
+    uint32_t hash;
+    int entry;                                          /* defaults entry + 1; 0 = empty */
+    const char *value;
+} default_value_t;
 
-    // Get the values associated with the argument passed to this function.
-    char **config_line_array = get_value(config_array, array_count, config_array[i].values[0]);
+/**
+ *: value_slot
+ * @brief               Finds the slot of a defaults value, or the empty
+ *                      slot it would go in.
+ *
+ * @param slots         The set.
+ * @param mask          Its size - 1.
+ * @param entry         The defaults entry.
+ * @param value         The value.
+ * @param hash          The hash of the entry and value.
+ *
+ * @return default_value_t*  The slot.
+ */
+static default_value_t *value_slot(default_value_t *slots, size_t mask, int entry,
+                                   const char *value, uint32_t hash) {
+    size_t slot = hash & mask;
+    while (slots[slot].entry != 0) {
+        stats.probes++;
+        if (slots[slot].hash == hash && slots[slot].entry == entry + 1 && \
+            strcmp(slots[slot].value, value) == 0)
+            break;
+        slot = (slot + 1) & mask;
+    }
+    return &slots[slot];
+}
 
-    // If the value cannot be found, just exit.
-    if (config_line_array == NULL) return;
+/**
+ *: value_hash
+ * @brief               Hashes a (defaults entry, value) pair.
+ *
+ * @param entry         The defaults entry.
+ * @param value         The value.
+ *
+ * @return uint32_t     The hash.
+ */
+static uint32_t value_hash(int entry, const char *value) {
+    return config_hash(value, strlen(value)) ^ ((uint32_t)entry * 0x9e3779b1u);
+}
 
-    printf("%-10s\t=\t", config_array[i].values[0]);
-    // just itterate the line array.
-    config_line_array += 1;                             /* strip the 'key' from the array */
-    while(*config_line_array) {
-      if(memcmp(*config_line_array, "#", 1) == 0) {     /* do not print comments. */
-        break;
-      }
-      printf("%s ", *config_line_array++);
+/**
+ *: report_duplicates
+ * @brief               Prints the values a config file repeats from its
+ *                      defaults file.
+ *
+ * A hash join: each key is looked up in the defaults' index and the
+ * values of the defaults entry (its first occurrence) are put in one
+ * hash set of (entry, value) pairs the first time the key is seen, so
+ * every value is checked in constant time and the whole report is
+ * linear in the size of the two files. Only the defaults entries a key
+ * is found in are tokenized (they are found first, to size the set).
+ *
+ * @param config        The config file's entries.
+ * @param count         The number of entries in `config`.
+ * @param defaults      The defaults file's entries.
+ * @param default_count The number of entries in `defaults`.
+ * @param out           Where to print the report.
+ *
+ * @return int          The number of duplicates, or -1 on error.
+ */
+int report_duplicates(config_t *config, int count, config_t *defaults, int default_count, FILE *out) {
+    // -Find the defaults entry of each key first; only those entries
+    //  are tokenized, and their values size the set.
+    int *matches = malloc((count > 0 ? count : 1) * sizeof(int));
+    char *loaded = calloc(default_count + 1, 1);        /* entries whose values are in the set */
+    if (matches == NULL || loaded == NULL) {
+        free(matches);
+        free(loaded);
+        return -1;
     }
-    printf("\n");
-  }
+    size_t values = 0;
+    for (int i = 0; i < count; i++) {
+        char **entry = config_entry_values(config, i);
+        config_t *match = entry && entry[0] ? find_config_item(defaults, entry[0], default_count) : NULL;
+        matches[i] = match ? (int)(match - defaults) : -1;
+        if (match != NULL && !loaded[matches[i]]) {
+            values += match->value_count;
+            loaded[matches[i]] = 1;
+        }
+    }
+    size_t size = 16;
+    while (size < values * 2) size *= 2;
+    default_value_t *slots = calloc(size, sizeof(default_value_t));
+    if (slots == NULL) {
+        free(matches);
+        free(loaded);
+        return -1;
+    }
+    memset(loaded, 0, default_count + 1);
+
+    int duplicates = 0;
+    for (int i = 0; i < count; i++) {
+        int d = matches[i];
+        if (d < 0)
+            continue;
+        char **entry = config[i].values;
+        config_t *match = &defaults[d];
+        if (!loaded[d]) {
+            for (int x = 0; x < match->value_count; x++) {
+                uint32_t hash = value_hash(d, match->values[x]);
+                default_value_t *slot = value_slot(slots, size - 1, d, match->values[x], hash);
+                slot->hash = hash;
+                slot->entry = d + 1;
+                slot->value = match->values[x];
+            }
+            loaded[d] = 1;
+        }
+
+        for (int x = 1; x < config[i].value_count; x++) {
+            const char *value = entry[x];
+            if (value[0] == '#')
+                break;
+            if (value_slot(slots, size - 1, d, value, value_hash(d, value))->entry != 0) {
+                fprintf(out, "*DUPLICATE* %s: '%s'\n", entry[0], value);
+                duplicates++;
+            }
+        }
+    }
+
+    free(slots);
+    free(matches);
+    free(loaded);
+    return duplicates;
 }
 
 /**
@@ -118,286 +511,832 @@ char* assemble_strings(char **value, int count) {
     return result;
 }
 
+// A change to a loaded file: `length` bytes at `offset` become `text`.
+typedef struct {
+    size_t offset;
+    size_t length;
+    const char *text;
+    size_t text_length;
+} splice_t;
+
+/**
+ *: write_bytes
+ * @brief               Writes all of a buffer to a file descriptor.
+ *
+ * @param fd            The file to write to.
+ * @param data          The bytes to write.
+ * @param length        The number of bytes.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int write_bytes(int fd, const char *data, size_t length) {
+    while (length > 0) {
+        ssize_t n = write(fd, data, length);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        data += n;
+        length -= (size_t)n;
+        stats.bytes_written += (size_t)n;
+    }
+    return 0;
+}
+
 /**
- *: stripspaces
- * @brief               Strips spaces from `str` and keeps track of indent level.
+ *: copy_bytes
+ * @brief               Copies a byte range of one file to the end of
+ *                      another, in the kernel where possible.
+ *
+ * `copy_file_range()` is tried first (it may share the blocks or copy
+ * on the server), then `sendfile()`; whatever they cannot copy is
+ * written from the loaded (mapped) file.
+ *
+ * @param in_fd         The file to copy from (-1 = write `data`).
+ * @param offset        Where the range starts in `in_fd`.
+ * @param out_fd        The file to append to.
+ * @param data          The same range, loaded in memory.
+ * @param length        The number of bytes.
+ *
+ * @return 0 on success, -1 on error.
  */
-#define stripspaces()  while (isspace(*str) > 0 && *str != '\0' && *str != '\n') { indent++; str++; }
+static int copy_bytes(int in_fd, off_t offset, int out_fd, const char *data, size_t length) {
+    if (in_fd < 0)
+        return write_bytes(out_fd, data, length);
+#ifdef HAVE_COPY_FILE_RANGE
+    while (length > 0) {
+        loff_t in_offset = offset;
+        ssize_t n = copy_file_range(in_fd, &in_offset, out_fd, NULL, length, 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;                                      /* not supported here; try the next way */
+        stats.bytes_written += (size_t)n;
+        offset += n;
+        data += n;
+        length -= (size_t)n;
+    }
+#endif
+#ifdef __linux__
+    while (length > 0) {
+        off_t in_offset = offset;
+        ssize_t n = sendfile(out_fd, in_fd, &in_offset, length);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        stats.bytes_written += (size_t)n;
+        offset += n;
+        data += n;
+        length -= (size_t)n;
+    }
+#else
+    (void)in_fd;
+    (void)offset;
+#endif
+    return write_bytes(out_fd, data, length);
+}
 
 /**
- *: replacevariable
- * @brief               Replaces a items value in the config file.
+ *: splice_file
+ * @brief               Writes a loaded file back with some byte ranges
+ *                      replaced; everything else is copied verbatim.
+ *
+ * Only the replacement text passes through this program; the ranges in
+ * between are copied file to file (see `copy_bytes()`). The new file
+ * is written to a temp file of its own next to the config file (so it
+ * is on the same file system and no other writer uses the same name),
+ * given the config file's mode and owner, and renamed over it: readers
+ * see the old file or the new one, never a part.
  *
- * @param key           The key in the key/value array.
- * @param value         The value (array) in the key/value array.
- * @param count         The value array count.
  * @param filename      The config file to change.
+ * @param buffer        The loaded file.
+ * @param edits         The changes, in file order, not overlapping.
+ * @param edit_count    The number of changes.
+ * @param from_file     1 = `buffer` is the file as it is on disk (and
+ *                      can be copied from it), 0 = it was changed.
  *
- * @return int          The number of lines in config file.
+ * @return 0 on success, -1 on error.
  */
-int replacevariable(const char *key, char **value, int count, const char *filename) {
-    FILE* conf_file = fopen(filename, "r");             /* Open config file READONLY */
-    FILE* temp_file = fopen(".sys.conf.file.tmp", "w"); /* Open a temp file READ/WRITE */
-    int found = 0;                                      /* Used to keep track of redundant key entries. */
-    int indent = 0;                                     /* keep track of string indent */
-    char buffer[1024];                                  /* buffer stores the line */
-    int start = count;
-
-    if (!conf_file || !temp_file) {
+static int splice_file(const char *filename, const file_buffer_t *buffer,
+                       const splice_t *edits, int edit_count, int from_file) {
+    const char *slash = strrchr(filename, '/');
+    const char *base = slash ? slash + 1 : filename;
+    int dir_length = slash ? (int)(slash - filename) + 1 : 0;
+    size_t size = dir_length + strlen(base) + 16;
+    char *temp = malloc(size);
+    if (temp == NULL) {
+        return -1;
+    }
+    snprintf(temp, size, "%.*s.%s.XXXXXX", dir_length, filename, base);
+
+    int conf_fd = from_file ? open(filename, O_RDONLY) : -1;   /* Open config file READONLY */
+    int temp_fd = mkstemp(temp);
+    size_t pos = 0;
+    int rc = 0;
+
+    if ((from_file && conf_fd < 0) || temp_fd < 0) {
         fprintf(stderr, "Unable to create temp file or read config file\n");
-        if (conf_file) fclose(conf_file);
-        if (temp_file) fclose(temp_file);
-        return 1;
+        if (conf_fd >= 0) close(conf_fd);
+        if (temp_fd >= 0) {
+            close(temp_fd);
+            unlink(temp);
+        }
+        free(temp);
+        return -1;
     }
 
-    while (fgets(buffer, sizeof(buffer), conf_file)) {
-        char *str = buffer;
-        indent = 0;                                     /* reset indent level each iteration */
-        stripspaces();                                  /* count and strip spaces */
+    // -Keep the mode and owner of the file being replaced (the owner
+    //  only changes if we may change it).
+    struct stat st;
+    if (stat(filename, &st) == 0) {
+        if (fchown(temp_fd, st.st_uid, st.st_gid) < 0) { /* not ours to give away */ }
+        fchmod(temp_fd, st.st_mode & 07777);
+    } else {
+        mode_t mask = umask(0);
+        umask(mask);
+        fchmod(temp_fd, 0666 & ~mask);
+    }
 
-        if (strncmp(key, str, strlen(key)) == 0 ) {
-//:~              && \ strncmp(key, str, strlen(str)) == 0) {
-            // If we've found this key before, skip it and move on.
+    for (int i = 0; i < edit_count && rc == 0; i++) {
+        rc = copy_bytes(conf_fd, (off_t)pos, temp_fd, buffer->data + pos, edits[i].offset - pos);
+        if (rc == 0)
+            rc = write_bytes(temp_fd, edits[i].text, edits[i].text_length);
+        pos = edits[i].offset + edits[i].length;
+    }
+    if (rc == 0)
+        rc = copy_bytes(conf_fd, (off_t)pos, temp_fd, buffer->data + pos, buffer->length - pos);
+    if (conf_fd >= 0)
+        close(conf_fd);
 
-            if (found == 1)
-                continue;
+    if (close(temp_fd) != 0 || rc != 0 || rename(temp, filename) != 0) {
+        fprintf(stderr, "Unable to write temp file\n");
+        unlink(temp);
+        free(temp);
+        return -1;
+    }
+    free(temp);
+    return 0;
+}
 
-            // If we haven't found the key yet.
-            if (found != 1) {
-                // Find the position of the separator
-                char *sep_pos = str;
-                int spaces_before = 0;                  /* used to count spaces before seperator */
-                int spaces_after = 0;                   /* used to count spaces after seperator */
-                char separator = ' ';                   /* char to use as a seperator (-i.e., space). */
-                char terminator = ' ';                  /* char to store the terminator symbol if one used. */
-                char quote_char[2] = "";                /* array to store the quotes. */
-                int dquote = 0;                         /* used as a flag when a double quote is found. */
-                int squote = 0;                         /* used as a flag when a single quote is found. */
-                char *value_assembled;                  /* used to store final output string. */
-                int comment = 0;                        /* used a a flag when an inline comment is found. */
-                int comment_pos = 0;                    /* used as a starting point in a loop counter to
-                                                           add any inline comments back to string. */
-
-                int new_count = 1;
-
-                if (strnstr(str, "=", strlen(str))) separator = '=';
-                if (strnstr(str, ":", strlen(str))) separator = ':';
-                if (strnstr(str, ";", strlen(str))) terminator = ';';
-
-                // Skip non-space characters until a space is reached
-                while (*sep_pos != '\0' && !isspace(*sep_pos) && *sep_pos != separator) {
-                    sep_pos++;
-                }
+// The config file this process holds the lock of (see lock_config())
+static struct {
+    char *filename;
+    int fd;                                             /* the locked file */
+    int depth;                                          /* lock_config() calls not yet unlocked */
+} config_lock = { NULL, -1, 0 };
 
-                // Count the spaces before the separator
-                while (isspace(*sep_pos) && *sep_pos != '\0' && *sep_pos != separator) {
-                    spaces_before++;
-                    sep_pos++;
-//:~                      switch (*sep_pos) {
-//:~                        case '\t': separator = '\t';
-//:~                                   break;
-//:~                        default : break;
-//:~                      }
-                }
+/**
+ *: lock_config
+ * @brief               Takes the advisory lock of a config file, waiting
+ *                      for whoever holds it.
+ *
+ * The lock is a `flock()` on the file itself. A file that is replaced
+ * (renamed over) while we wait is a different file; its lock is taken
+ * instead. The lock may be taken again for the same file while it is
+ * held, as long as every `lock_config()` has its `unlock_config()`.
+ *
+ * @param filename      The config file (created if it is not there).
+ *
+ * @return 0 on success, -1 on error with `errno` set.
+ */
+int lock_config(const char *filename) {
+    if (config_lock.depth > 0) {
+        if (strcmp(config_lock.filename, filename) != 0) {
+            errno = EDEADLK;                            /* one file at a time */
+            return -1;
+        }
+        config_lock.depth++;
+        return 0;
+    }
 
-                if (*sep_pos == separator) sep_pos++;
-
-                // Count the spaces after the separator
-                while (*sep_pos != '\0' && isspace(*sep_pos)) {
-                    spaces_after++;
-                    sep_pos++;
-//:~                      switch (*sep_pos) {
-//:~                        case '\t': separator = '\t';
-//:~                                   break;
-//:~                        default : break;
-//:~                      }
-                }
+    char *name = strdup(filename);
+    if (name == NULL) {
+        return -1;
+    }
+    for (;;) {
+        int fd = open(filename, O_RDONLY | O_CREAT | O_CLOEXEC, 0666);
+        if (fd < 0) {
+            free(name);
+            return -1;
+        }
+        int rc;
+        while ((rc = flock(fd, LOCK_EX)) < 0 && errno == EINTR)
+            ;
+        struct stat held, current;
+        if (rc < 0 || fstat(fd, &held) < 0) {
+            int saved = errno;
+            close(fd);
+            free(name);
+            errno = saved;
+            return -1;
+        }
+        if (stat(filename, &current) == 0 && \
+            current.st_dev == held.st_dev && current.st_ino == held.st_ino) {
+            config_lock.filename = name;
+            config_lock.fd = fd;
+            config_lock.depth = 1;
+            return 0;
+        }
+        close(fd);                                      /* replaced while we waited */
+    }
+}
 
-                // Check if the value is enclosed in quotes
-                for (char *p = sep_pos; *p != '\0'; p++) {
-                  if (*p == '"' ) dquote++;
-                  if (*p == '\'') squote++;
-                }
-                if (dquote == 2) quote_char[0] = '\"';
-                if (squote == 2) quote_char[0] = '\'';
-
-                // -Check the `value` array for the plus (+) sign;
-                //  if found, then:
-                //   1. Check the entries in `value` are not already in
-                //      the config file value array.
-                //   2. Assemble the arrays.
-                char **current_config_array = NULL;
-                char **new_config_array = NULL;         /* Array used to add only items in current config_array
-                                                         * that are not called out to be removed.
-                                                         */
-                int argc;
-                int i = 1;
-                if (strstr(value[0], "+") != NULL) {
-
-                  // Should not do! This will negate the output of the rest of the config file. It would
-                  // be better to add a guard like this in the += and -= operations.
-
-                    char delimiters[] = " \t\n\"\':=;";
-                    // 1. tokenize the buffer,
-                    // 2. Add the rest of the values to the token array `current_config_array'
-                    // 3. Remove the `key` postion from the `current_config_array` array.
-                    // 4. Replace the `value` array with the new array `current_config_array`.
-                    argc = make_argv(str, delimiters, &current_config_array);
-                    for (; i < argc; i++) {
-
-                      // Do not add any "inline comments".
-                      if(memcmp(current_config_array[i], "#", 1) == 0) {
-                        comment = 1;
-                        comment_pos = i;
-                        break;
-                      }
-                      count = add_to_array(&value, count, current_config_array[i]);
-                    }
-                }
+/**
+ *: unlock_config
+ * @brief               Releases the lock taken by `lock_config()`.
+ */
+void unlock_config(void) {
+    if (config_lock.depth == 0 || --config_lock.depth > 0)
+        return;
+    close(config_lock.fd);
+    free(config_lock.filename);
+    config_lock.filename = NULL;
+    config_lock.fd = -1;
+}
 
-                if (strstr(value[0], "-") != NULL) {
-
-                  // XXX: make delimiters a global variable which can be referenced here.
-                  char delimiters[] = " \t\n\"\':=;";
-                  argc = make_argv(str, delimiters, &current_config_array);
-
-                  /* If there are only two items in the line, and the
-                   * argument to remove is the same as what is there,
-                   * skip tring to recreate the string for output.
-                   */
-                  if (argc == 2 && \
-                      strcmp(value[1], current_config_array[1]) == 0) {
-//:~                        strncmp(value[1], current_config_array[1], strlen(value[1])) == 0) {
-                    printf("Last value for key removed. Key removed from file.\n");
-                    for (int j = 0; current_config_array[j] != NULL; j++) {
-                        free(current_config_array[j]);  /* Free each string */
-                    }
-                    free(current_config_array);         /* Free the array itself */
-                    current_config_array = NULL;        /* avoid dangling pointer */
-                    continue;
-                  }
-
-                  for (; i < argc; i++) {
-                    if (count >= 1 && \
-                        strcmp(value[1], current_config_array[i]) != 0) {
-
-                      // Do not add any "inline comments".
-                      if(memcmp(current_config_array[i], "#", 1) == 0) {
-                        comment = 1;
-                        comment_pos = i;
-                        break;
-                      }
-
-                      new_count = add_to_array(&new_config_array, new_count, current_config_array[i]);
-                    }
-                  }
-                  value = new_config_array;
-                  count = new_count;
-                  start += 1;
-                }
+// The states of a batch of changes
+enum {
+    BATCH_CLEAN,                                        /* nothing changed (or only appended) */
+    BATCH_SPLICED,                                      /* `edits` are waiting to be made to `buffer` */
+    BATCH_CHANGED                                       /* `buffer` is the changed file */
+};
 
-                // Assemble the new value string
-                value_assembled = assemble_strings(value, count);
+// The changes gathered between begin_changes() and end_changes()
+static struct {
+    char *filename;
+    int depth;                                          /* begin_changes() calls not yet ended */
+    int state;
+    file_buffer_t buffer;                               /* the file as loaded, or as changed */
+    splice_t *edits;                                    /* (BATCH_SPLICED) */
+    int edit_count;
+    char *texts;                                        /* the text of `edits` */
+    int appended;                                       /* a line was appended to the file */
+} batch = { NULL, 0, BATCH_CLEAN, { NULL, 0, 0 }, NULL, 0, NULL, 0 };
 
+/**
+ *: in_batch
+ * @brief               Tells if changes to a file are being gathered.
+ */
+static int in_batch(const char *filename) {
+    return batch.depth > 0 && strcmp(batch.filename, filename) == 0;
+}
 
-                if (value_assembled == NULL) {
-                    fclose(conf_file);
-                    fclose(temp_file);
-                    fprintf(stderr, "Unable to create final value string for config file writing.\n");
-                    return 1;
-                }
+/**
+ *: splice_buffer
+ * @brief               Makes some changes to a file in memory.
+ *
+ * @param buffer        The file; replaced by the changed file.
+ * @param edits         The changes, in file order, not overlapping.
+ * @param edit_count    The number of changes.
+ *
+ * @return 0 on success, -1 when out of memory.
+ */
+static int splice_buffer(file_buffer_t *buffer, const splice_t *edits, int edit_count) {
+    size_t length = buffer->length;
+    for (int i = 0; i < edit_count; i++)
+        length = length - edits[i].length + edits[i].text_length;
 
-                // Calculate the length of the new line
-                int new_line_length = indent  + \
-                                      strlen(key) + spaces_before + 1 + \
-                                      strlen(value_assembled) + \
-                                      strlen(quote_char) * 2 + \
-                                      spaces_after + \
-                                      strlen(quote_char) + 1; // last 1+ for terminator
-
-                char *new_line = malloc(new_line_length + 1); // +1 for null terminator
-                if (new_line == NULL) {
-                    free(value_assembled);
-                    fclose(conf_file);
-                    fclose(temp_file);
-                    fprintf(stderr, "Unable to allocate memory for new replacement string.\n");
-                    return 1;
-                }
+    char *data = malloc(length ? length : 1);
+    if (data == NULL) {
+        return -1;
+    }
+    size_t pos = 0, out = 0;
+    for (int i = 0; i < edit_count; i++) {
+        memcpy(data + out, buffer->data + pos, edits[i].offset - pos);
+        out += edits[i].offset - pos;
+        memcpy(data + out, edits[i].text, edits[i].text_length);
+        out += edits[i].text_length;
+        pos = edits[i].offset + edits[i].length;
+    }
+    memcpy(data + out, buffer->data + pos, buffer->length - pos);
 
-                // Construct the new line
-                char *ptr = new_line;
-                ptr += snprintf(ptr, new_line_length, "%*s%s%*s%c%*s%s%s%s%c\n",
-                    indent, "",
-                    key,
-                    spaces_before, "",
-                    separator,
-                    spaces_after, "",
-                    quote_char,
-                    value_assembled,
-                    quote_char,
-                    terminator);
-
-                // Write the new line to the temp file
-                fputs(new_line, temp_file);
-
-                // Add any inline comments back into the string.
-                if (comment != 0) {
-                    fputs("     ", temp_file);
-                    for (int j = comment_pos; current_config_array[j] != NULL; j++) {
-                        fputs(current_config_array[j], temp_file);
-                        fputs(" ", temp_file);
-                    }
-                }
+    unload_file(buffer);
+    buffer->data = data;
+    buffer->length = length;
+    buffer->mapped = 0;
+    return 0;
+}
 
-                fputs("\n", temp_file);
-
-                /* Prompt via STDOUT for the config file changes. */
-                if (current_config_array) {
-                  // If we had to construct a `current_config_array` this means we did a set
-                  // operation (+= or -=) so we should show that change.
-                  printf("%s:", key);
-                  for (int j = 1; current_config_array[j] != NULL; j++) {
-                    printf(" %s",current_config_array[j]);
-                  }
-                  printf(" -> %s \n", value_assembled);
-                }
+/**
+ *: batch_changed
+ * @brief               Makes the waiting edits of the batch to its
+ *                      buffer, so the next change can be made to it.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int batch_changed(void) {
+    if (batch.state == BATCH_SPLICED) {
+        if (splice_buffer(&batch.buffer, batch.edits, batch.edit_count) < 0)
+            return -1;
+        free(batch.edits);
+        free(batch.texts);
+        batch.edits = NULL;
+        batch.texts = NULL;
+        batch.edit_count = 0;
+    } else if (batch.state == BATCH_CLEAN) {
+        file_buffer_t loaded;
+        if (load_file(batch.filename, &loaded) < 0)
+            return -1;
+        batch.buffer = loaded;
+        if (splice_buffer(&batch.buffer, NULL, 0) < 0)  /* (a copy we can change) */
+            return -1;
+    }
+    batch.state = BATCH_CHANGED;
+    return 0;
+}
+
+/**
+ *: begin_changes
+ * @brief               Locks a config file and starts gathering the
+ *                      changes made to it in memory.
+ *
+ * Until `end_changes()` the file on disk is not touched, and each
+ * change sees the ones before it. The first change of a batch is kept
+ * as a list of edits to the file (so a batch of one is written as
+ * before, copying the file around the edits in the kernel); the second
+ * one makes them in memory.
+ *
+ * @param filename      The config file.
+ *
+ * @return 0 on success, -1 on error with `errno` set.
+ */
+int begin_changes(const char *filename) {
+    if (batch.depth > 0) {
+        if (strcmp(batch.filename, filename) != 0) {
+            errno = EBUSY;                              /* one file at a time */
+            return -1;
+        }
+        batch.depth++;
+        return 0;
+    }
+    if (lock_config(filename) < 0) {
+        return -1;
+    }
+    batch.filename = strdup(filename);
+    if (batch.filename == NULL) {
+        unlock_config();
+        return -1;
+    }
+    batch.depth = 1;
+    batch.state = BATCH_CLEAN;
+    batch.appended = 0;
+    return 0;
+}
 
-                free(new_line);
-                new_line = NULL;
+/**
+ *: end_changes
+ * @brief               Writes the changes gathered since
+ *                      `begin_changes()` in one rewrite of the file
+ *                      and unlocks it.
+ *
+ * @return 0 on success, -1 if the file could not be written.
+ */
+int end_changes(void) {
+    if (batch.depth == 0 || --batch.depth > 0)
+        return 0;
 
-                free(value_assembled);
+    int rc = 0;
+    if (batch.state == BATCH_SPLICED)
+        rc = splice_file(batch.filename, &batch.buffer, batch.edits, batch.edit_count, 1);
+    else if (batch.state == BATCH_CHANGED)
+        rc = splice_file(batch.filename, &batch.buffer, NULL, 0, 0);
+    if (rc == 0 && (batch.state != BATCH_CLEAN || batch.appended))
+        refresh_cache(batch.filename);
 
-                for(int i = start; i < count; i++) free(value[i]);
+    unload_file(&batch.buffer);
+    free(batch.edits);
+    free(batch.texts);
+    free(batch.filename);
+    batch.filename = NULL;
+    batch.edits = NULL;
+    batch.texts = NULL;
+    batch.edit_count = 0;
+    batch.state = BATCH_CLEAN;
+    unlock_config();
+    return rc;
+}
 
-                free(new_config_array);
-                new_config_array = NULL;
+/**
+ *: load_changes
+ * @brief               Builds the syntax tree of a config file as it
+ *                      is with the changes of the batch made.
+ *
+ * @param filename      The config file.
+ * @param delimiters    The tokenizer delimiters.
+ * @param syntax        The tree to fill.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int load_changes(const char *filename, const char *delimiters, config_syntax_t *syntax) {
+    if (!in_batch(filename) || batch.state == BATCH_CLEAN)
+        return parse_syntax(filename, delimiters, syntax);
+    if (batch_changed() < 0)
+        return -1;
 
-                  found = 1;
-            }
+    file_buffer_t copy = { malloc(batch.buffer.length ? batch.buffer.length : 1), batch.buffer.length, 0 };
+    if (copy.data == NULL) {
+        return -1;
+    }
+    memcpy(copy.data, batch.buffer.data, batch.buffer.length);
+    return parse_syntax_buffer(&copy, delimiters, syntax);
+}
+
+/**
+ *: commit_splices
+ * @brief               Adds some edits of a file (loaded with
+ *                      `load_changes()`) to the batch.
+ *
+ * @param edits         The changes, in file order, not overlapping.
+ * @param edit_count    The number of changes.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int commit_splices(const splice_t *edits, int edit_count) {
+    if (batch.state != BATCH_CLEAN) {
+        return splice_buffer(&batch.buffer, edits, edit_count);
+    }
+
+    // -The first change; keep the edits (and the text they put in) for
+    //  `end_changes()`.
+    size_t size = 1;
+    for (int i = 0; i < edit_count; i++) size += edits[i].text_length;
+    batch.edits = malloc(edit_count * sizeof(splice_t) + 1);
+    batch.texts = malloc(size);
+    if (batch.edits == NULL || batch.texts == NULL || load_file(batch.filename, &batch.buffer) < 0) {
+        free(batch.edits);
+        free(batch.texts);
+        batch.edits = NULL;
+        batch.texts = NULL;
+        return -1;
+    }
+    size_t pos = 0;
+    for (int i = 0; i < edit_count; i++) {
+        batch.edits[i] = edits[i];
+        memcpy(batch.texts + pos, edits[i].text, edits[i].text_length);
+        batch.edits[i].text = batch.texts + pos;
+        pos += edits[i].text_length;
+    }
+    batch.edit_count = edit_count;
+    batch.state = BATCH_SPLICED;
+    return 0;
+}
+
+/**
+ *: append_value
+ * @brief               Appends a token to a space separated value string.
+ *
+ * @param text          The value string (large enough).
+ * @param length        The length of `text` (updated).
+ * @param token         The token to append.
+ * @param token_length  The length of `token`.
+ */
+static void append_value(char *text, size_t *length, const char *token, size_t token_length) {
+    if (*length > 0)
+        text[(*length)++] = ' ';
+    memcpy(text + *length, token, token_length);
+    *length += token_length;
+    text[*length] = '\0';
+}
+
+/**
+ *: replace_line
+ * @brief               Replaces the value of one line of a config file.
+ *
+ * The key, separator, quotes, terminator, inline comment, indentation
+ * and the rest of the file are copied as they are (see
+ * config-syntax.h).
+ *
+ * @param syntax        The syntax tree of the file (from
+ *                      `load_changes()`).
+ * @param line          The line to change.
+ * @param key           The key (as `value[0]` has it, without `+`/`-`).
+ * @param value         The value array; `value[0]` is the key,
+ *                      followed by `+` or `-` to add or remove a value.
+ * @param count         The value array count.
+ * @param duplicates    1 = drop later lines for `key` too.
+ *
+ * @return int          0 on success, 1 on error.
+ */
+static int replace_line(config_syntax_t *syntax, const syntax_line_t *line,
+                        const char *key, char **value, int count, int duplicates) {
+    // -The key of `key+=value` and `key-=value` carries the operator.
+    char op = '=';
+    size_t key_length = strlen(key);
+    if (strlen(value[0]) == key_length + 1 && \
+        (value[0][key_length] == '+' || value[0][key_length] == '-')) {
+        op = value[0][key_length];
+    }
+
+    const char *data = syntax->buffer.data;
+    const span_t *old = syntax->tokens + line->first_token;
+    int later = 0;
+    for (const syntax_line_t *l = line; duplicates && (l = find_syntax_line(syntax, key, l)) != NULL; )
+        later++;
+
+    // -Assemble the new value: the given values for `=`, the given
+    //  values and the old ones for `+`, and the old ones without the
+    //  given value for `-`.
+    size_t size = line->value.length + 1;
+    for (int i = 1; i < count; i++) size += strlen(value[i]) + 1;
+    char *text = malloc(size);
+    splice_t *edits = malloc((later + 1) * sizeof(splice_t));
+    if (text == NULL || edits == NULL) {
+        fprintf(stderr, "Unable to allocate memory for new replacement string.\n");
+        free(text);
+        free(edits);
+        return 1;
+    }
+    size_t length = 0;
+    text[0] = '\0';
+    if (op != '-') {
+        for (int i = 1; i < count; i++)
+            append_value(text, &length, value[i], strlen(value[i]));
+    }
+    if (op != '=') {
+        size_t remove_length = count > 1 ? strlen(value[1]) : 0;
+        for (int i = 0; i < line->token_count; i++) {
+            if (op == '-' && count > 1 && old[i].length == remove_length && \
+                memcmp(data + old[i].offset, value[1], remove_length) == 0)
+                continue;
+            append_value(text, &length, data + old[i].offset, old[i].length);
+        }
+    }
+
+    // -Splice the value into its line, or drop the line once the last
+    //  value is removed; later lines for the key are dropped either way.
+    int edit_count = 0;
+    if (op == '-' && length == 0) {
+        edits[edit_count++] = (splice_t){ line->start, line->end - line->start, "", 0 };
+        report_change("Last value for key removed. Key removed from file.\n");
+    } else {
+        edits[edit_count++] = (splice_t){ line->value.offset, line->value.length, text, length };
+        if (op != '=') {
+            report_change("%s:", key);
+            for (int i = 0; i < line->token_count; i++)
+                report_change(" %.*s", (int)old[i].length, data + old[i].offset);
+            report_change(" -> %s \n", text);
+        }
+    }
+    for (const syntax_line_t *l = line; duplicates && (l = find_syntax_line(syntax, key, l)) != NULL; )
+        edits[edit_count++] = (splice_t){ l->start, l->end - l->start, "", 0 };
+
+    int rc = commit_splices(edits, edit_count);
+    free(text);
+    free(edits);
+    return rc < 0 ? 1 : 0;
+}
+
+/**
+ *: replacevariable
+ * @brief               Replaces a items value in the config file.
+ *
+ * Only the value of the first line for the key is rewritten (later
+ * lines for the key are dropped); the key, separator, quotes,
+ * terminator, inline comment, indentation and the rest of the file
+ * are copied as they are (see config-syntax.h).
+ *
+ * @param key           The key in the key/value array.
+ * @param value         The value (array) in the key/value array;
+ *                      `value[0]` is the key, followed by `+` or `-`
+ *                      to add or remove a value.
+ * @param count         The value array count.
+ * @param filename      The config file to change.
+ *
+ * @return int          0 on success, 1 on error.
+ */
+int replacevariable(const char *key, char **value, int count, const char *filename) {
+    char delimiters[] = " \t\n\"\':=;";
+    config_syntax_t syntax;
+
+    if (begin_changes(filename) < 0) {
+        fprintf(stderr, "Unable to lock %s: %s\n", filename, strerror(errno));
+        return 1;
+    }
+    if (load_changes(filename, delimiters, &syntax) < 0) {
+        fprintf(stderr, "Unable to create temp file or read config file\n");
+        end_changes();
+        return 1;
+    }
+    const syntax_line_t *line = find_syntax_line(&syntax, key, NULL);
+    if (line == NULL) {
+        fprintf(stderr, "%s: key not found in %s\n", key, filename);
+        free_syntax(&syntax);
+        end_changes();
+        return 1;
+    }
+
+    int rc = replace_line(&syntax, line, key, value, count, 1);
+    free_syntax(&syntax);
+    if (end_changes() < 0)
+        rc = 1;
+    return rc;
+}
+
+/**
+ *: insert_scoped
+ * @brief               Adds a line for a new key at the end of the
+ *                      innermost block its path names.
+ *
+ * @param filename      The config file to change.
+ * @param syntax        Its syntax tree.
+ * @param scope         Its scope index.
+ * @param path          The full path of the key.
+ * @param value         The value array (`value[0]` is the path).
+ * @param count         The value array count.
+ *
+ * @return int          0 on success, 1 on error, -1 if no block of the
+ *                      path is in the file.
+ */
+static int insert_scoped(const char *filename, config_syntax_t *syntax, config_scope_t *scope,
+                         const char *path, char **value, int count) {
+    // -The longest prefix of the path that is a closed block.
+    const scope_node_t *block = NULL;
+    const char *dot = NULL;
+    for (const char *p = path + strlen(path); block == NULL && p > path; p--) {
+        if (*p != '.')
+            continue;
+        char *prefix = strndup(path, p - path);
+        int node = prefix ? find_scope(scope, prefix) : -1;
+        free(prefix);
+        if (node >= 0 && scope->nodes[node].open_line >= 0 && scope->nodes[node].close_line >= 0) {
+            block = &scope->nodes[node];
+            dot = p;
+        }
+    }
+    if (block == NULL) {
+        return -1;
+    }
+
+    // -Indent it like the block's first line (or four spaces).
+    const char *data = syntax->buffer.data;
+    const syntax_line_t *close = &syntax->lines[block->close_line];
+    const syntax_line_t *first = &syntax->lines[block->open_line + 1];
+    size_t indent = 4;
+    const char *indent_text = "    ";
+    if (block->open_line + 1 < block->close_line && first->key.length > 0) {
+        indent = first->key.offset - first->start;
+        indent_text = data + first->start;
+    }
+
+    char *values = assemble_strings(value, count);
+    size_t size = indent + strlen(dot + 1) + (values ? strlen(values) : 0) + 8;
+    char *text = malloc(size);
+    if (values == NULL || text == NULL) {
+        free(values);
+        free(text);
+        return 1;
+    }
+    int length = snprintf(text, size, "%.*s%s = \"%s\";\n", (int)indent, indent_text, dot + 1, values);
+    splice_t edit = { close->start, 0, text, (size_t)length };
+    int rc = commit_splices(&edit, 1);
+    if (rc == 0) {
+        report_change("%-5s: %s = %s\n", filename, path, values);
+    }
+    free(values);
+    free(text);
+    return rc < 0 ? 1 : 0;
+}
+
+/**
+ *: replacescoped
+ * @brief               Changes the value of a key given by its full
+ *                      path (see config-scope.h); only the addressed
+ *                      line (or block) is touched.
+ *
+ * @param path          The path, like `web.ip4.addr`.
+ * @param value         The value array; `value[0]` is the path,
+ *                      followed by `+` or `-` to add or remove a value.
+ * @param count         The value array count.
+ * @param filename      The config file to change.
+ *
+ * @return int          0 on success (or nothing to do), 1 on error,
+ *                      -1 if the path is not in the file.
+ */
+int replacescoped(const char *path, char **value, int count, const char *filename) {
+    char delimiters[] = " \t\n\"\':=;";
+    config_syntax_t syntax;
+    config_scope_t scope;
+
+    if (begin_changes(filename) < 0) {
+        fprintf(stderr, "Unable to lock %s: %s\n", filename, strerror(errno));
+        return 1;
+    }
+    if (load_changes(filename, delimiters, &syntax) < 0) {
+        end_changes();
+        return -1;
+    }
+    if (build_scope(&scope, &syntax) < 0) {
+        free_syntax(&syntax);
+        end_changes();
+        return 1;
+    }
+
+    char op = '=';
+    size_t path_length = strlen(path);
+    if (strlen(value[0]) == path_length + 1 && \
+        (value[0][path_length] == '+' || value[0][path_length] == '-')) {
+        op = value[0][path_length];
+    }
+
+    int rc = -1;
+    int node = find_scope(&scope, path);
+    if (node >= 0 && scope.nodes[node].line >= 0) {
+        const syntax_line_t *line = &syntax.lines[scope.nodes[node].line];
+        const span_t *old = syntax.tokens + line->first_token;
+        int found = 0;
+        for (int i = 0; count > 1 && i < line->token_count; i++) {
+            if (old[i].length == strlen(value[1]) && \
+                memcmp(syntax.buffer.data + old[i].offset, value[1], old[i].length) == 0)
+                found = 1;
+        }
+        if (op == '+' && found) {
+            fprintf(stderr, "Value found in key's value string. No change made.\n");
+            rc = 0;
+        } else if (op == '-' && !found) {
+            fprintf(stderr, "Value not found in value string. No change made.\n");
+            rc = 0;
         } else {
-          // Write the original line to the temp file
-          fprintf(temp_file, "%*s%s", indent, "", str);
-//:~            fputs(str, temp_file);
+            rc = replace_line(&syntax, line, path, value, count, 0);
         }
+    } else if (op == '=' && count > 1) {
+        rc = insert_scoped(filename, &syntax, &scope, path, value, count);
     }
-    fclose(conf_file);
-    fclose(temp_file);
-    remove(filename);
-    rename(".sys.conf.file.tmp", filename);
-    return 0;
+
+    free_scope(&scope);
+    free_syntax(&syntax);
+    if (end_changes() < 0)
+        rc = 1;
+    return rc;
+}
+
+/**
+ *: removevariable
+ * @brief               Removes every line for a key from the config file.
+ *
+ * @param key           The key to remove.
+ * @param filename      The config file to change.
+ *
+ * @return int          The number of lines removed, or -1 on error.
+ */
+int removevariable(const char *key, const char *filename) {
+    char delimiters[] = " \t\n\"\':=;";
+    config_syntax_t syntax;
+
+    if (begin_changes(filename) < 0) {
+        fprintf(stderr, "Unable to lock %s: %s\n", filename, strerror(errno));
+        return -1;
+    }
+    if (load_changes(filename, delimiters, &syntax) < 0) {
+        fprintf(stderr, "Unable to create temp file or read config file\n");
+        end_changes();
+        return -1;
+    }
+
+    int removed = 0;
+    for (const syntax_line_t *l = NULL; (l = find_syntax_line(&syntax, key, l)) != NULL; )
+        removed++;
+    if (removed == 0) {
+        free_syntax(&syntax);
+        end_changes();
+        return 0;
+    }
+
+    splice_t *edits = malloc(removed * sizeof(splice_t));
+    if (edits == NULL) {
+        free_syntax(&syntax);
+        end_changes();
+        return -1;
+    }
+    int edit_count = 0;
+    for (const syntax_line_t *l = NULL; (l = find_syntax_line(&syntax, key, l)) != NULL; )
+        edits[edit_count++] = (splice_t){ l->start, l->end - l->start, "", 0 };
+
+    int rc = commit_splices(edits, edit_count);
+    free(edits);
+    free_syntax(&syntax);
+    if (end_changes() < 0 || rc < 0)
+        return -1;
+    report_change("%s: removed from %s\n", key, filename);
+    return removed;
 }
 
 /**
  *: writevariable
  * @brief               Writes items value in the config file.
  *
+ * The line is appended to the file (under its lock), or added to the
+ * changes being gathered for it (see `begin_changes()`).
+ *
  * @param key           The key in the key/value array.
  * @param value         The value (array) in the key/value array.
  * @param count         The value array count.
  * @param filename      The config file to change.
+ *
+ * @return int          0 on success, 1 on error.
  */
-void writevariable(const char *key, char **value, int count, const char *filename) {
-  FILE* conf_file = fopen(filename, "a");
+int writevariable(const char *key, char **value, int count, const char *filename) {
   int spaces_before = 0;
   int spaces_after = 0;
   char separator = '=';
@@ -407,13 +1346,142 @@ void writevariable(const char *key, char **value, int count, const char *filenam
   quote_char[0] = '"';
 
   char *value_assembled = assemble_strings(value, count);
+  if (value_assembled == NULL)
+    return 1;
 
   // Construct the new line
-  fprintf(conf_file, "%s%*s%c%*s%s%s%s%c\n", key, spaces_before, "", separator, spaces_after, "", quote_char, value_assembled, quote_char, terminator);
+  size_t size = strlen(key) + strlen(value_assembled) + 8;
+  char *line = malloc(size);
+  if (line == NULL || begin_changes(filename) < 0) {
+    fprintf(stderr, "Unable to write %s: %s\n", filename, strerror(errno));
+    free(line);
+    free(value_assembled);
+    return 1;
+  }
+  int written = snprintf(line, size, "%s%*s%c%*s%s%s%s%c\n", key, spaces_before, "", separator, spaces_after, "", quote_char, value_assembled, quote_char, terminator);
+
+  // Nothing else changed yet; append to the file as it is.
+  int rc;
+  if (batch.state == BATCH_CLEAN) {
+    int conf_fd = open(filename, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0666);
+    rc = conf_fd < 0 ? -1 : write_bytes(conf_fd, line, (size_t)written);
+    if (conf_fd >= 0 && close(conf_fd) != 0)
+      rc = -1;
+    batch.appended = 1;
+  } else {
+    rc = batch_changed();
+    if (rc == 0) {
+      splice_t edit = { batch.buffer.length, 0, line, (size_t)written };
+      rc = splice_buffer(&batch.buffer, &edit, 1);
+    }
+  }
 
   /* Prompt via STDOUT the config file changes */
-  printf("%-5s: %s = %s\n", filename, key, value[1]);
+  if (rc == 0)
+    report_change("%-5s: %s = %s\n", filename, key, value[1]);
+  else
+    fprintf(stderr, "Unable to write %s: %s\n", filename, strerror(errno));
 
+  free(line);
   free(value_assembled);
-  fclose(conf_file);
+  if (end_changes() < 0) {
+    fprintf(stderr, "Unable to write %s\n", filename);
+    rc = -1;
+  }
+  return rc == 0 ? 0 : 1;
+}
+/**
+ *: changevariable
+ * @brief               Makes the change of a `key=value`, `key+=value`
+ *                      or `key-=value` argument to a config file.
+ *
+ * The checks are those of `sysconf -f file key=value`: a new key is
+ * appended (or, for a dotted key, added to its block), `+=` of a value
+ * that is there and `-=` of one that is not change nothing, and `+=`
+ * or `-=` of a key that is not there is an error. The file is read as
+ * changed by the batch, if one is open (see `begin_changes()`).
+ *
+ * @param argument      The argument.
+ * @param filename      The config file to change.
+ * @param delimiters    Tokenizer delimiters.
+ * @param errors        The stream problems are reported on.
+ *
+ * @return int          The exit status: 0 (also when nothing needed
+ *                      changing), or 1 on error.
+ */
+int changevariable(const char *argument, const char *filename, char *delimiters, FILE *errors) {
+    char **arg_array = NULL;
+    int arg_count = make_argv(argument, delimiters, &arg_array);
+    char *key = NULL;
+    int rc = 1;
+    if (arg_count < 2) {
+        fprintf(errors, "Error: expected key=value, not '%s'\n", argument);
+        goto done;
+    }
+
+    // -The key of `key+=value` and `key-=value` carries the operator.
+    char op = '=';
+    size_t key_length = strlen(arg_array[0]);
+    if (key_length > 1 && (arg_array[0][key_length - 1] == '+' || arg_array[0][key_length - 1] == '-')) {
+        op = arg_array[0][--key_length];
+    }
+    config_syntax_t syntax;
+    key = strndup(arg_array[0], key_length);
+    if (key == NULL) {
+        fprintf(errors, "Unable to make the change: out of memory\n");
+        goto done;
+    }
+    if (begin_changes(filename) < 0) {
+        fprintf(errors, "Unable to lock %s: %s\n", filename, strerror(errno));
+        goto done;
+    }
+    if (load_changes(filename, delimiters, &syntax) < 0) {
+        fprintf(errors, "Failed to parse the configuration file.\n");
+        end_changes();
+        goto done;
+    }
+
+    const syntax_line_t *line = find_syntax_line(&syntax, key, NULL);
+    if (line == NULL) {
+        int changed = -1;
+        if (strchr(key, '*') != NULL) {
+            fprintf(errors, "Error: only one key can be changed at a time, not a pattern\n");
+        } else if (strchr(key, '.') != NULL && \
+                   (changed = replacescoped(key, arg_array, arg_count, filename)) >= 0) {
+            rc = changed;                               /* a key inside a block */
+        } else if (op != '=') {
+            fprintf(errors, "Incorrect syntax. Key is not found in config file.\n");
+        } else {
+            rc = writevariable(arg_array[0], arg_array, arg_count, filename);
+        }
+    } else {
+        const span_t *old = syntax.tokens + line->first_token;
+        size_t value_length = strlen(arg_array[1]);
+        int found = 0;
+        for (int i = 0; i < line->token_count; i++) {
+            if (old[i].length == value_length && \
+                memcmp(syntax.buffer.data + old[i].offset, arg_array[1], value_length) == 0)
+                found = 1;
+        }
+        if (op == '-' && !found) {
+            fprintf(errors, "Value not found in value string. No change made.\n");
+            rc = 0;
+        } else if (op == '+' && found) {
+            fprintf(errors, "Value found in key's value string. No change made.\n");
+            rc = 0;
+        } else {
+            rc = replace_line(&syntax, line, key, arg_array, arg_count, 1);
+        }
+    }
+    free_syntax(&syntax);
+    if (end_changes() < 0) {
+        fprintf(errors, "Unable to write %s\n", filename);
+        rc = 1;
+    }
+
+done:
+    free(key);
+    for (int i = 0; i < arg_count; i++) free(arg_array[i]);
+    free(arg_array);
+    return rc;
 }
@@ -3,21 +3,116 @@
  *
  * These functions accept an array and locate the first value in the
  * array in the config file and replace the config value with the
- * given array contents.
+ * given array contents. Only the bytes of the value are replaced; the
+ * rest of the file is copied as it is (see config-syntax.h).
+ *
+ * A change is made under an advisory lock of the file and written to
+ * a temp file next to it that is renamed over it, so writers to the
+ * same file wait for each other and writers to different files do not
+ * meet at all. Several changes can be gathered and written at once:
+ *
+ *      if (begin_changes("rc.conf") == 0) {
+ *          changevariable("sshd_enable=YES", "rc.conf", delimiters, stderr);
+ *          changevariable("ntpd_enable=YES", "rc.conf", delimiters, stderr);
+ *          end_changes();                  (one rewrite)
+ *      }
  */
+#ifndef PRINT_CONFIG_H
+#define PRINT_CONFIG_H
+
+#include "parse-config.h"
+
+#include <stdio.h>
+
+//: set_change_output
+//      Sets the stream the change reports of `replacevariable()` and
+//      `writevariable()` are printed to (STDOUT by default, NULL for
+//      none). Returns the stream they went to until now.
+FILE *set_change_output(FILE *stream);
+
+//: lock_config
+//      Take the advisory lock of a config file, waiting for any other
+//      writer to let go of it; the file is created if it is not there.
+//      The same file may be locked again while it is held. Returns 0 on
+//      success, -1 on error with `errno` set.
+int lock_config(const char *filename);
+
+//: unlock_config
+//      Release the lock taken by `lock_config()`.
+void unlock_config(void);
+
+//: begin_changes
+//      Lock a config file and gather the changes the functions below
+//      make to it in memory, each seeing the ones before it, until
+//      `end_changes()`. Calls may nest. Returns 0 on success, -1 on
+//      error with `errno` set.
+int begin_changes(const char *filename);
+
+//: end_changes
+//      Write the changes gathered since `begin_changes()` in one
+//      rewrite of the file and unlock it. Returns 0 on success, -1 if
+//      the file could not be written.
+int end_changes(void);
+
+//: changevariable
+//      Make the change of a `key=value` (`+=`, `-=`) argument to the
+//      config file with the checks `sysconf -f file key=value` makes;
+//      problems are printed to `errors`. Returns the exit status.
+int changevariable(const char *argument, const char *filename, char *delimiters, FILE *errors);
 
 //: replacevariable
-//      Replaces a items value in the config file.
+//      Replaces a items value in the config file. `value` is not
+//      modified; it still belongs to the caller afterwards.
 int replacevariable(const char *key, char **value, int count, const char *filename);
 
+//: replacescoped
+//      Like `replacevariable()` for a key given by its full path
+//      (`block.key.subkey`, see config-scope.h): only that line is
+//      changed, and a new key is added at the end of its block.
+//      Returns 0, 1 on error, or -1 if the path is not in the file.
+int replacescoped(const char *path, char **value, int count, const char *filename);
+
+//: removevariable
+//      Removes every line for `key` from the config file.
+int removevariable(const char *key, const char *filename);
+
 //: writevariable
-//      Write items in value in the config file.
-void writevariable(const char *key, char **value, int count, const char *filename);
+//      Write items in value in the config file. Returns 0 on success,
+//      1 on error.
+int writevariable(const char *key, char **value, int count, const char *filename);
 
 //: Printconfifile
 //      Iterates the `config_array` and prints the items.
 void printconfigfile(config_t *config_array,int array_count);
 
+// Formats for `print_config_file()`
+enum {
+    PRINT_ALIGNED,                                      /* key       \t=\tvalue ... (the default) */
+    PRINT_RAW,                                          /* key=value ... */
+    PRINT_NUL                                           /* key=value ... ending in '\0' */
+};
+
+//: print_config_file
+//      Print every entry of `config` to `fd` in one pass, in one of the
+//      PRINT_ formats. Returns 0 on success, -1 on error.
+int print_config_file(config_t *config, int count, int format, int fd);
+
+//: print_config_keys
+//      Print the key of every entry of `config` to `fd`, one per line
+//      (`\0`-terminated for PRINT_NUL), without tokenizing the values.
+//      Returns 0 on success, -1 on error.
+int print_config_keys(config_t *config, int count, int format, int fd);
+
+//: print_config_stream
+//      Like `print_config_file()`, to a stream.
+int print_config_stream(config_t *config, int count, int format, FILE *stream);
+
+//: report_duplicates
+//      Print a `*DUPLICATE* key: 'value'` line to `out` for each value
+//      of `config` that its key also has in `defaults`. Returns the
+//      number of duplicates, or -1 on error.
+int report_duplicates(config_t *config, int count, config_t *defaults, int default_count, FILE *out);
+
 //: assemble_strings
 //      This function assembles the array of char arrays into a string
 //      (omitting the first char array which should be the 'key' in a
@@ -27,3 +122,5 @@ char* assemble_strings(char **value, int count);
 //: add_to_array
 //      This function will append a string to given `argvp`.
 int add_to_array(char ***argvp, int size, const char *string);
+
+#endif /* PRINT_CONFIG_H */
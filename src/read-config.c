@@ -0,0 +1,874 @@
+#include "read-config.h"
+#include "stats.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#if defined(__linux__)
+#define LOAD_URING                                      /* load_files() may use io_uring */
+#include <stdint.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include <linux/stat.h>
+#ifndef AT_EMPTY_PATH
+#define AT_EMPTY_PATH   0x1000                          /* (only with _GNU_SOURCE in <fcntl.h>) */
+#endif
+#endif
+
+#define READ_CHUNK      (64 * 1024)                     /* initial read() size for unmappable files */
+#define LOAD_MAP_BYTES  (1024 * 1024)                   /* load_files() maps files this big */
+#define LOAD_URING_MIN_FILES    4                       /* fewer files are not worth a ring */
+
+/**
+ *: read_all
+ * @brief               Reads everything from `fd` into a malloc'd buffer.
+ *
+ * @param fd            An open file descriptor.
+ * @param buffer        The buffer to fill.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int read_all(int fd, file_buffer_t *buffer) {
+    size_t capacity = READ_CHUNK;
+    size_t length = 0;
+    char *data = malloc(capacity);
+    if (data == NULL) {
+        return -1;
+    }
+
+    for (;;) {
+        if (length == capacity) {
+            char *grown = realloc(data, capacity * 2);
+            if (grown == NULL) {
+                free(data);
+                return -1;
+            }
+            data = grown;
+            capacity *= 2;
+        }
+
+        ssize_t n = read(fd, data + length, capacity - length);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            free(data);
+            return -1;
+        }
+        if (n == 0)
+            break;
+        length += (size_t)n;
+    }
+
+    buffer->data = data;
+    buffer->length = length;
+    buffer->mapped = 0;
+    stats.bytes_read += length;
+    return 0;
+}
+
+/**
+ *: load_file
+ * @brief               Map (or read) the whole of `filename` into `buffer`.
+ *
+ * @param filename      The file to load.
+ * @param buffer        The buffer to fill.
+ *
+ * @return 0 on success, -1 on error with `errno` set.
+ */
+int load_file(const char *filename, file_buffer_t *buffer) {
+    return load_file_stat(filename, buffer, NULL);
+}
+
+static int load_mmap = 1;                               /* see set_load_mmap() */
+
+/**
+ *: set_load_mmap
+ * @brief               Lets `load_file()` map regular files (or not).
+ *
+ * A mapped file that another process truncates faults when the lost
+ * pages are read; a program that keeps files loaded for long reads
+ * them instead.
+ *
+ * @param enable        1 = map regular files, 0 = read them.
+ */
+void set_load_mmap(int enable) {
+    load_mmap = enable;
+}
+
+/**
+ *: load_file_as
+ * @brief               Loads a file for `load_file_stat()` and
+ *                      `read_file()`.
+ *
+ * @param filename      The file to load.
+ * @param buffer        The buffer to fill.
+ * @param info          Filled with the file's status (may be NULL).
+ * @param may_map       1 = map a regular file, 0 = read it.
+ *
+ * @return 0 on success, -1 on error with `errno` set.
+ */
+static int load_file_as(const char *filename, file_buffer_t *buffer, struct stat *info, int may_map) {
+    struct stat st;
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+
+    buffer->data = NULL;
+    buffer->length = 0;
+    buffer->mapped = 0;
+
+    if (fstat(fd, &st) < 0) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return -1;
+    }
+    if (info != NULL) {
+        *info = st;
+    }
+
+    // Empty regular file; nothing to map.
+    if (S_ISREG(st.st_mode) && st.st_size == 0) {
+        close(fd);
+        return 0;
+    }
+
+    if (S_ISREG(st.st_mode) && may_map) {
+        void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+#ifdef MADV_SEQUENTIAL
+            madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+#endif
+            buffer->data = map;
+            buffer->length = (size_t)st.st_size;
+            buffer->mapped = 1;
+            stats.bytes_read += buffer->length;
+            close(fd);
+            return 0;
+        }
+        // Fall through and read it instead.
+    }
+
+    int rc = read_all(fd, buffer);
+    int saved = errno;
+    close(fd);
+    errno = saved;
+    return rc;
+}
+
+/**
+ *: load_file_stat
+ * @brief               Like `load_file()` but also returns the `stat`
+ *                      of the file that was loaded.
+ *
+ * @param filename      The file to load.
+ * @param buffer        The buffer to fill.
+ * @param info          Filled with the file's status (may be NULL).
+ *
+ * @return 0 on success, -1 on error with `errno` set.
+ */
+int load_file_stat(const char *filename, file_buffer_t *buffer, struct stat *info) {
+    return load_file_as(filename, buffer, info, load_mmap);
+}
+
+/**
+ *: read_file
+ * @brief               Read the whole of `filename` into `buffer`,
+ *                      never mapping it (whatever `set_load_mmap()`
+ *                      says).
+ *
+ * @param filename      The file to load.
+ * @param buffer        The buffer to fill.
+ *
+ * @return 0 on success, -1 on error with `errno` set.
+ */
+int read_file(const char *filename, file_buffer_t *buffer) {
+    return load_file_as(filename, buffer, NULL, 0);
+}
+
+/**
+ *: unload_file
+ * @brief               Release the memory held by `buffer`.
+ *
+ * @param buffer        The buffer to release.
+ */
+void unload_file(file_buffer_t *buffer) {
+    if (buffer->data != NULL) {
+        if (buffer->mapped)
+            munmap(buffer->data, buffer->length);
+        else
+            free(buffer->data);
+    }
+    buffer->data = NULL;
+    buffer->length = 0;
+    buffer->mapped = 0;
+}
+
+static int load_uring = 1;                              /* see set_load_uring() */
+
+/**
+ *: set_load_uring
+ * @brief               Lets `load_files()` use io_uring (or not).
+ *
+ * @param enable        1 = use io_uring when it works, 0 = never.
+ */
+void set_load_uring(int enable) {
+    load_uring = enable;
+}
+
+#ifdef LOAD_URING
+
+// An io_uring instance (mapped rings)
+typedef struct {
+    int fd;
+    unsigned entries;                                   /* submission queue size */
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_ring, *cq_ring;
+    size_t sq_ring_size, cq_ring_size, sqes_size;
+    unsigned queued;                                    /* sqes not yet submitted */
+} uring_t;
+
+// Where a file is in `uring_load_files()`
+enum { SLOT_OPEN, SLOT_STAT, SLOT_READ, SLOT_CLOSE };
+
+// A file being loaded
+typedef struct {
+    int file;                                           /* index in `filenames` */
+    int fd;
+    int stage;                                          /* SLOT_* */
+    struct statx stx;
+    file_buffer_t buffer;
+    size_t size;                                        /* bytes to read */
+    unsigned sqe;                                       /* where its last step is in the submission queue */
+} uring_slot_t;
+
+#define URING_CANCEL    (1ULL << 32)                    /* user_data of a cancel (| the slot) */
+
+/**
+ *: uring_close
+ * @brief               Unmaps the rings and closes the instance.
+ *
+ * @param ring          The ring.
+ */
+static void uring_close(uring_t *ring) {
+    if (ring->sqes != NULL && ring->sqes != MAP_FAILED)
+        munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_ring != NULL && ring->cq_ring != MAP_FAILED && ring->cq_ring != ring->sq_ring)
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    if (ring->sq_ring != NULL && ring->sq_ring != MAP_FAILED)
+        munmap(ring->sq_ring, ring->sq_ring_size);
+    if (ring->fd >= 0)
+        close(ring->fd);
+}
+
+/**
+ *: uring_open
+ * @brief               Sets up an io_uring instance that can open,
+ *                      statx, read and close files.
+ *
+ * @param ring          The ring to set up.
+ * @param entries       The submission queue size.
+ *
+ * @return 0 on success, -1 if io_uring cannot be used.
+ */
+static int uring_open(uring_t *ring, unsigned entries) {
+    struct io_uring_params params;
+    memset(ring, 0, sizeof(*ring));
+    memset(&params, 0, sizeof(params));
+    ring->fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+    if (ring->fd < 0) {
+        return -1;
+    }
+
+    // Every operation used must be there (kernel 5.6 or later).
+    size_t probe_size = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe *probe = calloc(1, probe_size);
+    int ops[] = { IORING_OP_OPENAT, IORING_OP_STATX, IORING_OP_READ, IORING_OP_CLOSE };
+    int usable = probe != NULL && \
+                 syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_PROBE, probe, 256) == 0;
+    for (size_t i = 0; usable && i < sizeof(ops) / sizeof(ops[0]); i++) {
+        if (ops[i] > probe->last_op || !(probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED))
+            usable = 0;
+    }
+    free(probe);
+    if (!usable) {
+        close(ring->fd);
+        return -1;
+    }
+
+    ring->entries = params.sq_entries;
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_ring_size > ring->sq_ring_size)
+            ring->sq_ring_size = ring->cq_ring_size;
+        ring->cq_ring_size = ring->sq_ring_size;
+    }
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED, ring->fd, IORING_OFF_SQ_RING);
+    ring->cq_ring = ring->sq_ring;
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP) && ring->sq_ring != MAP_FAILED) {
+        ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE,
+                             MAP_SHARED, ring->fd, IORING_OFF_CQ_RING);
+    }
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    if (ring->sq_ring != MAP_FAILED && ring->cq_ring != MAP_FAILED) {
+        ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                          MAP_SHARED, ring->fd, IORING_OFF_SQES);
+    }
+    if (ring->sq_ring == MAP_FAILED || ring->cq_ring == MAP_FAILED || \
+        ring->sqes == NULL || ring->sqes == MAP_FAILED) {
+        uring_close(ring);
+        return -1;
+    }
+
+    char *sq = ring->sq_ring, *cq = ring->cq_ring;
+    ring->sq_head = (unsigned *)(sq + params.sq_off.head);
+    ring->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned *)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned *)(sq + params.sq_off.array);
+    ring->cq_head = (unsigned *)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned *)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+    return 0;
+}
+
+/**
+ *: uring_sqe
+ * @brief               Queues an operation.
+ *
+ * @param ring          The ring.
+ * @param opcode        The IORING_OP_* operation.
+ * @param user_data     Returned in the completion.
+ *
+ * @return struct io_uring_sqe*  The cleared entry to fill in.
+ */
+static struct io_uring_sqe *uring_sqe(uring_t *ring, int opcode, uint64_t user_data) {
+    unsigned tail = *ring->sq_tail;
+    unsigned index = tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = (unsigned char)opcode;
+    sqe->user_data = user_data;
+    ring->sq_array[index] = index;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ring->queued++;
+    return sqe;
+}
+
+/**
+ *: uring_step
+ * @brief               Queues the next operation of a file (its slot
+ *                      number is returned in the completion).
+ *
+ * @param ring          The ring.
+ * @param opcode        The IORING_OP_* operation.
+ * @param slot          The file.
+ * @param s             Its slot number.
+ *
+ * @return struct io_uring_sqe*  The cleared entry to fill in.
+ */
+static struct io_uring_sqe *uring_step(uring_t *ring, int opcode, uring_slot_t *slot, unsigned s) {
+    slot->sqe = *ring->sq_tail;
+    return uring_sqe(ring, opcode, s);
+}
+
+/**
+ *: uring_read
+ * @brief               Queues a read of the rest of a file.
+ *
+ * @param ring          The ring.
+ * @param slot          The file.
+ * @param s             Its slot number.
+ */
+static void uring_read(uring_t *ring, uring_slot_t *slot, unsigned s) {
+    struct io_uring_sqe *sqe = uring_step(ring, IORING_OP_READ, slot, s);
+    sqe->fd = slot->fd;
+    sqe->addr = (uintptr_t)(slot->buffer.data + slot->buffer.length);
+    sqe->len = (unsigned)(slot->size - slot->buffer.length);
+    sqe->off = slot->buffer.length;
+}
+
+/**
+ *: uring_next
+ * @brief               Queues the next step for a file after one has
+ *                      finished (or fails it).
+ *
+ * @param ring          The ring.
+ * @param slots         The files being loaded.
+ * @param s             The slot that finished a step.
+ * @param res           The result of that step.
+ * @param filenames     The files.
+ * @param loaded        Called when the file is loaded (or failed).
+ * @param arg           Passed to `loaded`.
+ *
+ * @return 1 when the slot is free again, 0 otherwise.
+ */
+static int uring_next(uring_t *ring, uring_slot_t *slots, unsigned s, int res,
+                      const char **filenames, file_loaded_fn loaded, void *arg) {
+    uring_slot_t *slot = &slots[s];
+    struct io_uring_sqe *sqe;
+
+    switch (slot->stage) {
+        case SLOT_OPEN:
+            if (res < 0) {
+                loaded(arg, slot->file, NULL, -res);
+                return 1;
+            }
+            slot->fd = res;
+            slot->stage = SLOT_STAT;
+            sqe = uring_step(ring, IORING_OP_STATX, slot, s);
+            sqe->fd = slot->fd;
+            sqe->addr = (uintptr_t)"";
+            sqe->len = STATX_TYPE | STATX_SIZE;
+            sqe->off = (uintptr_t)&slot->stx;
+            sqe->statx_flags = AT_EMPTY_PATH;
+            return 0;
+
+        case SLOT_STAT:
+            if (res < 0 || !S_ISREG(slot->stx.stx_mode) || slot->stx.stx_size >= LOAD_MAP_BYTES) {
+                // Large files are mapped and others (fifos, devices)
+                // read as usual.
+                file_buffer_t buffer;
+                if (load_file(filenames[slot->file], &buffer) == 0)
+                    loaded(arg, slot->file, &buffer, 0);
+                else
+                    loaded(arg, slot->file, NULL, errno);
+                break;
+            }
+            slot->size = (size_t)slot->stx.stx_size;
+            if (slot->size == 0) {
+                loaded(arg, slot->file, &slot->buffer, 0);
+                break;
+            }
+            slot->buffer.data = malloc(slot->size);
+            if (slot->buffer.data == NULL) {
+                loaded(arg, slot->file, NULL, ENOMEM);
+                break;
+            }
+            slot->stage = SLOT_READ;
+            uring_read(ring, slot, s);
+            return 0;
+
+        case SLOT_READ:
+            if (res < 0) {
+                free(slot->buffer.data);
+                slot->buffer.data = NULL;
+                loaded(arg, slot->file, NULL, -res);
+                break;
+            }
+            slot->buffer.length += (size_t)res;
+            // Read on until the size `statx()` gave, or the end of a file
+            // that got shorter (a read of 0).
+            if (res > 0 && slot->buffer.length < slot->size) {
+                uring_read(ring, slot, s);
+                return 0;
+            }
+            stats.bytes_read += slot->buffer.length;
+            loaded(arg, slot->file, &slot->buffer, 0);
+            break;
+
+        default:                                        /* SLOT_CLOSE */
+            return 1;
+    }
+
+    slot->stage = SLOT_CLOSE;
+    sqe = uring_step(ring, IORING_OP_CLOSE, slot, s);
+    sqe->fd = slot->fd;
+    return 0;
+}
+
+/**
+ *: uring_drain
+ * @brief               Waits until the kernel is done with the files
+ *                      still being loaded (after `io_uring_enter()`
+ *                      failed): steps not yet submitted are taken back
+ *                      and those in flight cancelled.
+ *
+ * An open that completes sets the slot's `fd`; a close that does
+ * clears it.
+ *
+ * @param ring          The ring.
+ * @param slots         The files being loaded.
+ * @param busy          1 for each slot that is loading a file.
+ *
+ * @return 0 once the kernel is done with every slot, -1 if the ring
+ *         failed again (it may still write to them).
+ */
+static int uring_drain(uring_t *ring, uring_slot_t *slots, const int *busy) {
+    // The kernel only reads the submission queue in io_uring_enter().
+    __atomic_store_n(ring->sq_tail, *ring->sq_tail - ring->queued, __ATOMIC_RELEASE);
+    ring->queued = 0;
+
+    unsigned sq_tail = *ring->sq_tail;
+    int waiting = 0;
+    for (unsigned s = 0; s < LOAD_BATCH; s++) {
+        if (!busy[s] || (int)(sq_tail - slots[s].sqe) <= 0)
+            continue;
+        waiting++;
+        if (slots[s].stage != SLOT_CLOSE) {
+            struct io_uring_sqe *sqe = uring_sqe(ring, IORING_OP_ASYNC_CANCEL, URING_CANCEL | s);
+            sqe->addr = s;
+        }
+    }
+
+    while (waiting > 0) {
+        int done = (int)syscall(__NR_io_uring_enter, ring->fd, ring->queued, 1,
+                                IORING_ENTER_GETEVENTS, NULL, 0);
+        if (done < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        ring->queued -= (unsigned)done;
+
+        unsigned head = *ring->cq_head;
+        unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++) {
+            const struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+            if (cqe->user_data & URING_CANCEL)
+                continue;
+            uring_slot_t *slot = &slots[cqe->user_data];
+            if (slot->stage == SLOT_OPEN && cqe->res >= 0)
+                slot->fd = cqe->res;
+            else if (slot->stage == SLOT_CLOSE)
+                slot->fd = -1;
+            waiting--;
+        }
+        __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+    }
+    return 0;
+}
+
+/**
+ *: uring_load_files
+ * @brief               `load_files()` through io_uring: keeps up to
+ *                      LOAD_BATCH files moving through open, statx,
+ *                      read and close, and submits each round of
+ *                      operations with one system call.
+ *
+ * @param filenames     The files.
+ * @param count         The number of files.
+ * @param loaded        Called for each file.
+ * @param arg           Passed to `loaded`.
+ *
+ * @return 0 if every file was handed to `loaded`, -1 if io_uring could
+ *         not be set up (and none was).
+ */
+static int uring_load_files(const char **filenames, int count, file_loaded_fn loaded, void *arg) {
+    uring_t ring;
+    if (uring_open(&ring, LOAD_BATCH) < 0) {
+        return -1;
+    }
+
+    // (On the heap: if the ring fails, the kernel may still write to a
+    // slot, see below.)
+    uring_slot_t *slots = malloc(LOAD_BATCH * sizeof(uring_slot_t));
+    if (slots == NULL) {
+        uring_close(&ring);
+        return -1;
+    }
+    unsigned free_slots[LOAD_BATCH];
+    unsigned free_count = 0;
+    for (unsigned s = 0; s < ring.entries && s < LOAD_BATCH; s++) {
+        free_slots[free_count++] = s;
+    }
+    unsigned active = 0;
+    int next = 0;
+
+    while (next < count || active > 0) {
+        // Start opening as many files as there are free slots.
+        while (next < count && free_count > 0) {
+            unsigned s = free_slots[--free_count];
+            memset(&slots[s], 0, sizeof(slots[s]));
+            slots[s].file = next++;
+            slots[s].fd = -1;
+            slots[s].stage = SLOT_OPEN;
+            struct io_uring_sqe *sqe = uring_step(&ring, IORING_OP_OPENAT, &slots[s], s);
+            sqe->fd = AT_FDCWD;
+            sqe->addr = (uintptr_t)filenames[slots[s].file];
+            sqe->open_flags = O_RDONLY | O_CLOEXEC;
+            active++;
+        }
+
+        // Submit them, with the next steps of the files already open,
+        // and wait for at least one to finish.
+        int done = (int)syscall(__NR_io_uring_enter, ring.fd, ring.queued, 1,
+                                IORING_ENTER_GETEVENTS, NULL, 0);
+        if (done < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        ring.queued -= (unsigned)done;
+
+        unsigned head = *ring.cq_head;
+        unsigned tail = __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++) {
+            const struct io_uring_cqe *cqe = &ring.cqes[head & *ring.cq_mask];
+            unsigned s = (unsigned)cqe->user_data;
+            if (uring_next(&ring, slots, s, cqe->res, filenames, loaded, arg)) {
+                free_slots[free_count++] = s;
+                active--;
+            }
+        }
+        __atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+    }
+
+    // Only if io_uring_enter() itself failed: once the kernel is done
+    // with the files that were moving, load the ones not yet handed
+    // over the plain way, as those not yet started. If it cannot be
+    // waited for, their buffers, fds and slots are left to it.
+    int drained = 1;
+    if (active > 0) {
+        int busy[LOAD_BATCH];
+        for (unsigned s = 0; s < LOAD_BATCH; s++)
+            busy[s] = s < ring.entries;
+        for (unsigned f = 0; f < free_count; f++)
+            busy[free_slots[f]] = 0;
+        drained = uring_drain(&ring, slots, busy) == 0;
+
+        for (unsigned s = 0; s < LOAD_BATCH; s++) {
+            if (!busy[s])
+                continue;
+            if (drained && slots[s].fd >= 0)
+                close(slots[s].fd);
+            if (slots[s].stage == SLOT_CLOSE)
+                continue;                               /* (already handed over) */
+            if (drained)
+                free(slots[s].buffer.data);
+            file_buffer_t buffer;
+            if (load_file(filenames[slots[s].file], &buffer) == 0)
+                loaded(arg, slots[s].file, &buffer, 0);
+            else
+                loaded(arg, slots[s].file, NULL, errno);
+        }
+    }
+    for (; next < count; next++) {
+        file_buffer_t buffer;
+        if (load_file(filenames[next], &buffer) == 0)
+            loaded(arg, next, &buffer, 0);
+        else
+            loaded(arg, next, NULL, errno);
+    }
+
+    uring_close(&ring);
+    if (drained)
+        free(slots);
+    return 0;
+}
+
+#endif /* LOAD_URING */
+
+/**
+ *: load_files
+ * @brief               Loads many files, handing each one over as soon
+ *                      as it is in memory.
+ *
+ * @param filenames     The files.
+ * @param count         The number of files.
+ * @param loaded        Called for each file (on this thread).
+ * @param arg           Passed to `loaded`.
+ */
+void load_files(const char **filenames, int count, file_loaded_fn loaded, void *arg) {
+#ifdef LOAD_URING
+    if (load_uring && count >= LOAD_URING_MIN_FILES && \
+        uring_load_files(filenames, count, loaded, arg) == 0) {
+        return;
+    }
+#endif
+    for (int i = 0; i < count; i++) {
+        file_buffer_t buffer;
+        if (load_file(filenames[i], &buffer) == 0)
+            loaded(arg, i, &buffer, 0);
+        else
+            loaded(arg, i, NULL, errno);
+    }
+}
+
+/**
+ *: load_backend
+ * @brief               Says how `load_files()` reads files here.
+ *
+ * @return const char*  "io_uring" or "read".
+ */
+const char *load_backend(void) {
+#ifdef LOAD_URING
+    uring_t ring;
+    if (load_uring && uring_open(&ring, 1) == 0) {
+        uring_close(&ring);
+        return "io_uring";
+    }
+#endif
+    return "read";
+}
+
+/**
+ *: open_lines
+ * @brief               Opens a file to be read a line at a time.
+ *
+ * @param filename      The file to read.
+ * @param reader        The reader to set up.
+ * @param chunk_size    Bytes per read() (0 = READ_CHUNK).
+ *
+ * @return 0 on success, -1 on error with `errno` set.
+ */
+int open_lines(const char *filename, line_reader_t *reader, size_t chunk_size) {
+    memset(reader, 0, sizeof(*reader));
+    reader->chunk_size = chunk_size ? chunk_size : READ_CHUNK;
+    if ((reader->chunk = malloc(reader->chunk_size)) == NULL) {
+        return -1;
+    }
+    if ((reader->fd = open(filename, O_RDONLY)) < 0) {
+        int saved = errno;
+        free(reader->chunk);
+        reader->chunk = NULL;
+        errno = saved;
+        return -1;
+    }
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(reader->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    return 0;
+}
+
+/**
+ *: fill_chunk
+ * @brief               Reads the next chunk of the file (once the last
+ *                      one has been used up).
+ *
+ * @param reader        The reader.
+ *
+ * @return 1 if there is more data, 0 at the end of the file or on
+ *         error.
+ */
+static int fill_chunk(line_reader_t *reader) {
+    reader->start = reader->end = 0;
+    while (!reader->eof) {
+        ssize_t n = read(reader->fd, reader->chunk, reader->chunk_size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0) {
+            reader->eof = 1;
+            if (n < 0)
+                reader->error = errno;
+            break;
+        }
+        reader->end = (size_t)n;
+        stats.bytes_read += (size_t)n;
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ *: extend_line
+ * @brief               Adds bytes to the line being put together from
+ *                      several chunks.
+ *
+ * @param reader        The reader.
+ * @param length        The length of the line so far.
+ * @param data          The bytes to add.
+ * @param count         The number of bytes.
+ *
+ * @return 0 on success, -1 when out of memory.
+ */
+static int extend_line(line_reader_t *reader, size_t length, const char *data, size_t count) {
+    if (length + count > reader->line_capacity) {
+        size_t capacity = reader->line_capacity ? reader->line_capacity : reader->chunk_size;
+        while (capacity < length + count) capacity *= 2;
+        char *grown = realloc(reader->line, capacity);
+        if (grown == NULL) {
+            reader->error = ENOMEM;
+            return -1;
+        }
+        reader->line = grown;
+        reader->line_capacity = capacity;
+    }
+    memcpy(reader->line + length, data, count);
+    return 0;
+}
+
+/**
+ *: read_line
+ * @brief               Returns the next line of the file.
+ *
+ * A line that is entirely within the current chunk is returned where
+ * it is; one that runs past the end of the chunk is copied together
+ * into `reader->line` (which grows to the longest such line).
+ *
+ * @param reader        The reader.
+ * @param length        Set to the length of the line (including '\n').
+ *
+ * @return const char*  The line, or NULL at the end of the file or on
+ *                      error (`reader->error` is set).
+ */
+const char *read_line(line_reader_t *reader, size_t *length) {
+    if (reader->start == reader->end && !fill_chunk(reader)) {
+        return NULL;
+    }
+
+    const char *data = reader->chunk + reader->start;
+    size_t available = reader->end - reader->start;
+    const char *eol = memchr(data, '\n', available);
+    if (eol != NULL) {
+        *length = (size_t)(eol - data) + 1;
+        reader->start += *length;
+        reader->offset += *length;
+        reader->line_number++;
+        return data;
+    }
+
+    // The line continues in the next chunk(s).
+    size_t line_length = 0;
+    do {
+        if (extend_line(reader, line_length, reader->chunk + reader->start, reader->end - reader->start) < 0)
+            return NULL;
+        line_length += reader->end - reader->start;
+        if (!fill_chunk(reader))
+            break;
+        eol = memchr(reader->chunk, '\n', reader->end);
+        if (eol != NULL) {
+            size_t rest = (size_t)(eol - reader->chunk) + 1;
+            if (extend_line(reader, line_length, reader->chunk, rest) < 0)
+                return NULL;
+            line_length += rest;
+            reader->start = rest;
+            break;
+        }
+    } while (1);
+
+    if (reader->error) {
+        return NULL;
+    }
+    *length = line_length;
+    reader->offset += line_length;
+    reader->line_number++;
+    return reader->line;
+}
+
+/**
+ *: close_lines
+ * @brief               Closes the file and releases the reader's buffers.
+ *
+ * @param reader        The reader.
+ */
+void close_lines(line_reader_t *reader) {
+    if (reader->fd >= 0)
+        close(reader->fd);
+    free(reader->chunk);
+    free(reader->line);
+    reader->fd = -1;
+    reader->chunk = reader->line = NULL;
+}
@@ -0,0 +1,133 @@
+/**
+ * This code loads a configuration file into memory in one piece so
+ * the parser can walk it in a single pass.
+ *
+ * Regular files are mapped with `mmap()`; anything that cannot be
+ * mapped (pipes, fifos, character devices) is read with a few large
+ * `read()` calls into a growing buffer. Either way the caller gets a
+ * pointer and a length; the data is NOT nul-terminated.
+ *
+ *      file_buffer_t buffer;
+ *      if (load_file("rc.conf", &buffer) == 0) {
+ *          ...walk buffer.data[0 .. buffer.length)...
+ *          unload_file(&buffer);
+ *      }
+ *
+ * Many files can be loaded at once with `load_files()`. On Linux the
+ * opens, `statx()`es, reads and closes of up to LOAD_BATCH files are
+ * submitted together through io_uring, so a few hundred small files
+ * take a handful of system calls instead of several each; elsewhere
+ * (or when io_uring is not available) each file is loaded with
+ * `load_file()`. Either way the caller is handed each file as soon as
+ * it is in memory:
+ *
+ *      static void loaded(void *arg, int file, file_buffer_t *buffer, int error) {
+ *          ...buffer (now the caller's), or NULL and errno `error`...
+ *      }
+ *      load_files(filenames, count, loaded, arg);
+ *
+ * When only part of a file is wanted (or it may be a pipe), it can be
+ * streamed a line at a time instead. Lines may be of any length; the
+ * reader holds one chunk of the file plus the current line if that
+ * runs past the end of the chunk, whatever the size of the file.
+ *
+ *      line_reader_t reader;
+ *      if (open_lines("rc.conf", &reader, 0) == 0) {
+ *          while ((line = read_line(&reader, &length)) != NULL)
+ *              ...line[0 .. length), including its '\n'...
+ *          close_lines(&reader);
+ *      }
+ */
+#ifndef READ_CONFIG_H
+#define READ_CONFIG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+// Loaded file data
+typedef struct {
+    char *data;                                         /* file contents (not nul-terminated) */
+    size_t length;                                      /* number of bytes in `data` */
+    int mapped;                                         /* 1 = mmap()'d, 0 = malloc()'d */
+} file_buffer_t;
+
+//: load_file
+//      Map (or read) the whole of `filename` into `buffer`.
+//      Returns 0 on success, -1 on error with `errno` set.
+int load_file(const char *filename, file_buffer_t *buffer);
+
+//: load_file_stat
+//      Like `load_file()`, and fill `info` (if not NULL) with the
+//      status of the file that was loaded.
+int load_file_stat(const char *filename, file_buffer_t *buffer, struct stat *info);
+
+//: read_file
+//      Like `load_file()`, but always read the file into memory (for
+//      data that is kept while others may truncate the file).
+int read_file(const char *filename, file_buffer_t *buffer);
+
+//: set_load_mmap
+//      1, the default, lets `load_file()` map regular files; 0 reads
+//      them into memory instead (for a process that keeps files loaded
+//      while others may truncate them).
+void set_load_mmap(int enable);
+
+//: unload_file
+//      Release the memory held by `buffer`.
+void unload_file(file_buffer_t *buffer);
+
+#define LOAD_BATCH      64                              /* files in flight at once (io_uring) */
+
+// Called by `load_files()` for each file as it is loaded: `buffer` is
+// the file (to be released with `unload_file()`), or NULL with `error`
+// set to the errno of the failure.
+typedef void (*file_loaded_fn)(void *arg, int file, file_buffer_t *buffer, int error);
+
+//: load_files
+//      Load `count` files, batching the system calls through io_uring
+//      when it can be used, and call `loaded` for each file as soon as
+//      it is in memory (in the order they finish, on this thread).
+void load_files(const char **filenames, int count, file_loaded_fn loaded, void *arg);
+
+//: set_load_uring
+//      1, the default, lets `load_files()` use io_uring; 0 keeps to
+//      `load_file()` (for testing and benchmarks).
+void set_load_uring(int enable);
+
+//: load_backend
+//      How `load_files()` reads files here: "io_uring" or "read".
+const char *load_backend(void);
+
+// A file being read a line at a time
+typedef struct {
+    int fd;
+    char *chunk;                                        /* the last read() */
+    size_t chunk_size;
+    size_t start;                                       /* unread bytes in `chunk` */
+    size_t end;
+    int eof;
+    char *line;                                         /* a line spanning reads */
+    size_t line_capacity;
+    uint64_t line_number;                               /* lines returned so far */
+    uint64_t offset;                                    /* file offset of the next line */
+    int error;                                          /* errno of a failed read, or 0 */
+} line_reader_t;
+
+//: open_lines
+//      Open `filename` to be read a line at a time, `chunk_size`
+//      bytes per read() (0 = a default). Returns 0 on success, -1 on
+//      error with `errno` set.
+int open_lines(const char *filename, line_reader_t *reader, size_t chunk_size);
+
+//: read_line
+//      The next line (with its '\n', if any) and its length, or NULL
+//      at the end of the file or on error (`reader->error`). The line
+//      is valid until the next call.
+const char *read_line(line_reader_t *reader, size_t *length);
+
+//: close_lines
+//      Close the file and release the reader's buffers.
+void close_lines(line_reader_t *reader);
+
+#endif /* READ_CONFIG_H */
@@ -0,0 +1,195 @@
+#include "serve-config.h"
+#include "parse-config.h"
+#include "print-config.h"
+#include "commit-config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+/**
+ *: reply_value
+ * @brief               Writes an "OK value" response (the values of an
+ *                      entry, without the key or an inline comment).
+ *
+ * @param out           The stream to write to.
+ * @param values        The entry; `values[0]` is the key.
+ */
+static void reply_value(FILE *out, char **values) {
+    fputs("OK", out);
+    for (values += 1; *values; values++) {
+        if (memcmp(*values, "#", 1) == 0)
+            break;
+        fprintf(out, " %s", *values);
+    }
+    fputs("\n", out);
+}
+
+/**
+ *: serve_set
+ * @brief               Handles a `set key=value` (or `+=`, `-=`) command.
+ *
+ * The change is made as `sysconf -f file key=value` makes it (see
+ * `commit_change()`), so a dotted key is changed inside its block;
+ * then the key's line is read back into the in-memory copy.
+ *
+ * @param filename      The config file.
+ * @param config        The parsed file (may be moved).
+ * @param count         The number of entries (updated).
+ * @param argument      The `key=value` argument.
+ * @param delimiters    Tokenizer delimiters.
+ * @param out           The stream to reply on.
+ */
+static void serve_set(const char *filename, config_t **config, int *count,
+                      const char *argument, char *delimiters, FILE *out) {
+    char **arg_array = NULL;
+    int arg_count = make_argv(argument, delimiters, &arg_array);
+    char *key = NULL;
+    char *report = NULL, *problems = NULL;
+    size_t report_size = 0, problems_size = 0;
+    FILE *reports = NULL, *errors = NULL;
+    if (arg_count < 2) {
+        fputs("ERR usage: set key=value\n", out);
+        goto done;
+    }
+
+    // The key of `key+=value` and `key-=value` carries the operator.
+    size_t key_length = strlen(arg_array[0]);
+    if (key_length > 1 && (arg_array[0][key_length - 1] == '+' || arg_array[0][key_length - 1] == '-')) {
+        key_length--;
+    }
+    key = strndup(arg_array[0], key_length);
+    reports = open_memstream(&report, &report_size);
+    errors = open_memstream(&problems, &problems_size);
+    if (key == NULL || reports == NULL || errors == NULL) {
+        fputs("ERR out of memory\n", out);
+        goto done;
+    }
+
+    int status = commit_change(filename, argument, delimiters, reports, errors);
+    fclose(reports);
+    fclose(errors);
+    reports = errors = NULL;
+    if (status != 0 || problems_size > 0) {
+        // (a change that was not needed is reported, and is an ERR too)
+        size_t length = strcspn(problems, "\n");
+        if (length > 0)
+            fprintf(out, "ERR %.*s\n", (int)length, problems);
+        else
+            fputs("ERR unable to change the config file\n", out);
+        goto done;
+    }
+
+    // Read the key's line back; a key whose last value was removed
+    // has no line any more, and one inside a block has no line of its
+    // own.
+    int found_count = 0;
+    config_t *found = lookup_config(filename, &found_count, delimiters, key);
+    char **values = found_count == 1 ? config_entry_values(found, 0) : NULL;
+    if (found == NULL) {
+        fputs("ERR changed, but unable to read the config file again\n", out);
+    } else if (values == NULL) {
+        if (find_config_item(*config, key, *count) != NULL)
+            remove_config_item(*config, count, key);
+        fputs("OK\n", out);
+    } else if (set_config_item(config, count, values, found[0].value_count) < 0) {
+        fputs("ERR out of memory\n", out);
+    } else {
+        reply_value(out, values);
+    }
+    if (found != NULL) {
+        free_config(found, found_count);
+        free(found);
+    }
+
+done:
+    if (reports) fclose(reports);
+    if (errors) fclose(errors);
+    free(report);
+    free(problems);
+    free(key);
+    if (arg_array) {
+        for (int i = 0; i < arg_count; i++) free(arg_array[i]);
+        free(arg_array);
+    }
+}
+
+/**
+ *: serve_config
+ * @brief               Answers get/set/del commands for a config file.
+ *
+ * @param filename      The config file.
+ * @param delimiters    Tokenizer delimiters.
+ * @param in            The stream to read commands from.
+ * @param out           The stream to write responses to.
+ *
+ * @return 0, or 1 if the file could not be parsed.
+ */
+int serve_config(const char *filename, char *delimiters, FILE *in, FILE *out) {
+    int count = 0;
+    config_t *config = parse_config(filename, &count, delimiters);
+    if (!config) {
+        fprintf(stderr, "Failed to parse the configuration file.\n");
+        return 1;
+    }
+    // Copy the values out of the (mapped) file now; it is rewritten
+    // while we run.
+    for (int i = 0; i < count; i++) {
+        config_entry_values(config, i);
+    }
+
+    // The change reports would get mixed up with the responses.
+    set_change_output(NULL);
+
+    char *line = NULL;
+    size_t line_size = 0;
+    ssize_t length;
+    while ((length = getline(&line, &line_size, in)) != -1) {
+        while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r'))
+            line[--length] = '\0';
+
+        // Split the line into a command and its argument.
+        char *command = line;
+        while (isspace((unsigned char)*command)) command++;
+        if (*command == '\0')
+            continue;
+        char *argument = command;
+        while (*argument && !isspace((unsigned char)*argument)) argument++;
+        if (*argument) *argument++ = '\0';
+        while (isspace((unsigned char)*argument)) argument++;
+
+        if (strcmp(command, "quit") == 0) {
+            fputs("OK\n", out);
+            fflush(out);
+            break;
+        } else if (strcmp(command, "get") != 0 && \
+                   strcmp(command, "set") != 0 && \
+                   strcmp(command, "del") != 0) {
+            fprintf(out, "ERR unknown command: %s\n", command);
+        } else if (*argument == '\0') {
+            fprintf(out, "ERR usage: %s key\n", command);
+        } else if (strcmp(command, "get") == 0) {
+            char **values = get_value(config, count, argument);
+            if (values)
+                reply_value(out, values);
+            else
+                fputs("ERR key not found\n", out);
+        } else if (strcmp(command, "set") == 0) {
+            serve_set(filename, &config, &count, argument, delimiters, out);
+        } else if (find_config_item(config, argument, count) == NULL) {         /* del */
+            fputs("ERR key not found\n", out);
+        } else if (removevariable(argument, filename) < 0) {
+            fputs("ERR unable to rewrite the config file\n", out);
+        } else {
+            remove_config_item(config, &count, argument);
+            fputs("OK\n", out);
+        }
+        fflush(out);
+    }
+    free(line);
+
+    free_config(config, count);
+    free(config);
+    return 0;
+}
@@ -0,0 +1,42 @@
+/**
+ * This code keeps a parsed configuration file in memory and answers
+ * commands for it, one per line, so a shell script can run `sysconf`
+ * once as a co-process instead of once per lookup.
+ *
+ * Commands (one per line):
+ *
+ *      get key                 look up a key
+ *      set key=value           set a value (also key+=value, key-=value)
+ *      del key                 remove a key
+ *      quit                    stop serving (so does end of input)
+ *
+ * Every command gets exactly one line back:
+ *
+ *      OK [value]              the command worked; `get` and `set`
+ *                              return the key's (new) value
+ *      ERR message             the command failed; nothing changed
+ *
+ * Changes are written to the file straight away--a `set` just as
+ * `sysconf -f file key=value` makes it (see commit-config.h), a `del`
+ * with `removevariable()`--and applied to the in-memory copy, which is
+ * not re-read. A `set` of a key inside a block (`web.ip4.addr`)
+ * answers a bare `OK`; the key has no line of its own to return.
+ *
+ * Example (ksh/bash co-process):
+ *
+ *      coproc sysconf -f /etc/rc.conf --serve
+ *      echo "get hostname" >&${COPROC[1]}
+ *      read -r status value <&${COPROC[0]}
+ */
+#ifndef SERVE_CONFIG_H
+#define SERVE_CONFIG_H
+
+#include <stdio.h>
+
+//: serve_config
+//      Parse `filename` and answer the commands read from `in` on `out`
+//      until end of input or `quit`. Returns 0, or 1 if the file could
+//      not be parsed.
+int serve_config(const char *filename, char *delimiters, FILE *in, FILE *out);
+
+#endif /* SERVE_CONFIG_H */
@@ -0,0 +1,121 @@
+#include "stats.h"
+
+#include <time.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+_Thread_local stats_t stats;
+
+static int timing = 0;                                  /* 1 = stats_enable() was called */
+static double wall[STATS_PHASES];                       /* seconds spent in each phase */
+static double cpu[STATS_PHASES];
+static double wall_start[STATS_PHASES];                 /* when the phase was started */
+static double cpu_start[STATS_PHASES];
+
+static const char *phase_names[STATS_PHASES] = { "parse", "lookup", "rewrite", "output" };
+
+/**
+ *: seconds
+ * @brief               Reads a clock.
+ *
+ * @param clock         CLOCK_MONOTONIC or CLOCK_PROCESS_CPUTIME_ID.
+ *
+ * @return double       The time in seconds.
+ */
+static double seconds(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ *: stats_enable
+ * @brief               Start timing phases.
+ */
+void stats_enable(void) {
+    timing = 1;
+}
+
+/**
+ *: stats_begin
+ * @brief               Start (or resume) timing a phase.
+ *
+ * @param phase         One of the STATS_ phases.
+ */
+void stats_begin(int phase) {
+    if (timing) {
+        wall_start[phase] = seconds(CLOCK_MONOTONIC);
+        cpu_start[phase] = seconds(CLOCK_PROCESS_CPUTIME_ID);
+    }
+}
+
+/**
+ *: stats_end
+ * @brief               Stop timing a phase.
+ *
+ * @param phase         One of the STATS_ phases.
+ */
+void stats_end(int phase) {
+    if (timing) {
+        wall[phase] += seconds(CLOCK_MONOTONIC) - wall_start[phase];
+        cpu[phase] += seconds(CLOCK_PROCESS_CPUTIME_ID) - cpu_start[phase];
+    }
+}
+
+/**
+ *: stats_add
+ * @brief               Adds one set of counters to another (a worker
+ *                      thread's to the main thread's).
+ *
+ * @param to            The counters to add to.
+ * @param from          The counters to add.
+ */
+void stats_add(stats_t *to, const stats_t *from) {
+    to->bytes_read += from->bytes_read;
+    to->bytes_written += from->bytes_written;
+    to->lines += from->lines;
+    to->tokens += from->tokens;
+    to->allocations += from->allocations;
+    to->allocated_bytes += from->allocated_bytes;
+    to->probes += from->probes;
+    to->daemon_requests += from->daemon_requests;
+    to->daemon_micros += from->daemon_micros;
+    to->round_trip_micros += from->round_trip_micros;
+}
+
+/**
+ *: stats_report
+ * @brief               Print the phase times, the counters and the
+ *                      peak resident size, one `name value` per line.
+ *
+ * @param stream        Where to print (sysconf uses STDERR).
+ */
+void stats_report(FILE *stream) {
+    struct rusage usage;
+    long peak_kb = 0;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#ifdef __APPLE__
+        peak_kb = usage.ru_maxrss / 1024;               /* bytes on macOS */
+#else
+        peak_kb = usage.ru_maxrss;                      /* kilobytes elsewhere */
+#endif
+    }
+
+    for (int i = 0; i < STATS_PHASES; i++) {
+        fprintf(stream, "stats: %-8s wall=%.6f cpu=%.6f\n", phase_names[i], wall[i], cpu[i]);
+    }
+    fprintf(stream, "stats: bytes_read=%llu bytes_written=%llu\n",
+            (unsigned long long)stats.bytes_read, (unsigned long long)stats.bytes_written);
+    fprintf(stream, "stats: lines=%llu tokens=%llu probes=%llu\n",
+            (unsigned long long)stats.lines, (unsigned long long)stats.tokens,
+            (unsigned long long)stats.probes);
+    fprintf(stream, "stats: allocations=%llu allocated_bytes=%llu peak_rss_kb=%ld\n",
+            (unsigned long long)stats.allocations, (unsigned long long)stats.allocated_bytes,
+            peak_kb);
+    if (stats.daemon_requests > 0) {
+        fprintf(stream, "stats: daemon_requests=%llu round_trip_us=%llu daemon_us=%llu\n",
+                (unsigned long long)stats.daemon_requests,
+                (unsigned long long)stats.round_trip_micros,
+                (unsigned long long)stats.daemon_micros);
+    }
+}
@@ -0,0 +1,70 @@
+/**
+ * This code keeps the counters and phase timers behind `sysconf
+ * --stats`.
+ *
+ * The counters are plain integers the parser, the index and the file
+ * writers add to as they go (cheap enough to leave on). Each thread
+ * has its own; a thread that parses for another hands its counters
+ * over with `stats_add()` when it is done. The
+ * phase timers only read the clocks once `stats_enable()` has been
+ * called. `stats_report()` prints everything to a stream.
+ *
+ *      stats_enable();
+ *      stats_begin(STATS_PARSE);
+ *      config = parse_config(...);
+ *      stats_end(STATS_PARSE);
+ *      ...
+ *      stats_report(stderr);
+ */
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+// Phases of a run that are timed
+enum {
+    STATS_PARSE,                                        /* parse_config(), scan_config(), caches */
+    STATS_LOOKUP,                                       /* get_value() and friends */
+    STATS_REWRITE,                                      /* replacevariable(), writevariable() */
+    STATS_OUTPUT,                                       /* printing results */
+    STATS_PHASES
+};
+
+// Counters (added to wherever the work is done)
+typedef struct {
+    uint64_t bytes_read;                                /* config bytes loaded or streamed */
+    uint64_t bytes_written;                             /* config bytes written or copied */
+    uint64_t lines;                                     /* lines looked at by the parser */
+    uint64_t tokens;                                    /* tokens found by the parser */
+    uint64_t allocations;                               /* parser heap allocations ... */
+    uint64_t allocated_bytes;                           /* ... and their size */
+    uint64_t probes;                                    /* hash slots / entries compared */
+    uint64_t daemon_requests;                           /* requests answered by sysconfd ... */
+    uint64_t daemon_micros;                             /* ... the time it took on them ... */
+    uint64_t round_trip_micros;                         /* ... and the time they took here */
+} stats_t;
+
+extern _Thread_local stats_t stats;
+
+//: stats_enable
+//      Start timing phases (see `stats_begin()`).
+void stats_enable(void);
+
+//: stats_begin
+//      Start (or resume) timing a phase.
+void stats_begin(int phase);
+
+//: stats_end
+//      Stop timing a phase; its wall and CPU time are added up.
+void stats_end(int phase);
+
+//: stats_add
+//      Add the counters in `from` to `to`.
+void stats_add(stats_t *to, const stats_t *from);
+
+//: stats_report
+//      Print the phase times, the counters and the peak resident size.
+void stats_report(FILE *stream);
+
+#endif /* STATS_H */
@@ -27,12 +27,57 @@
 //    Will display the cofig_file key=value pair.
 //
 //      % sysconf -f <config_file> key
-//    Will display the config_file key's value.
+//    Will display the config_file key's value (the file is searched
+//    for the key; only the line it is on is tokenized).
+//
+//      % sysconf -f <config_file> -q key ...
+//    Will print nothing and exit 0 if every key is there, 1 if not.
+//
+//      % sysconf -f <config_file> --keys
+//    Will display the keys of the config_file, one per line (the
+//    values are not tokenized).
+//
+//      % sysconf -f <config_file> key1 key2 key3
+//    Will display the value of each key, one line per key.
+//
+//      % sysconf -f <config_file> --cache key
+//    Will answer the lookup from `config_file.sysconf-cache`, a compiled
+//    index of the file, (re)building the cache when it is out of date.
+//
+//      % sysconf -f <config_file> --serve
+//    Will read get/set/del commands from STDIN and answer each with
+//    one line on STDOUT (see serve-config.h).
+//
+//      % sysconf -f <config_file> block.key
+//      % sysconf -f <config_file> 'block.*'
+//      % sysconf -f <config_file> '*.key'
+//    Will display the value of `key` inside the `block { ... }` block
+//    (as in jail.conf), or each value a pattern matches as
+//    `block.key: value` (see config-scope.h).
 //
 //      % sysconf -f <config_file> key=value
 //      % sysconf -f <config_file> key+=value
 //      % sysconf -f <config_file> key-=value
 //    Will change the config_file value to the value specified as an argument.
+//    Changes to a file are made under its lock; writers that run at
+//    the same time have their changes made together, with one rewrite
+//    of the file (see commit-config.h).
+//
+//      % sysconf -f <config_file> -f <config_file> ... key ...
+//      % sysconf -f '/usr/local/etc/jails/*.conf' key ...
+//    Will display the value of each key in each file, one line per key
+//    and file, tagged with the file name (the files are parsed on
+//    several threads).
+//
+//      % sysconf --overlay -f <defaults_file> -f <config_file> -f '<config_file>.d/*' key ...
+//    Will display the effective value of each key--the value set by
+//    the last of the files that has the key--tagged with the file
+//    that set it.
+//
+//      % sysconf --daemon [socket]
+//    Will keep the files asked about parsed and answer requests for
+//    them on a Unix socket; while it runs, the other forms on a single
+//    file are answered by it (see daemon-config.h).
 //
 //      % sysconf -f <config_file> -d <defaults_config_file>
 //    Will check for duplicate value entries for each key in the config_file against the
@@ -45,6 +90,13 @@
 //      sysconf -f configfile
 //      sysconf -f configfile -d configfile.defaults
 //      sysconf -f configfile [-n] [key]
+//      sysconf -f configfile -q key ...
+//      sysconf -f configfile --keys
+//      sysconf -f configfile [-n] key key ...
+//      sysconf -f configfile --cache [-n] key ...
+//      sysconf -f configfile -f configfile ... [-n] key ...
+//      sysconf --overlay -f configfile -f configfile ... [-n] key ...
+//      sysconf -f configfile --serve
 //      sysconf -f configfile [key=value]
 //      sysconf -f configfile [key+=value]
 //      sysconf -f configfile [key-=value]
@@ -52,13 +104,29 @@
 
 #include "parse-config.h"
 #include "print-config.h"
+#include "serve-config.h"
+#include "cache-config.h"
+#include "overlay-config.h"
+#include "commit-config.h"
+#include "daemon-config.h"
+#include "config-syntax.h"
+#include "config-scope.h"
+#include "stats.h"
 #include "version.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
+#include <errno.h>
 #include <ctype.h>
+#include <glob.h>
+#include <sys/stat.h>
+
+// A query for no more than this many keys against a file of at least
+// this many bytes scans the file for the keys instead of parsing it.
+#define SCAN_MAX_KEYS   16
+#define SCAN_MIN_BYTES  (1024 * 1024)
 
 //---[ MACROS ]------------------------------------------------------
 #define clean_argarray()                                        \
@@ -96,9 +164,420 @@
 #define usage()                                                 \
   do {                                                          \
     fprintf(stderr, "Version: %s\n", program_version);          \
-    fprintf(stderr, "Usage: %s -f file.conf [-d file.defaults] [-n] [key[=value]]\n", argv[0]); \
+    fprintf(stderr, "Usage: %s -f file.conf [-f file.conf ...] [--overlay] [-d file.defaults] [-n] [-q] [--keys] [--cache] [--serve] [--stats] [--parallel] [--format aligned|raw|nul] [key[=value] | key ...]\n", argv[0]); \
+    fprintf(stderr, "       %s --daemon [socket]\n", argv[0]); \
   } while (0)
 
+//------------------------------------------------------*- C -*------
+// scoped_query
+//      Look up a key by its full path through the file's blocks
+//      (`web.ip4.addr`), or every key a pattern matches (`web.*`,
+//      `*.exec.start`); see config-scope.h. A path prints its value
+//      like a plain key; a pattern prints one `path: value` line per
+//      match.
+//
+// ARGS
+//  file_string     :   config file name
+//  path            :   path or pattern
+//  delimiters      :   tokenizer delimiters
+//  keyvalue_output :   1 = prefix a path's value with "path: "
+//  quiet           :   1 = print nothing; only tell if it matched
+//  file_prefix     :   1 = start each line with "file_string: " (as
+//                      `query_files()` does)
+//
+// RETURN
+//  int             :   0 = found, -1 = nothing matched
+//-------------------------------------------------------------------
+static int scoped_query(const char *file_string, const char *path, char *delimiters,
+                        int keyvalue_output, int quiet, int file_prefix) {
+  config_syntax_t syntax;
+  config_scope_t scope;
+  int *nodes = NULL;
+  int pattern = strchr(path, '*') != NULL;
+
+  if (parse_syntax(file_string, delimiters, &syntax) < 0)
+    return -1;
+  int count = build_scope(&scope, &syntax) == 0 ? match_scope(&scope, path, &nodes) : -1;
+
+  stats_begin(STATS_OUTPUT);
+  for (int n = 0; n < count && !quiet; n++) {
+    const scope_node_t *node = &scope.nodes[nodes[n]];
+    const syntax_line_t *line = &syntax.lines[node->line];
+    if (file_prefix) {
+      printf("%s: ", file_string);
+    }
+    if (pattern || keyvalue_output != 0) {
+      printf("%s: ", scope.paths + node->path);
+    }
+    for (int t = 0; t < line->token_count; t++) {
+      const span_t *token = &syntax.tokens[line->first_token + t];
+      printf("%.*s ", (int)token->length, syntax.buffer.data + token->offset);
+    }
+    printf("\n");
+  }
+  stats_end(STATS_OUTPUT);
+
+  free(nodes);
+  if (count >= 0)
+    free_scope(&scope);
+  free_syntax(&syntax);
+  return count > 0 ? 0 : -1;
+}
+
+//------------------------------------------------------*- C -*------
+// query_keys
+//      Look up several keys with one read of the config file and
+//      print one line per key, in the order given. A key that is not
+//      found prints an empty line (so the output lines still line up
+//      with the keys) and an error on stderr. A dotted key or a
+//      pattern that is not a key of the file is looked up through its
+//      blocks, as a single key is (see `scoped_query()`).
+//
+// ARGS
+//  file_string     :   config file name
+//  keys            :   keys to look up
+//  key_count       :   number of keys
+//  delimiters      :   tokenizer delimiters
+//  keyvalue_output :   1 = prefix each value with "key: "
+//
+// RETURN
+//  int             :   0 = all keys found, 1 = otherwise
+//-------------------------------------------------------------------
+static int query_keys(const char *file_string, const char **keys, int key_count,
+                      char *delimiters, int keyvalue_output) {
+  struct stat st;
+  int config_count = 0;
+  int rc = 0;
+  config_t *config_array;
+
+  // -A few keys in a large file (or a pipe); stream it and only look
+  //  at the lines that match.
+  stats_begin(STATS_PARSE);
+  if (key_count <= SCAN_MAX_KEYS && stat(file_string, &st) == 0 && \
+      (st.st_size >= SCAN_MIN_BYTES || !S_ISREG(st.st_mode))) {
+    config_array = scan_config(file_string, &config_count, delimiters, keys, key_count);
+  } else {
+    config_array = parse_config(file_string, &config_count, delimiters);
+  }
+  stats_end(STATS_PARSE);
+
+  if (!config_array) {
+    fprintf(stderr, "Failed to parse the configuration file.\n");
+    return 1;
+  }
+
+  for (int k = 0; k < key_count; k++) {
+    stats_begin(STATS_LOOKUP);
+    char **config_line_array = get_value(config_array, config_count, keys[k]);
+    stats_end(STATS_LOOKUP);
+    // A dotted key or a pattern may name keys inside blocks (see
+    // `scoped_query()`).
+    if (config_line_array == NULL && \
+        (strchr(keys[k], '.') != NULL || strchr(keys[k], '*') != NULL)) {
+      stats_begin(STATS_LOOKUP);
+      int found = scoped_query(file_string, keys[k], delimiters, keyvalue_output, 0, 0);
+      stats_end(STATS_LOOKUP);
+      if (found == 0)
+        continue;
+    }
+    if (config_line_array == NULL) {
+      fprintf(stderr, "Error: key not found: %s\n", keys[k]);
+      printf("\n");
+      rc = 1;
+      continue;
+    }
+
+    stats_begin(STATS_OUTPUT);
+    if (keyvalue_output != 0) {
+      printf("%s: ", config_line_array[0]);
+    }
+    config_line_array += 1;                             /* strip the 'key' from the array */
+    while(*config_line_array) {
+      if (memcmp(*config_line_array, "#", 1) == 0)
+        break;
+      printf("%s ", *config_line_array++);
+    }
+    printf("\n");
+    stats_end(STATS_OUTPUT);
+  }
+
+  free_config(config_array, config_count);
+  free(config_array);
+  return rc;
+}
+
+//------------------------------------------------------*- C -*------
+// query_files
+//      Look up the same keys in several config files. The files are
+//      parsed at the same time (one thread per CPU) and then answered
+//      in the order given, one line per key and file:
+//
+//          filename: value ...
+//          filename: key: value ...        (-n)
+//
+//      A key a file does not have prints nothing for that file and an
+//      error on stderr; so does a file that is not there (it is not
+//      created). Dotted keys and patterns are looked up through
+//      the blocks of each file, as in `query_keys()`.
+//
+// ARGS
+//  files           :   config file names
+//  file_count      :   number of files
+//  keys            :   keys to look up
+//  key_count       :   number of keys
+//  delimiters      :   tokenizer delimiters
+//  keyvalue_output :   1 = prefix each value with "key: "
+//
+// RETURN
+//  int             :   0 = every key found in every file, 1 = otherwise
+//-------------------------------------------------------------------
+static int query_files(const char **files, int file_count, const char **keys, int key_count,
+                       char *delimiters, int keyvalue_output) {
+  config_t *arrays[file_count];
+  int counts[file_count];
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  int rc = 0;
+
+  stats_begin(STATS_PARSE);
+  parse_config_files(files, file_count, delimiters, arrays, counts, cpus > 0 ? (int)cpus : 1);
+  stats_end(STATS_PARSE);
+
+  for (int f = 0; f < file_count; f++) {
+    if (!arrays[f]) {
+      // A file that is not there is skipped, not created.
+      struct stat st;
+      if (stat(files[f], &st) < 0)
+        fprintf(stderr, "Error: %s: %s\n", files[f], strerror(errno));
+      else
+        fprintf(stderr, "Failed to parse the configuration file: %s\n", files[f]);
+      rc = 1;
+      continue;
+    }
+    for (int k = 0; k < key_count; k++) {
+      stats_begin(STATS_LOOKUP);
+      char **config_line_array = get_value(arrays[f], counts[f], keys[k]);
+      stats_end(STATS_LOOKUP);
+      if (config_line_array == NULL && \
+          (strchr(keys[k], '.') != NULL || strchr(keys[k], '*') != NULL)) {
+        stats_begin(STATS_LOOKUP);
+        int found = scoped_query(files[f], keys[k], delimiters, keyvalue_output, 0, 1);
+        stats_end(STATS_LOOKUP);
+        if (found == 0)
+          continue;
+      }
+      if (config_line_array == NULL) {
+        fprintf(stderr, "Error: key not found: %s in %s\n", keys[k], files[f]);
+        rc = 1;
+        continue;
+      }
+
+      stats_begin(STATS_OUTPUT);
+      printf("%s: ", files[f]);
+      if (keyvalue_output != 0) {
+        printf("%s: ", config_line_array[0]);
+      }
+      config_line_array += 1;                           /* strip the 'key' from the array */
+      while(*config_line_array) {
+        if (memcmp(*config_line_array, "#", 1) == 0)
+          break;
+        printf("%s ", *config_line_array++);
+      }
+      printf("\n");
+      stats_end(STATS_OUTPUT);
+    }
+    free_config(arrays[f], counts[f]);
+    free(arrays[f]);
+  }
+  return rc;
+}
+
+//------------------------------------------------------*- C -*------
+// query_overlay
+//      Look up keys in a stack of config files where the last file to
+//      set a key wins (see overlay-config.h), and print one line per
+//      key, in the order given, tagged with the file that set it:
+//
+//          filename: value ...
+//          filename: key: value ...        (-n)
+//
+//      A key no file has prints an empty line and an error on stderr.
+//
+// ARGS
+//  files           :   config file names, lowest first
+//  file_count      :   number of files
+//  keys            :   keys to look up
+//  key_count       :   number of keys
+//  delimiters      :   tokenizer delimiters
+//  keyvalue_output :   1 = prefix each value with "key: "
+//
+// RETURN
+//  int             :   0 = all keys found, 1 = otherwise
+//-------------------------------------------------------------------
+static int query_overlay(const char **files, int file_count, const char **keys, int key_count,
+                         char *delimiters, int keyvalue_output) {
+  config_overlay_t overlay;
+  int rc = 0;
+
+  stats_begin(STATS_PARSE);
+  int opened = open_overlay(&overlay, files, file_count, delimiters, 0);
+  stats_end(STATS_PARSE);
+  if (opened < 0) {
+    fprintf(stderr, "Failed to parse the configuration file.\n");
+    return 1;
+  }
+
+  for (int k = 0; k < key_count; k++) {
+    const char *source;
+    stats_begin(STATS_LOOKUP);
+    char **config_line_array = overlay_get(&overlay, keys[k], &source);
+    stats_end(STATS_LOOKUP);
+    if (config_line_array == NULL) {
+      fprintf(stderr, "Error: key not found: %s\n", keys[k]);
+      printf("\n");
+      rc = 1;
+      continue;
+    }
+
+    stats_begin(STATS_OUTPUT);
+    printf("%s: ", source);
+    if (keyvalue_output != 0) {
+      printf("%s: ", config_line_array[0]);
+    }
+    config_line_array += 1;                             /* strip the 'key' from the array */
+    while(*config_line_array) {
+      if (memcmp(*config_line_array, "#", 1) == 0)
+        break;
+      printf("%s ", *config_line_array++);
+    }
+    printf("\n");
+    stats_end(STATS_OUTPUT);
+  }
+
+  close_overlay(&overlay);
+  return rc;
+}
+
+//------------------------------------------------------*- C -*------
+// cache_query
+//      Answer a key lookup from the file's compiled cache (see
+//      cache-config.h). Nothing is printed unless the cache is current
+//      and holds every key, so the caller can fall back to parsing the
+//      file and report errors the usual way.
+//
+// ARGS
+//  file_string     :   config file name
+//  keys            :   keys to look up
+//  key_count       :   number of keys
+//  delimiters      :   tokenizer delimiters
+//  keyvalue_output :   1 = prefix each value with "key: "
+//
+// RETURN
+//  int             :   0 = answered, -1 = otherwise
+//-------------------------------------------------------------------
+static int cache_query(const char *file_string, const char **keys, int key_count,
+                       const char *delimiters, int keyvalue_output) {
+  config_cache_t cache;
+  const cache_token_t *tokens[key_count];
+  int token_count[key_count];
+
+  if (open_cache(file_string, delimiters, &cache) < 0)
+    return -1;
+
+  for (int k = 0; k < key_count; k++) {
+    if ((token_count[k] = cache_get(&cache, keys[k], &tokens[k])) == 0) {
+      close_cache(&cache);
+      return -1;
+    }
+  }
+
+  for (int k = 0; k < key_count; k++) {
+    if (keyvalue_output != 0) {
+      printf("%s: ", keys[k]);
+    }
+    for (int t = 1; t < token_count[k]; t++) {         /* skip the 'key' */
+      const char *token = cache.source.data + tokens[k][t].offset;
+      if (token[0] == '#')
+        break;
+      printf("%.*s ", (int)tokens[k][t].length, token);
+    }
+    printf("\n");
+  }
+
+  close_cache(&cache);
+  return 0;
+}
+
+//------------------------------------------------------*- C -*------
+// check_keys
+//      Tell whether every key is in the config file without printing
+//      anything (`-q`). One key is searched for in the loaded file
+//      (see `lookup_config()`); several are scanned for in one pass
+//      that stops once they are all found (see `scan_config()`).
+//      A file that is not there (or cannot be read) is not created,
+//      as the lookups would; it is only a status of 2.
+//
+// ARGS
+//  file_string     :   config file name
+//  keys            :   keys to look for
+//  key_count       :   number of keys
+//  delimiters      :   tokenizer delimiters
+//
+// RETURN
+//  int             :   0 = all keys found, 1 = a key is missing,
+//                      2 = the file could not be read
+//-------------------------------------------------------------------
+static int check_keys(const char *file_string, const char **keys, int key_count,
+                      char *delimiters) {
+  int config_count = 0;
+  config_t *config_array;
+
+  if (access(file_string, R_OK) < 0)
+    return 2;
+
+  stats_begin(STATS_PARSE);
+  if (key_count == 1)
+    config_array = lookup_config(file_string, &config_count, delimiters, keys[0]);
+  else
+    config_array = scan_config(file_string, &config_count, delimiters, keys, key_count);
+  stats_end(STATS_PARSE);
+  if (!config_array)
+    return 2;
+
+  int rc = 0;
+  stats_begin(STATS_LOOKUP);
+  for (int k = 0; k < key_count && rc == 0; k++) {
+    if (find_config_entry(config_array, config_count, keys[k]) >= 0)
+      continue;
+    if ((strchr(keys[k], '.') == NULL && strchr(keys[k], '*') == NULL) || \
+        scoped_query(file_string, keys[k], delimiters, 0, 1, 0) < 0)
+      rc = 1;
+  }
+  stats_end(STATS_LOOKUP);
+
+  free_config(config_array, config_count);
+  free(config_array);
+  return rc;
+}
+
+//------------------------------------------------------*- C -*------
+// print_stats
+//      Print the `--stats` report on stderr (run at exit).
+//-------------------------------------------------------------------
+static void print_stats(void) {
+  fflush(stdout);
+  stats_report(stderr);
+}
+
+//------------------------------------------------------*- C -*------
+// free_files
+//      Free the expanded `-f` file names (run at exit).
+//-------------------------------------------------------------------
+static glob_t file_glob;                                /* every `-f` name, patterns expanded */
+
+static void free_files(void) {
+  globfree(&file_glob);
+}
+
 //------------------------------------------------------*- C -*------
 // Main
 //
@@ -116,6 +595,24 @@ int main(int argc, char *argv[]) {
   char *arg_string = NULL;                              /* Used to store the argument string. */
   char delimiters[] = " \t\n\"\':=;";
   int keyvalue_output = 0;
+  int serve = 0;                                        /* 1 = answer commands from STDIN */
+  int use_cache = 0;                                    /* 1 = answer lookups from the compiled cache */
+  int show_stats = 0;                                   /* 1 = report timings and counters on stderr */
+  int parallel = 0;                                     /* 1 = parse big files on every CPU */
+  int format = PRINT_ALIGNED;                           /* how to list a whole file */
+  int overlay = 0;                                      /* 1 = the files are layers; the last wins */
+  int quiet = 0;                                        /* 1 = only tell (exit status) if the keys are there */
+  int keys_only = 0;                                    /* 1 = list the keys, not their values */
+  const char *key_strings[argc];                        /* Used to store every (non option) argument. */
+  int key_count = 0;
+  const char *file_patterns[argc];                      /* every `-f` argument, in order */
+  int pattern_count = 0;
+
+  // -Run as the lookup daemon (sysconfd) on the given (or the
+  //  default) socket.
+  if (argc >= 2 && strcmp(argv[1], "--daemon") == 0) {
+    return run_daemon(argc > 2 ? argv[2] : daemon_socket(), delimiters);
+  }
 
   // -Check the command line arguments.
   //  if there are not enough arguments, exit.
@@ -128,13 +625,49 @@ int main(int argc, char *argv[]) {
   // -Parse the command line options.
   for (int i = 1; i < argc; i++) {
     if (argv[i] && strlen(argv[i]) > 1) {
-      if (argv[i][0] != '-') { arg_string = argv[i]; }
-      if (argv[i][0] == '-' && argv[i][1] == 'f') { file_string = argv[++i]; }
+      if (argv[i][0] != '-') { arg_string = argv[i]; key_strings[key_count++] = argv[i]; }
+      if (argv[i][0] == '-' && argv[i][1] == 'f') { if (argv[++i]) file_patterns[pattern_count++] = argv[i]; }
       if (argv[i][0] == '-' && argv[i][1] == 'd') { default_string = argv[++i]; }
       if (argv[i][0] == '-' && argv[i][1] == 'n') { keyvalue_output = 1; }
+      if (argv[i][0] == '-' && argv[i][1] == 'q') { quiet = 1; }
+      if (strcmp(argv[i], "--serve") == 0) { serve = 1; }
+      if (strcmp(argv[i], "--cache") == 0) { use_cache = 1; }
+      if (strcmp(argv[i], "--stats") == 0) { show_stats = 1; }
+      if (strcmp(argv[i], "--parallel") == 0) { parallel = 1; }
+      if (strcmp(argv[i], "--overlay") == 0) { overlay = 1; }
+      if (strcmp(argv[i], "--keys") == 0) { keys_only = 1; }
+      if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+        i++;
+        if (strcmp(argv[i], "aligned") == 0) format = PRINT_ALIGNED;
+        else if (strcmp(argv[i], "raw") == 0) format = PRINT_RAW;
+        else if (strcmp(argv[i], "nul") == 0) format = PRINT_NUL;
+        else {
+          usage();
+          fprintf(stderr, "Error: Unknown format: %s\n", argv[i]);
+          return 1;
+        }
+      }
     }
   }
 
+  // -Expand any `-f` patterns (like `jails/*.conf`); a name that is
+  //  not a pattern is kept as given, a pattern that matches nothing
+  //  (an empty `.d` directory) is dropped.
+  for (int i = 0; i < pattern_count; i++) {
+    int flags = GLOB_NOESCAPE | (i > 0 ? GLOB_APPEND : 0);
+    if (strpbrk(file_patterns[i], "*?[") == NULL)
+      flags |= GLOB_NOCHECK;
+    glob(file_patterns[i], flags, NULL, &file_glob);
+  }
+  if (pattern_count > 0) {
+    atexit(free_files);
+  }
+  int file_count = (int)file_glob.gl_pathc;
+  const char **file_strings = (const char **)file_glob.gl_pathv;
+  if (file_count > 0) {
+    file_string = file_glob.gl_pathv[0];
+  }
+
   // -If there is not a `file_string` variable, quit.
   if (! file_string) {
     usage();
@@ -142,175 +675,254 @@ int main(int argc, char *argv[]) {
     return 1;
   }
 
-  // -Keep a record of how many items in the config file.
-  int config_count = 0;
-  int arg_count = 0;
-
-  // -Parse the config file.
-  config_t* config_array = parse_config(file_string, &config_count, delimiters);
-
-  // -If we couldn't parse the file, quit.
-  if (!config_array) {
-    fprintf(stderr, "Failed to parse the configuration file.\n");
-    free(config_array);
-    return 1;
+  // -Report where the time went when we are done.
+  if (show_stats) {
+    stats_enable();
+    atexit(print_stats);
   }
 
-  if (default_string != NULL) {         /* We are going to check the config file for
-                                         * duplicates against a defaults config file.
-                                         */
-    int default_count = 0;
-    config_t* default_array = parse_config(default_string, &default_count, delimiters);
+  // -Split big files between threads while parsing.
+  if (parallel) {
+    set_parse_threads(0, PARSE_PARALLEL_MIN_BYTES);
+  }
 
-    if (!default_array) {
-      fprintf(stderr, "Failed to parse the configuration file.\n");
-      free(config_array);
-      free(default_array);
+  // -Only tell, by the exit status, whether the keys are there.
+  if (quiet) {
+    int lookup = key_count > 0 && file_count == 1 && !overlay && !serve && default_string == NULL;
+    for (int i = 0; i < key_count; i++) {
+      if (count_tokens(key_strings[i], delimiters) != 1)
+        lookup = 0;
+    }
+    if (!lookup) {
+      usage();
+      fprintf(stderr, "Error: -q only checks keys in one configuration file\n");
       return 1;
     }
+    return check_keys(file_string, key_strings, key_count, delimiters);
+  }
 
-    for (int i = 0; i < config_count; i++) {
-      if (config_array[i].values != NULL && config_array[i].values[0] != NULL) {
-        char* key = config_array[i].values[0];
-        config_t* temp_conf = find_config_item(config_array, key, config_count);
-        config_t* temp_default = find_config_item(default_array, key, default_count);
-        if (temp_default != NULL) {
-          for (int x = 1; x < config_array[i].value_count; x++) {
-            char* value = temp_conf->values[x];
-            if (memcmp(value, "#", 1) == 0)
-              break;
-            if (contains(temp_default->values, temp_default->value_count, value) == 1)
-              printf("*DUPLICATE* %s: '%s'\n", key, value);
-          }
-        }
-      }
+  // -List the keys of the file; their values are never tokenized.
+  if (keys_only) {
+    if (key_count > 0 || file_count != 1 || overlay || serve || default_string != NULL) {
+      usage();
+      fprintf(stderr, "Error: --keys only lists the keys of one configuration file\n");
+      return 1;
     }
-    return 0;
-  }     /* end_ if(default_string) */
-
-  // -No argument (key = value or key) given so just
-  //  print the config values.
-  if(argc == 3) {
-    printconfigfile(config_array, config_count);
+    int config_count = 0;
+    stats_begin(STATS_PARSE);
+    config_t *config_array = parse_config(file_string, &config_count, delimiters);
+    stats_end(STATS_PARSE);
+    if (!config_array) {
+      fprintf(stderr, "Failed to parse the configuration file.\n");
+      return 1;
+    }
+    stats_begin(STATS_OUTPUT);
+    fflush(stdout);
+    int rc = print_config_keys(config_array, config_count, format, STDOUT_FILENO) < 0;
+    stats_end(STATS_OUTPUT);
     free_config(config_array, config_count);
     free(config_array);
-    return 0;
+    return rc;
   }
 
-  // -Parse the argument string passed to this program.
-  //  Based on the size of this array, we are going to determine if we
-  //  need to preform replacement operations or just list the value.
-  char **arg_array;                                     /* Used to store the argument
-                                                           string passed to this program. */
-  arg_count = make_argv(arg_string, delimiters, &arg_array);
-
-  // -Do things differently based on the number of arguments given.
-  //  no argument;
-  //    disply the config file.
-  //  key;
-  //    look up the key in the config_file and disply it's value.
-  //  key=value;
-  //    Make a addition/replacement/update in the config_file.
-  if (arg_count >= 1) {
-
-    // Get the values associated with the argument passed to this function.
-    char **config_line_array = get_value(config_array, config_count, arg_array[0]);
+  // -Several files; they can only be asked for keys, either in each
+  //  file or through the whole stack.
+  if (file_count > 1 || overlay) {
+    for (int i = 0; i < key_count; i++) {
+      if (count_tokens(key_strings[i], delimiters) != 1)
+        key_count = 0;
+    }
+    if (key_count == 0 || serve || default_string != NULL) {
+      usage();
+      fprintf(stderr, "Error: Several configuration files can only be queried for keys\n");
+      return 1;
+    }
+    if (overlay)
+      return query_overlay(file_strings, file_count, key_strings, key_count, delimiters, keyvalue_output);
+    return query_files(file_strings, file_count, key_strings, key_count, delimiters, keyvalue_output);
+  }
 
-    // If the key cannot be found in the config file, we need to check
-    // to see if the value is:
-    // 1. being searched for; if so, exit.
-    // 2. wanting to be added; if so, add it.
-    if (config_line_array == NULL) {
+  // -Keep the file loaded and answer commands from STDIN.
+  if (serve) {
+    return serve_config(file_string, delimiters, stdin, stdout);
+  }
 
-      if (arg_count == 1) {                             /* Seems to be a simple search situation,
-                                                           since, we do not have a key in the config
-                                                           file, we exit.*/
-        err("Error: key not found\n");
-        return 1;
+  // -Let a running daemon answer lookups, listings and changes of
+  //  one file; without one, carry on here.
+  if (default_string == NULL) {
+    static const char *format_names[] = { "aligned", "raw", "nul" };
+    daemon_request_t request = { "get", file_string, keyvalue_output ? "-n" : "", key_strings, key_count };
+    if (arg_string == NULL) {
+      request.command = "list";
+      request.option = format_names[format];
+    } else if (key_count == 1 && count_tokens(arg_string, delimiters) > 1) {
+      request.command = "set";
+    } else {
+      for (int i = 0; i < key_count; i++) {
+        if (count_tokens(key_strings[i], delimiters) != 1)
+          request.command = NULL;                       /* (an error; made below) */
       }
-      if (arg_count > 1) {                               /* Seems to be a condition where the key/value
-                                                           needs to be appended to the config file.*/
-        /* In the condition where the key is not found we need to
-         * check to see if the string is not a += or -= operation
-         * before we append the config file.  */
-        if ((strnstr(arg_array[0], "-", strlen(arg_array[0])) != NULL) ||
-            (strnstr(arg_array[0], "+", strlen(arg_array[0])) != NULL)) {
-          err("Incorrect syntax. Key is not found in config file.\n");
-          return 1;
-        }
-
-        writevariable(arg_array[0], arg_array, arg_count, file_string);
+    }
+    if (request.command != NULL) {
+      stats_begin(STATS_LOOKUP);
+      int answered = ask_daemon(daemon_socket(), &request, stdout, stderr);
+      stats_end(STATS_LOOKUP);
+      if (answered >= 0)
+        return answered;
+    }
+  }
 
-        cleanup();
+  // -Key lookups may be answered from the compiled cache; if it is
+  //  missing or stale, (re)build it for next time and carry on.
+  if (use_cache && key_count > 0 && default_string == NULL) {
+    int lookup = 1;
+    for (int i = 0; i < key_count; i++) {
+      if (count_tokens(key_strings[i], delimiters) != 1)
+        lookup = 0;
+    }
+    if (lookup) {
+      stats_begin(STATS_LOOKUP);
+      int answered = cache_query(file_string, key_strings, key_count, delimiters, keyvalue_output);
+      stats_end(STATS_LOOKUP);
+      if (answered == 0)
         return 0;
-      }
+      stats_begin(STATS_PARSE);
+      write_cache(file_string, delimiters);
+      stats_end(STATS_PARSE);
     }
+  }
 
-    // -If we only have a 'key' as an argument; just find in the
-    //  config and display the value set.
-    if(config_line_array != NULL && arg_count == 1) {
-      // Itterate the array and print chars.
-      if (keyvalue_output != 0) {
-        printf("%s: ", config_line_array[0]);
-      }
-      config_line_array += 1;                           /* strip the 'key' from the array */
-      while(*config_line_array) {
-        if (memcmp(*config_line_array, "#", 1) == 0)
-          break;
-        printf("%s ", *config_line_array++);
+  // -Several arguments; they must all be keys to look up.
+  if (key_count > 1 && default_string == NULL) {
+    for (int i = 0; i < key_count; i++) {
+      if (count_tokens(key_strings[i], delimiters) != 1) {
+        usage();
+        fprintf(stderr, "Error: Only one key=value can be given at a time\n");
+        return 1;
       }
-      printf("\n");
+    }
+    return query_keys(file_string, key_strings, key_count, delimiters, keyvalue_output);
+  }
+
+  // -Check the config file for duplicates against a defaults config
+  //  file; both are parsed at the same time.
+  if (default_string != NULL) {
+    const char *files[2] = { file_string, default_string };
+    config_t *arrays[2];
+    int counts[2];
+
+    stats_begin(STATS_PARSE);
+    int parsed = parse_config_files(files, 2, delimiters, arrays, counts, 2);
+    stats_end(STATS_PARSE);
 
-      cleanup();
-      return 0;
+    int rc = 0;
+    if (parsed < 0) {
+      fprintf(stderr, "Failed to parse the configuration file.\n");
+      rc = 1;
+    } else {
+      stats_begin(STATS_LOOKUP);
+      if (report_duplicates(arrays[0], counts[0], arrays[1], counts[1], stdout) < 0)
+        rc = 1;
+      stats_end(STATS_LOOKUP);
+    }
+    for (int i = 0; i < 2; i++) {
+      if (arrays[i]) {
+        free_config(arrays[i], counts[i]);
+        free(arrays[i]);
+      }
     }
+    return rc;
+  }
 
-    // -If the argument is equal to 'key=value' make a replacement.
-    // -However, if the argument is 'key+=value' or 'key-=value' make an update.
-    if(arg_count > 1) {
+  // -A change; it is queued with those of other writers to the file
+  //  and they are all made with one rewrite.
+  if (arg_string != NULL && count_tokens(arg_string, delimiters) > 1) {
+    stats_begin(STATS_REWRITE);
+    int rc = commit_change(file_string, arg_string, delimiters, stdout, stderr);
+    stats_end(STATS_REWRITE);
+    return rc;
+  }
 
-      // Count the config_line_array number of elements.
-      int i = 0;
-      for (; config_line_array[i] != NULL; i++)
-        ;
+  // -Keep a record of how many items in the config file.
+  int config_count = 0;
+  int arg_count = 0;
+  char **arg_array = NULL;                              /* Used to store the argument
+                                                           string passed to this program. */
 
-      // -Determine if we have a change to make; compare the `arg_array`
-      //  and the `config_array` values.
-      if (contains(config_line_array, i, arg_array[1]) == 0) {          /* 0 = A value was not found in the key's string... */
+  // -Parse the argument string passed to this program; it is a key
+  //  (changes were made above).
+  if (arg_string != NULL) {
+    arg_count = make_argv(arg_string, delimiters, &arg_array);
+  }
 
-        if (strstr(arg_array[0], "-") != NULL) {                        /* However, if the user wants to subtract a value
-                                                                           but the value was not found, we need to exit. */
-          err("Value not found in value string. No change made.\n");
-          return 0;
-        }
+  // -Parse the config file; for a key, only the line it is the key of
+  //  is looked for (and tokenized).
+  stats_begin(STATS_PARSE);
+  config_t* config_array;
+  if (arg_count >= 1)
+    config_array = lookup_config(file_string, &config_count, delimiters, arg_array[0]);
+  else
+    config_array = parse_config(file_string, &config_count, delimiters);
+  stats_end(STATS_PARSE);
 
-        replacevariable(config_line_array[0], arg_array, arg_count, file_string);
+  // -If we couldn't parse the file, quit.
+  if (!config_array) {
+    fprintf(stderr, "Failed to parse the configuration file.\n");
+    clean_argarray();
+    return 1;
+  }
 
-        /* LOGIC:
-         * - The concept is to free `arg_array` up to the `arg_count`, and allow the
-         *   `print-config.c` to free the additional value(s) added to the `arg_array`.
-         */
-        arg_array = NULL;
+  // -No argument (key = value or key) given so just
+  //  print the config values.
+  if(arg_string == NULL) {
+    stats_begin(STATS_OUTPUT);
+    fflush(stdout);
+    print_config_file(config_array, config_count, format, STDOUT_FILENO);
+    stats_end(STATS_OUTPUT);
+    free_config(config_array, config_count);
+    free(config_array);
+    return 0;
+  }
 
-        cleanup();
-        return 0;
+  // -Look up the key in the config_file and disply it's value.
+  if (arg_count >= 1) {
+    const char *key = arg_array[0];
 
-      } else if(contains(config_line_array, i, arg_array[1]) == 1) {    /* 1 = Value found... */
+    // Get the values associated with the argument passed to this function.
+    stats_begin(STATS_LOOKUP);
+    char **config_line_array = get_value(config_array, config_count, key);
+    stats_end(STATS_LOOKUP);
 
-        if (strstr(arg_array[0], "+") != NULL) {                        /* However, if the user wants to add a value
-                                                                           for a value that was found, we need to exit. */
-          err("Value found in key's value string. No change made.\n");
+    // If the key cannot be found in the config file, it may still be
+    // a dotted key naming a key inside a block (`web.ip4.addr`), or a
+    // pattern matching several.
+    if (config_line_array == NULL) {
+      if (strchr(key, '.') != NULL || strchr(key, '*') != NULL) {
+        stats_begin(STATS_LOOKUP);
+        int found = scoped_query(file_string, key, delimiters, keyvalue_output, 0, 0);
+        stats_end(STATS_LOOKUP);
+        if (found == 0) {
+          cleanup();
           return 0;
         }
-
-        replacevariable(config_line_array[0], arg_array, arg_count, file_string);
-
-        cleanup();
-        return 0;
-      } else {                                                    /* Assume the user wants to set a value that already exits. */
-        printf("Value found. No change made.\n");
       }
-    }   /* end_ if(arg_count > 1)  */
+      err("Error: key not found\n");
+      return 1;
+    }
+
+    // -Display the value set.
+    stats_begin(STATS_OUTPUT);
+    if (keyvalue_output != 0) {
+      printf("%s: ", config_line_array[0]);
+    }
+    config_line_array += 1;                             /* strip the 'key' from the array */
+    while(*config_line_array) {
+      if (memcmp(*config_line_array, "#", 1) == 0)
+        break;
+      printf("%s ", *config_line_array++);
+    }
+    printf("\n");
+    stats_end(STATS_OUTPUT);
   }     /* end_ if(arg_count >= 1) */
 
   cleanup();
@@ -1 +1 @@
-const char program_version[] = "1.3.2";
+const char program_version[] = "1.4.0";
@@ -0,0 +1 @@
+key1 key3
@@ -0,0 +1,2 @@
+value1 
+value3 
@@ -0,0 +1 @@
+-n key2 key1
@@ -0,0 +1,2 @@
+key2: value2 
+key1: value1 
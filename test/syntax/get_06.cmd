@@ -0,0 +1 @@
+-d test/syntax/set.in
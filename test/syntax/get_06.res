@@ -0,0 +1,3 @@
+*DUPLICATE* key1: 'value1'
+*DUPLICATE* key2: 'value2'
+*DUPLICATE* key3: 'value3'
@@ -0,0 +1 @@
+--format raw
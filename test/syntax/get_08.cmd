@@ -0,0 +1 @@
+-f test/syntax/set.in -n key1 key3
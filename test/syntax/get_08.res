@@ -0,0 +1,4 @@
+test/syntax/get.in: key1: value1 
+test/syntax/get.in: key3: value3 
+test/syntax/set.in: key1: value1 
+test/syntax/set.in: key3: value3 
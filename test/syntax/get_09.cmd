@@ -0,0 +1 @@
+--overlay -f test/syntax/set.in key2 key-4
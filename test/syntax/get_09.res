@@ -0,0 +1,2 @@
+test/syntax/set.in: value2 
+test/syntax/set.in: a b 
@@ -0,0 +1 @@
+-q key1 key3
@@ -0,0 +1 @@
+--keys
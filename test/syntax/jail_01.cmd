@@ -0,0 +1 @@
+db.ip4.addr
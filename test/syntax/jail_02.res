@@ -0,0 +1,2 @@
+web.host.hostname: web.example.org 
+db.host.hostname: db.example.org 
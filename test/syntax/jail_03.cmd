@@ -0,0 +1 @@
+db.ip4.addr+=10.0.0.4
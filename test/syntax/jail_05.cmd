@@ -0,0 +1 @@
+web.ip4.addr db.ip4.addr
@@ -0,0 +1,2 @@
+10.0.0.2 
+10.0.0.3 
@@ -0,0 +1 @@
+key-4: a b -> c a b 
@@ -0,0 +1 @@
+key-4-=c
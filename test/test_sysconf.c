@@ -12,13 +12,77 @@
 #include "minunit.h"
 #include "parse-config.h"
 #include "print-config.h"
+#include "serve-config.h"
+#include "cache-config.h"
+#include "config-syntax.h"
+#include "config-scope.h"
+#include "delim-scan.h"
+#include "read-config.h"
+#include "overlay-config.h"
+#include "commit-config.h"
+#include "daemon-config.h"
+#include "libsysconf.h"
+#include "stats.h"
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <errno.h>
 #include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <signal.h>
 
 int tests_run = 0;
 
+//** TEST FIXTURES **//
+// The temp files made by `write_fixture()`; `remove_fixtures()`
+// removes them once the tests are done, failed or not.
+#define FIXTURES_MAX 32
+static char *fixtures[FIXTURES_MAX];
+static int fixture_count = 0;
+
+/**
+ *: write_fixture
+ * @brief               Makes a temp file and writes a config into it.
+ * @param template      A `mkstemp()` template, the name is filled in.
+ * @param contents      The text of the file.
+ * @return              0 on success, -1 on error.
+ */
+static int write_fixture(char *template, const char *contents) {
+  if (fixture_count == FIXTURES_MAX)
+    return -1;
+  int fd = mkstemp(template);
+  if (fd < 0)
+    return -1;
+  fixtures[fixture_count++] = strdup(template);
+
+  FILE *file = fdopen(fd, "w");
+  if (file == NULL) {
+    close(fd);
+    return -1;
+  }
+  fputs(contents, file);
+  return fclose(file) == 0 ? 0 : -1;
+}
+
+/**
+ *: remove_fixtures
+ * @brief               Removes every temp file made by `write_fixture()`,
+ *                      and the cache and queue sysconf keeps beside it.
+ */
+static void remove_fixtures() {
+  char name[256];
+  for (int i = 0; i < fixture_count; i++) {
+    unlink(fixtures[i]);
+    snprintf(name, sizeof(name), "%s%s", fixtures[i], CACHE_SUFFIX);
+    unlink(name);
+    snprintf(name, sizeof(name), "%s%s", fixtures[i], QUEUE_SUFFIX);
+    unlink(name);
+    free(fixtures[i]);
+  }
+  fixture_count = 0;
+}
+
 //** TEST FUNCTIONS **//
 /**
  *: test_make_argv
@@ -207,6 +271,93 @@ static char * test_parse_config() {
   return 0;
 }
 
+/**
+ *: test_parse_config_entries
+ * @brief               Tests the single pass loader skips comments and
+ *                      blank lines and keeps every entry.
+ *
+ * PASS:    if the entries and their values match the file.
+ */
+static char * test_parse_config_entries() {
+  int count = 0;
+  char delimiters[] = " \t\n\"\':=;";
+
+  config_t* config = parse_config("test/syntax/get.in", &count, delimiters);
+
+  mu_assert(config != NULL);
+  mu_assert(count == 3);
+  // Nothing is copied out of the file, or tokenized, until it is
+  // asked for.
+  mu_assert(config[0].values == NULL);
+  mu_assert(config[2].value_count == 0);
+  config_view_t view;
+  size_t length;
+  config_view(config, &view);
+  const char *key = config_view_key(&view, 1, &length);
+  mu_assert(key != NULL && length == 4 && memcmp(key, "key2", 4) == 0);
+  mu_assert(config[1].value_count == 0);
+  mu_assert(strcmp(config_entry_values(config, 0)[0], "key1") == 0);
+  mu_assert(strcmp(config_entry_values(config, 1)[1], "value2") == 0);
+  mu_assert(config[2].values == NULL);
+  mu_assert(strcmp(get_value(config, count, "key3")[0], "key3") == 0);
+  mu_assert(config[2].values != NULL);
+  mu_assert(config[2].value_count == 2);
+
+  free_config(config, count);
+  free(config);
+
+  return 0;
+}
+
+/**
+ *: test_parse_config_allocations
+ * @brief               Tests that parsing a large file costs a handful
+ *                      of allocations rather than one per token.
+ *
+ * PASS:    if the arena used far fewer allocations than there are
+ *          tokens (the old parser made one per token plus one per
+ *          line).
+ */
+static char * test_parse_config_allocations() {
+  char *text;
+  size_t size;
+  FILE *file = open_memstream(&text, &size);
+  for (int i = 0; i < 5000; i++)
+    fprintf(file, "key%d = \"value%d other%d\";\n", i, i, i);
+  fclose(file);
+  char filename[] = "/tmp/sysconf-test.XXXXXX";
+  int written = write_fixture(filename, text);
+  free(text);
+  mu_assert(written == 0);
+
+  int count = 0;
+  char delimiters[] = " \t\n\"\':=;";
+  config_t* config = parse_config(filename, &count, delimiters);
+
+  mu_assert(config != NULL);
+  mu_assert(count == 5000);
+
+  // Only the keys are found while parsing; the values are tokenized
+  // when they are read.
+  size_t parsed = config_allocations(config);
+  config_view_t view;
+  config_view(config, &view);
+  int tokens = 0;
+  for (int i = 0; i < count; i++) {
+    const span_t *spans;
+    tokens += config_view_tokens(&view, i, &spans);
+  }
+  size_t allocations = config_allocations(config);
+  mu_assert(tokens == 15000);
+  mu_assert(parsed > 0 && parsed <= 4);
+  mu_assert(allocations <= 8);                  /* (the arena's blocks double) */
+
+  free_config(config, count);
+  free(config);
+
+  return 0;
+}
+
 /**
  *: test_get_value
  * @brief               Tests retrieving a value from config.
@@ -261,6 +412,1040 @@ static char * test_find_config_item() {
 
   return 0;
 }
+/**
+ *: test_get_value_index
+ * @brief               Tests key lookups on a parsed file go through
+ *                      the hash index with exact, first occurrence
+ *                      matching.
+ *
+ * PASS:    if the first entry for each key is returned and prefixes
+ *          of a key (or keys it is a prefix of) do not match.
+ */
+static char * test_get_value_index() {
+  char *text;
+  size_t size;
+  FILE *file = open_memstream(&text, &size);
+  fprintf(file, "key2 = two;\nkey = first;\nkey = second;\n");
+  for (int i = 0; i < 1000; i++)
+    fprintf(file, "item%d = %d;\n", i, i);
+  fclose(file);
+  char filename[] = "/tmp/sysconf-test.XXXXXX";
+  int written = write_fixture(filename, text);
+  free(text);
+  mu_assert(written == 0);
+
+  int count = 0;
+  char delimiters[] = " \t\n\"\':=;";
+  config_t* config = parse_config(filename, &count, delimiters);
+  mu_assert(config != NULL);
+
+  char **result = get_value(config, count, "key");
+  mu_assert(result != NULL);
+  mu_assert(strcmp(result[1], "first") == 0);
+
+  result = get_value(config, count, "key2");
+  mu_assert(result != NULL);
+  mu_assert(strcmp(result[1], "two") == 0);
+
+  result = get_value(config, count, "item999");
+  mu_assert(result != NULL);
+  mu_assert(strcmp(result[1], "999") == 0);
+
+  mu_assert(get_value(config, count, "ke") == NULL);
+  mu_assert(get_value(config, count, "key22") == NULL);
+  mu_assert(find_config_item(config, "item1000", count) == NULL);
+  mu_assert(find_config_item(config, "item10", count) == &config[13]);
+
+  free_config(config, count);
+  free(config);
+
+  // Arrays not made by `parse_config()` are scanned, also exactly.
+  char *v1[] = {"key", "val1", NULL};
+  config_t plain[1];
+  plain[0].values = v1;
+  plain[0].value_count = 2;
+  mu_assert(get_value(plain, 1, "key2") == NULL);
+  mu_assert(get_value(plain, 1, "key") == v1);
+
+  return 0;
+}
+
+/**
+ *: test_scan_config
+ * @brief               Tests scanning a file for a few keys.
+ *
+ * PASS:    if only the wanted keys are returned (first occurrence)
+ *          and missing keys are left out.
+ */
+static char * test_scan_config() {
+  char *text;
+  size_t size;
+  FILE *file = open_memstream(&text, &size);
+  fprintf(file, "# key = comment;\nkey2 = two;\nkey = first;\nkey = second;\n");
+  for (int i = 0; i < 1000; i++)
+    fprintf(file, "item%d = %d;\n", i, i);
+  fclose(file);
+  char filename[] = "/tmp/sysconf-test.XXXXXX";
+  int written = write_fixture(filename, text);
+  free(text);
+  mu_assert(written == 0);
+
+  int count = 0;
+  char delimiters[] = " \t\n\"\':=;";
+  const char *keys[] = { "item999", "key", "missing", "key" };
+  config_t* config = scan_config(filename, &count, delimiters, keys, 4);
+  mu_assert(config != NULL);
+  mu_assert(count == 2);
+
+  char **result = get_value(config, count, "key");
+  mu_assert(result != NULL);
+  mu_assert(strcmp(result[1], "first") == 0);
+
+  result = get_value(config, count, "item999");
+  mu_assert(result != NULL);
+  mu_assert(strcmp(result[1], "999") == 0);
+
+  mu_assert(get_value(config, count, "missing") == NULL);
+  mu_assert(get_value(config, count, "key2") == NULL);
+
+  free_config(config, count);
+  free(config);
+
+  return 0;
+}
+
+/**
+ *: test_lookup_config
+ * @brief               Tests searching a file for one key.
+ *
+ * PASS:    if only the line the key is the key of counts (not a
+ *          comment, a longer key or a value), the first one is
+ *          returned, and a missing key gives no entry.
+ */
+static char * test_lookup_config() {
+  char filename[] = "/tmp/sysconf-test.XXXXXX";
+  mu_assert(write_fixture(filename, "# key = comment;\nkeys = no;\nother = key;\n"
+                          "  \"key\" = first; # note\nkey = second;\n") == 0);
+
+  int count = 0;
+  char delimiters[] = " \t\n\"\':=;";
+  config_t* config = lookup_config(filename, &count, delimiters, "key");
+  mu_assert(config != NULL);
+  mu_assert(count == 1);
+  char **result = get_value(config, count, "key");
+  mu_assert(result != NULL);
+  mu_assert(strcmp(result[1], "first") == 0);
+  free_config(config, count);
+  free(config);
+
+  config = lookup_config(filename, &count, delimiters, "ke");
+  mu_assert(config != NULL);
+  mu_assert(count == 0);
+  free_config(config, count);
+  free(config);
+
+  return 0;
+}
+
+/**
+ *: test_long_lines
+ * @brief               Tests lines much longer than a read buffer.
+ *
+ * PASS:    if a 3000 value line is read (in 16 byte reads), parsed and
+ *          scanned as one entry.
+ */
+static char * test_long_lines() {
+  char *text;
+  size_t size;
+  FILE *file = open_memstream(&text, &size);
+  fprintf(file, "first = 1;\nexec_start = \"");
+  for (int i = 0; i < 3000; i++)
+    fprintf(file, "%sv%d", i ? " " : "", i);
+  fprintf(file, "\";\nlast = 2");                       /* no final newline */
+  fclose(file);
+  char filename[] = "/tmp/sysconf-test.XXXXXX";
+  int written = write_fixture(filename, text);
+  free(text);
+  mu_assert(written == 0);
+
+  line_reader_t reader;
+  const char *line;
+  size_t length, longest = 0;
+  mu_assert(open_lines(filename, &reader, 16) == 0);
+  while ((line = read_line(&reader, &length)) != NULL) {
+    if (length > longest) longest = length;
+    if (reader.line_number == 3)
+      mu_assert(length == 8 && memcmp(line, "last = 2", 8) == 0);
+  }
+  mu_assert(reader.error == 0);
+  mu_assert(reader.line_number == 3);
+  mu_assert(longest > 16000);
+  close_lines(&reader);
+
+  int count = 0;
+  char delimiters[] = " \t\n\"\':=;";
+  config_t* config = parse_config(filename, &count, delimiters);
+  mu_assert(config != NULL);
+  mu_assert(count == 3);
+  mu_assert(strcmp(get_value(config, count, "exec_start")[3000], "v2999") == 0);
+  mu_assert(config[1].value_count == 3001);
+  free_config(config, count);
+  free(config);
+
+  const char *keys[] = { "last", "exec_start" };
+  config = scan_config(filename, &count, delimiters, keys, 2);
+  mu_assert(config != NULL);
+  mu_assert(count == 2);
+  mu_assert(get_value(config, count, "exec_start")[0] != NULL);
+  mu_assert(strcmp(get_value(config, count, "exec_start")[3000], "v2999") == 0);
+  mu_assert(strcmp(get_value(config, count, "last")[1], "2") == 0);
+  free_config(config, count);
+  free(config);
+
+  return 0;
+}
+
+/**
+ *: test_stats
+ * @brief               Tests the `--stats` counters follow the parser.
+ *
+ * PASS:    if parsing and a lookup add the file's bytes, lines and
+ *          tokens, an allocation and a probe.
+ */
+static char * test_stats() {
+  int count = 0;
+  char delimiters[] = " \t\n\"\':=;";
+  stats_t before = stats;
+
+  config_t* config = parse_config("test/syntax/get.in", &count, delimiters);
+  mu_assert(config != NULL);
+  mu_assert(get_value(config, count, "key3") != NULL);
+
+  struct stat st;
+  mu_assert(stat("test/syntax/get.in", &st) == 0);
+  mu_assert(stats.bytes_read - before.bytes_read == (uint64_t)st.st_size);
+  mu_assert(stats.lines - before.lines >= 3);
+  mu_assert(stats.tokens - before.tokens == 2);  /* only the line of key3 */
+  mu_assert(stats.allocations > before.allocations);
+  mu_assert(stats.probes > before.probes);
+
+  free_config(config, count);
+  free(config);
+
+  return 0;
+}
+
+/**
+ *: test_parse_parallel
+ * @brief               Tests parsing on several threads gives the same
+ *                      array as parsing on one.
+ *
+ * PASS:    if the entries, their values and the first occurrence of
+ *          each key match a serial parse.
+ */
+static char * test_parse_parallel() {
+  char *text;
+  size_t size;
+  FILE *file = open_memstream(&text, &size);
+  for (int i = 0; i < 20000; i++) {
+    if (i % 100 == 0)
+      fprintf(file, "# comment %d\n\n", i);
+    fprintf(file, "key%d = \"value%d other%d\";\n", i % 7000, i, i % 3);
+  }
+  fclose(file);
+  char filename[] = "/tmp/sysconf-test.XXXXXX";
+  int written = write_fixture(filename, text);
+  free(text);
+  mu_assert(written == 0);
+
+  int serial_count = 0, parallel_count = 0;
+  char delimiters[] = " \t\n\"\':=;";
+  config_t* serial = parse_config(filename, &serial_count, delimiters);
+  set_parse_threads(4, 0);
+  config_t* parallel = parse_config(filename, &parallel_count, delimiters);
+  set_parse_threads(1, PARSE_PARALLEL_MIN_BYTES);
+
+  mu_assert(serial != NULL && parallel != NULL);
+  mu_assert(serial_count == 20000 && parallel_count == serial_count);
+  for (int i = 0; i < serial_count; i++) {
+    char **a = config_entry_values(serial, i);
+    char **b = config_entry_values(parallel, i);
+    mu_assert(serial[i].value_count == parallel[i].value_count);
+    for (int j = 0; j < serial[i].value_count; j++)
+      mu_assert(strcmp(a[j], b[j]) == 0);
+  }
+  mu_assert(strcmp(get_value(parallel, parallel_count, "key42")[1], "value42") == 0);
+  mu_assert(strcmp(get_value(parallel, parallel_count, "key6999")[1], "value6999") == 0);
+
+  free_config(serial, serial_count);
+  free(serial);
+  free_config(parallel, parallel_count);
+  free(parallel);
+
+  return 0;
+}
+
+// What `load_files()` handed over, for test_load_files
+typedef struct {
+  int calls;
+  size_t lengths[8];
+  int errors[8];
+  char first[8];
+} loaded_files_t;
+
+static void loaded_file(void *arg, int file, file_buffer_t *buffer, int error) {
+  loaded_files_t *loaded = arg;
+  loaded->calls++;
+  loaded->errors[file] = error;
+  if (buffer != NULL) {
+    loaded->lengths[file] = buffer->length;
+    loaded->first[file] = buffer->length > 0 ? buffer->data[0] : 0;
+    unload_file(buffer);
+  }
+}
+
+/**
+ *: test_load_files
+ * @brief               Tests loading several files at once, with and
+ *                      without io_uring.
+ *
+ * PASS:    if each file is handed over once with its whole contents
+ *          (or its error), and both ways parse the same.
+ */
+static char * test_load_files() {
+  char delimiters[] = " \t\n\"\':=;";
+  char empty[] = "/tmp/sysconf-test.XXXXXX";
+  mu_assert(write_fixture(empty, "") == 0);
+  const char *files[] = { "test/syntax/get.in", "test/syntax/set.in", "/tmp/sysconf-test.missing",
+                          empty, "test/syntax/get.in", "test/syntax" };
+  struct stat get_st, set_st;
+  mu_assert(stat(files[0], &get_st) == 0 && stat(files[1], &set_st) == 0);
+
+  for (int uring = 1; uring >= 0; uring--) {
+    loaded_files_t loaded;
+    memset(&loaded, 0, sizeof(loaded));
+    set_load_uring(uring);
+    load_files(files, 6, loaded_file, &loaded);
+    mu_assert(loaded.calls == 6);
+    mu_assert(loaded.errors[0] == 0 && loaded.lengths[0] == (size_t)get_st.st_size && loaded.first[0] == '/');
+    mu_assert(loaded.errors[1] == 0 && loaded.lengths[1] == (size_t)set_st.st_size);
+    mu_assert(loaded.errors[2] == ENOENT);
+    mu_assert(loaded.errors[3] == 0 && loaded.lengths[3] == 0);
+    mu_assert(loaded.errors[4] == 0 && loaded.lengths[4] == (size_t)get_st.st_size);
+    mu_assert(loaded.errors[5] != 0);
+
+    config_t *configs[4];
+    int counts[4];
+    mu_assert(parse_config_files(files, 2, delimiters, configs, counts, 2) == 0);
+    for (int i = 0; i < 2; i++) {
+      free_config(configs[i], counts[i]);
+      free(configs[i]);
+    }
+    // A file that is not there is skipped, not created.
+    mu_assert(parse_config_files(files, 4, delimiters, configs, counts, 2) == -1);
+    mu_assert(configs[2] == NULL && access(files[2], F_OK) != 0);
+    mu_assert(counts[0] == 3 && counts[1] == 4 && counts[2] == 0 && counts[3] == 0);
+    mu_assert(strcmp(get_value(configs[1], counts[1], "key-4")[2], "b") == 0);
+    for (int i = 0; i < 4; i++) {
+      if (configs[i] != NULL) {
+        free_config(configs[i], counts[i]);
+        free(configs[i]);
+      }
+    }
+  }
+  set_load_uring(1);
+
+  return 0;
+}
+
+/**
+ *: test_report_duplicates
+ * @brief               Tests loading two files at once and reporting
+ *                      the values one repeats from the other.
+ *
+ * PASS:    if both files are parsed and each repeated value is
+ *          reported once.
+ */
+static char * test_report_duplicates() {
+  char delimiters[] = " \t\n\"\':=;";
+  const char *files[] = { "test/syntax/get.in", "test/syntax/set.in" };
+  config_t *configs[2];
+  int counts[2];
+
+  mu_assert(parse_config_files(files, 2, delimiters, configs, counts, 2) == 0);
+  mu_assert(counts[0] == 3 && counts[1] == 4);
+
+  FILE *out = tmpfile();
+  mu_assert(report_duplicates(configs[0], counts[0], configs[1], counts[1], out) == 3);
+  mu_assert(report_duplicates(configs[1], counts[1], configs[0], counts[0], out) == 3);
+  rewind(out);
+  char line[64];
+  mu_assert(fgets(line, sizeof(line), out) != NULL);
+  mu_assert(strcmp(line, "*DUPLICATE* key1: 'value1'\n") == 0);
+  fclose(out);
+
+  for (int i = 0; i < 2; i++) {
+    free_config(configs[i], counts[i]);
+    free(configs[i]);
+  }
+
+  return 0;
+}
+
+/**
+ *: test_overlay_config
+ * @brief               Tests resolving keys through a stack of files.
+ *
+ * PASS:    if the last file to set a key wins, a file's first entry
+ *          wins inside it, missing files are skipped and the source of
+ *          each value is reported.
+ */
+static char * test_overlay_config() {
+  char delimiters[] = " \t\n\"\':=;";
+  char filename[] = "/tmp/sysconf-test.XXXXXX";
+  mu_assert(write_fixture(filename, "key2 = \"first\";\nkey9 = top;\nkey2 = second;\n") == 0);
+
+  const char *stack[] = { "test/syntax/get.in", "/tmp/sysconf-test.missing",
+                          "test/syntax/set.in", filename };
+  config_overlay_t overlay;
+  mu_assert(open_overlay(&overlay, stack, 4, delimiters, 2) == 0);
+  mu_assert(overlay.layer_count == 3);
+
+  const char *source = NULL;
+  char **values = overlay_get(&overlay, "key1", &source);
+  mu_assert(values != NULL && strcmp(values[1], "value1") == 0);
+  mu_assert(strcmp(source, "test/syntax/set.in") == 0);
+  values = overlay_get(&overlay, "key2", &source);
+  mu_assert(values != NULL && strcmp(values[1], "first") == 0);
+  mu_assert(strcmp(source, filename) == 0);
+  values = overlay_get(&overlay, "key-4", &source);
+  mu_assert(values != NULL && strcmp(values[1], "a") == 0 && strcmp(values[2], "b") == 0);
+  mu_assert(overlay_get(&overlay, "key5", NULL) == NULL);
+  close_overlay(&overlay);
+
+  struct stat st;
+  mu_assert(stat("/tmp/sysconf-test.missing", &st) != 0);
+
+  return 0;
+}
+
+/**
+ *: test_print_config_file
+ * @brief               Tests listing a whole file in each format.
+ *
+ * PASS:    if the aligned, raw and NUL formats match.
+ */
+static char * test_print_config_file() {
+  int count = 0;
+  char delimiters[] = " \t\n\"\':=;";
+  config_t* config = parse_config("test/syntax/get.in", &count, delimiters);
+  mu_assert(config != NULL);
+
+  const char *expected[] = {
+    "key1      \t=\tvalue1 \nkey2      \t=\tvalue2 \nkey3      \t=\tvalue3 \n",
+    "key1=value1\nkey2=value2\nkey3=value3\n",
+    "key1=value1\0key2=value2\0key3=value3\0"
+  };
+  size_t lengths[] = { 63, 36, 36 };
+  int formats[] = { PRINT_ALIGNED, PRINT_RAW, PRINT_NUL };
+  for (int f = 0; f < 3; f++) {
+    FILE *out = tmpfile();
+    char buffer[128];
+    mu_assert(print_config_file(config, count, formats[f], fileno(out)) == 0);
+    rewind(out);
+    mu_assert(fread(buffer, 1, sizeof(buffer), out) == lengths[f]);
+    mu_assert(memcmp(buffer, expected[f], lengths[f]) == 0);
+    fclose(out);
+  }
+
+  free_config(config, count);
+  free(config);
+
+  return 0;
+}
+
+/**
+ *: test_set_config_item
+ * @brief               Tests changing a parsed config array in place.
+ *
+ * PASS:    if set replaces the first entry (dropping duplicates),
+ *          appends new keys, and remove drops every entry for a key.
+ */
+static char * test_set_config_item() {
+  char filename[] = "/tmp/sysconf-test.XXXXXX";
+  mu_assert(write_fixture(filename, "key = one;\nother = two;\nkey = three;\n") == 0);
+
+  int count = 0;
+  char delimiters[] = " \t\n\"\':=;";
+  config_t* config = parse_config(filename, &count, delimiters);
+  mu_assert(config != NULL);
+  mu_assert(count == 3);
+
+  char *set[] = { "key", "new", "values", NULL };
+  mu_assert(set_config_item(&config, &count, set, 3) == 0);
+  mu_assert(count == 2);
+  mu_assert(strcmp(get_value(config, count, "key")[2], "values") == 0);
+
+  // Grow the array well past its first allocation.
+  char name[32];
+  for (int i = 0; i < 100; i++) {
+    snprintf(name, sizeof(name), "added%d", i);
+    char *add[] = { name, "v", NULL };
+    mu_assert(set_config_item(&config, &count, add, 2) == 0);
+  }
+  mu_assert(count == 102);
+  mu_assert(get_value(config, count, "added99") != NULL);
+  mu_assert(get_value(config, count, "other") != NULL);
+
+  mu_assert(remove_config_item(config, &count, "other") == 1);
+  mu_assert(count == 101);
+  mu_assert(get_value(config, count, "other") == NULL);
+  mu_assert(get_value(config, count, "added0") != NULL);
+
+  free_config(config, count);
+  free(config);
+
+  return 0;
+}
+
+/**
+ *: test_serve_config
+ * @brief               Tests the co-process command loop.
+ *
+ * PASS:    if every command gets one response line, changes reach
+ *          both the in-memory copy and the file, and a key inside a
+ *          block is changed in its block.
+ */
+static char * test_serve_config() {
+  char filename[] = "test/sysconf-test.XXXXXX";
+  mu_assert(write_fixture(filename, "key1 = value1\nkey2=\"value2\"\n") == 0);
+
+  FILE *in = tmpfile();
+  FILE *out = tmpfile();
+  fputs("get key1\nset key1+=more\nget key1\nset key9=nine\n"
+        "del key2\nget key2\nfrob key1\nquit\nget key1\n", in);
+  rewind(in);
+
+  char delimiters[] = " \t\n\"\':=;";
+  mu_assert(serve_config(filename, delimiters, in, out) == 0);
+  set_change_output(stdout);
+
+  char expected[] = "OK value1\nOK more value1\nOK more value1\nOK nine\n"
+                    "OK\nERR key not found\nERR unknown command: frob\nOK\n";
+  char response[256] = "";
+  rewind(out);
+  size_t length = fread(response, 1, sizeof(response) - 1, out);
+  response[length] = '\0';
+  fclose(in);
+  fclose(out);
+
+  int count = 0;
+  config_t* config = parse_config(filename, &count, delimiters);
+
+  mu_assert(strcmp(response, expected) == 0);
+  mu_assert(config != NULL);
+  mu_assert(count == 2);
+  mu_assert(strcmp(get_value(config, count, "key1")[1], "more") == 0);
+  mu_assert(strcmp(get_value(config, count, "key9")[1], "nine") == 0);
+  mu_assert(get_value(config, count, "key2") == NULL);
+
+  free_config(config, count);
+  free(config);
+
+  // A key inside a block is changed in its block, as the command
+  // line does it.
+  char jail[] = "test/sysconf-test.XXXXXX";
+  mu_assert(write_fixture(jail, "web {\n    ip4.addr = 10.0.0.2;\n}\n") == 0);
+
+  in = tmpfile();
+  out = tmpfile();
+  fputs("set web.ip4.addr=10.0.0.9\n", in);
+  rewind(in);
+  mu_assert(serve_config(jail, delimiters, in, out) == 0);
+  set_change_output(stdout);
+  rewind(out);
+  length = fread(response, 1, sizeof(response) - 1, out);
+  response[length] = '\0';
+  fclose(in);
+  fclose(out);
+
+  char text[256] = "";
+  FILE *file = fopen(jail, "r");
+  length = fread(text, 1, sizeof(text) - 1, file);
+  text[length] = '\0';
+  fclose(file);
+
+  mu_assert(strcmp(response, "OK\n") == 0);
+  mu_assert(strcmp(text, "web {\n    ip4.addr = 10.0.0.9;\n}\n") == 0);
+
+  return 0;
+}
+
+/**
+ *: test_config_syntax
+ * @brief               Tests the byte offsets of the syntax tree.
+ *
+ * PASS:    if the parts of an entry line are found where they are.
+ */
+static char * test_config_syntax() {
+  char filename[] = "/tmp/sysconf-test.XXXXXX";
+  mu_assert(write_fixture(filename, "# comment\n  key = \"one two\";  # note\nkey2:\n") == 0);
+
+  char delimiters[] = " \t\n\"\':=;";
+  config_syntax_t syntax;
+  mu_assert(parse_syntax(filename, delimiters, &syntax) == 0);
+  mu_assert(syntax.line_count == 3);
+  mu_assert(syntax.lines[0].key.length == 0);
+
+  const syntax_line_t *line = find_syntax_line(&syntax, "key", NULL);
+  mu_assert(line == &syntax.lines[1]);
+  mu_assert(line->start == 10 && line->end == 37);
+  mu_assert(line->key.offset == 12 && line->key.length == 3);
+  mu_assert(line->separator.offset == 16);
+  mu_assert(line->open_quote.offset == 18);
+  mu_assert(line->value.offset == 19 && line->value.length == 7);
+  mu_assert(line->close_quote.offset == 26);
+  mu_assert(line->terminator.offset == 27);
+  mu_assert(line->comment.offset == 30 && line->comment.length == 6);
+  mu_assert(line->token_count == 2);
+  mu_assert(find_syntax_line(&syntax, "key", line) == NULL);
+
+  line = find_syntax_line(&syntax, "key2", NULL);
+  mu_assert(line != NULL && line->token_count == 0);
+  mu_assert(line->value.offset == 42 && line->value.length == 0);
+
+  free_syntax(&syntax);
+  return 0;
+}
+
+/**
+ *: test_config_scope
+ * @brief               Tests the block and dotted key index.
+ *
+ * PASS:    if paths through nested blocks are found, patterns match
+ *          the right entries in order and blocks know their lines.
+ */
+static char * test_config_scope() {
+  char delimiters[] = " \t\n\"\':=;";
+  char filename[] = "/tmp/sysconf-test.XXXXXX";
+  mu_assert(write_fixture(filename,
+        "top.key = 1;\n"
+        "web {\n"
+        "    ip4.addr = 10.0.0.2;\n"
+        "    inner {\n"
+        "        deep = yes;\n"
+        "    }\n"
+        "}\n"
+        "solo\n"
+        "{\n"
+        "    ip4.addr = 10.0.0.9;\n"
+        "}\n"
+        "web.ip4.addr = late;\n") == 0);
+
+  config_syntax_t syntax;
+  config_scope_t scope;
+  mu_assert(parse_syntax(filename, delimiters, &syntax) == 0);
+  mu_assert(build_scope(&scope, &syntax) == 0);
+
+  int node = find_scope(&scope, "web.ip4.addr");
+  mu_assert(node >= 0 && scope.nodes[node].line == 2);
+  node = find_scope(&scope, "web.inner.deep");
+  mu_assert(node >= 0 && scope.nodes[node].line == 4);
+  node = find_scope(&scope, "web");
+  mu_assert(node >= 0 && scope.nodes[node].open_line == 1 && scope.nodes[node].close_line == 6);
+  node = find_scope(&scope, "solo");
+  mu_assert(node >= 0 && scope.nodes[node].open_line == 8 && scope.nodes[node].close_line == 10);
+  mu_assert(find_scope(&scope, "top.key") >= 0);
+  mu_assert(find_scope(&scope, "ip4.addr") < 0);
+
+  int *nodes;
+  mu_assert(match_scope(&scope, "*.ip4.addr", &nodes) == 2);
+  mu_assert(strcmp(scope.paths + scope.nodes[nodes[0]].path, "web.ip4.addr") == 0);
+  mu_assert(strcmp(scope.paths + scope.nodes[nodes[1]].path, "solo.ip4.addr") == 0);
+  free(nodes);
+  mu_assert(match_scope(&scope, "web.*", &nodes) == 2);
+  free(nodes);
+  mu_assert(match_scope(&scope, "*", &nodes) == 4);
+  free(nodes);
+  mu_assert(match_scope(&scope, "db.*", &nodes) == 0 && nodes == NULL);
+
+  free_scope(&scope);
+  free_syntax(&syntax);
+
+  return 0;
+}
+
+/**
+ *: test_replacevariable_splice
+ * @brief               Tests that a change only touches the value.
+ *
+ * PASS:    if the rest of the line and of the file is unchanged, a key
+ *          that merely starts with the same name is left alone and a
+ *          later line for the key is dropped.
+ */
+static char * test_replacevariable_splice() {
+  char filename[] = "test/sysconf-test.XXXXXX";
+  mu_assert(write_fixture(filename, "key10 = ten\n\tkey1 :  'a b' ;\t# note\nkey1 = old\n") == 0);
+
+  set_change_output(NULL);
+  char *add[] = { "key1+", "c", NULL };
+  mu_assert(replacevariable("key1", add, 2, filename) == 0);
+  set_change_output(stdout);
+
+  char expected[] = "key10 = ten\n\tkey1 :  'c a b' ;\t# note\n";
+  char contents[256] = "";
+  FILE *file = fopen(filename, "r");
+  size_t length = fread(contents, 1, sizeof(contents) - 1, file);
+  contents[length] = '\0';
+  fclose(file);
+
+  mu_assert(strcmp(contents, expected) == 0);
+  return 0;
+}
+
+/**
+ *: test_commit_change
+ * @brief               Tests gathering changes and making them from
+ *                      several processes at once.
+ *
+ * PASS:    if the file is not touched until `end_changes()`, which
+ *          makes every change of the batch, and no change of eight
+ *          writers running at once is lost (nor a temp file or the
+ *          queue left behind).
+ */
+static char * test_commit_change() {
+  char filename[] = "test/sysconf-test.XXXXXX";
+  char delimiters[] = " \t\n\"\':=;";
+  mu_assert(write_fixture(filename, "key1 = \"a b\";\nkey2 = old\n") == 0);
+
+  struct stat before, during, after;
+  mu_assert(stat(filename, &before) == 0);
+  FILE *previous = set_change_output(NULL);
+  mu_assert(begin_changes(filename) == 0);
+  mu_assert(changevariable("key1+=c", filename, delimiters, stderr) == 0);
+  mu_assert(changevariable("key2=new", filename, delimiters, stderr) == 0);
+  mu_assert(changevariable("key3=three", filename, delimiters, stderr) == 0);
+  mu_assert(changevariable("key1-=a", filename, delimiters, stderr) == 0);
+  mu_assert(stat(filename, &during) == 0);
+  mu_assert(during.st_ino == before.st_ino && during.st_size == before.st_size);
+  mu_assert(end_changes() == 0);
+  mu_assert(stat(filename, &after) == 0);
+  mu_assert(after.st_mode == before.st_mode);
+
+  char expected[] = "key1 = \"c b\";\nkey2 = new\nkey3=\"three\" \n";
+  char contents[256] = "";
+  FILE *file = fopen(filename, "r");
+  size_t length = fread(contents, 1, sizeof(contents) - 1, file);
+  contents[length] = '\0';
+  fclose(file);
+  mu_assert(strcmp(contents, expected) == 0);
+
+  // -Eight writers at once.
+  fflush(NULL);
+  for (int i = 0; i < 8; i++) {
+    if (fork() == 0) {
+      char argument[32];
+      snprintf(argument, sizeof(argument), "writer%d=%d", i, i);
+      FILE *quiet = fopen("/dev/null", "w");
+      _exit(commit_change(filename, argument, delimiters, quiet, stderr));
+    }
+  }
+  int failed = 0, status;
+  while (wait(&status) > 0) {
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+      failed++;
+  }
+  set_change_output(previous);
+  mu_assert(failed == 0);
+
+  int count = 0;
+  config_t *config = parse_config(filename, &count, delimiters);
+  mu_assert(config != NULL);
+  for (int i = 0; i < 8; i++) {
+    char key[16];
+    snprintf(key, sizeof(key), "writer%d", i);
+    mu_assert(get_value(config, count, key) != NULL);
+  }
+  free_config(config, count);
+  free(config);
+
+  char queue[sizeof(filename) + sizeof(QUEUE_SUFFIX)];
+  snprintf(queue, sizeof(queue), "%s%s", filename, QUEUE_SUFFIX);
+  mu_assert(access(queue, F_OK) != 0);
+  return 0;
+}
+
+/**
+ *: test_daemon_config
+ * @brief               Tests asking a running daemon.
+ *
+ * PASS:    if the daemon answers lookups and a listing like `sysconf`
+ *          would, sees a change made behind its back, makes a change
+ *          itself, and nothing answers once it is stopped.
+ */
+static char * test_daemon_config() {
+  char filename[] = "test/sysconf-test.XXXXXX";
+  char socket_path[] = "test/sysconfd-test.sock";
+  char delimiters[] = " \t\n\"\':=;";
+  mu_assert(write_fixture(filename, "key1 = \"a b\";\nkey2=two # note\n") == 0);
+
+  fflush(NULL);
+  pid_t daemon = fork();
+  if (daemon == 0) {
+    fclose(stderr);
+    _exit(run_daemon(socket_path, delimiters));
+  }
+  struct stat st;
+  for (int i = 0; i < 500 && stat(socket_path, &st) != 0; i++)
+    usleep(10000);
+
+  char output[256], errors[256];
+  const char *keys[] = { "key2", "nokey" };
+  daemon_request_t get = { "get", filename, "-n", keys, 2 };
+  FILE *out = fmemopen(output, sizeof(output), "w");
+  FILE *err = fmemopen(errors, sizeof(errors), "w");
+  int status = ask_daemon(socket_path, &get, out, err);
+  fclose(out);
+  fclose(err);
+  mu_assert(status == 1);
+  mu_assert(strcmp(output, "key2: two \n\n") == 0);
+  mu_assert(strcmp(errors, "Error: key not found: nokey\n") == 0);
+
+  // -Changed by someone else, in place; then by the daemon.
+  FILE *file = fopen(filename, "w");
+  fprintf(file, "key1 = \"c\";\n");
+  fclose(file);
+  daemon_request_t again = { "get", filename, "", keys, 1 };
+  keys[0] = "key1";
+  out = fmemopen(output, sizeof(output), "w");
+  mu_assert(ask_daemon(socket_path, &again, out, stderr) == 0);
+  fclose(out);
+  mu_assert(strcmp(output, "c \n") == 0);
+  const char *change[] = { "key3=three" };
+  daemon_request_t set = { "set", filename, "", change, 1 };
+  out = fmemopen(output, sizeof(output), "w");
+  mu_assert(ask_daemon(socket_path, &set, out, stderr) == 0);
+  fclose(out);
+  daemon_request_t list = { "list", filename, "raw", NULL, 0 };
+  out = fmemopen(output, sizeof(output), "w");
+  mu_assert(ask_daemon(socket_path, &list, out, stderr) == 0);
+  fclose(out);
+  mu_assert(strcmp(output, "key1=c\nkey3=three\n") == 0);
+
+  kill(daemon, SIGTERM);
+  waitpid(daemon, &status, 0);
+  mu_assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  mu_assert(ask_daemon(socket_path, &list, stdout, stderr) == -1);
+  return 0;
+}
+
+/**
+ *: test_libsysconf
+ * @brief               Tests the handle API.
+ *
+ * PASS:    if lookups and iteration see the staged changes, the file is
+ *          not touched until the commit, and the commit makes them all.
+ */
+static char * test_libsysconf() {
+  char filename[] = "test/sysconf-test.XXXXXX";
+  mu_assert(write_fixture(filename, "key1 = \"a b\";\nkey2=two # note\nkey3 = three\nkey2 = dup\n") == 0);
+
+  sysconf_t *conf = sysconf_open(filename, NULL);
+  mu_assert(conf != NULL);
+  sysconf_value_t values[4];
+  mu_assert(sysconf_get(conf, "key2", values, 4) == 1);
+  mu_assert(values[0].length == 3 && memcmp(values[0].data, "two", 3) == 0);
+  mu_assert(sysconf_get(conf, "key1", values, 1) == 2);
+  mu_assert(sysconf_get(conf, "nokey", values, 4) == -1);
+
+  struct stat before, after;
+  mu_assert(stat(filename, &before) == 0);
+  mu_assert(sysconf_set(conf, "key1", "c") == 0);
+  mu_assert(sysconf_set(conf, "key4", "four x") == 0);
+  mu_assert(sysconf_delete(conf, "key3") == 0);
+  mu_assert(sysconf_delete(conf, "nokey") == -1 && errno == ENOENT);
+  mu_assert(sysconf_set(conf, "key5+", "x") == -1 && errno == EINVAL);
+  mu_assert(sysconf_get(conf, "key1", values, 4) == 1 && values[0].data[0] == 'c');
+  mu_assert(sysconf_get(conf, "key3", values, 4) == -1);
+
+  char listing[128] = "";
+  int position = 0, n;
+  while ((n = sysconf_next(conf, &position, values, 4)) >= 0) {
+    for (int i = 0; i < n; i++)
+      snprintf(listing + strlen(listing), sizeof(listing) - strlen(listing), "%.*s%s",
+               (int)values[i].length, values[i].data, i + 1 < n ? " " : "\n");
+  }
+  mu_assert(strcmp(listing, "key1 c\nkey2 two\nkey2 dup\nkey4 four x\n") == 0);
+  mu_assert(stat(filename, &after) == 0);
+  mu_assert(after.st_ino == before.st_ino && after.st_size == before.st_size);
+
+  mu_assert(sysconf_commit(conf) == 0);
+  mu_assert(strcmp(sysconf_error(conf), "") == 0);
+  mu_assert(sysconf_get(conf, "key4", values, 4) == 2);
+  mu_assert(sysconf_get(conf, "key3", values, 4) == -1);
+  sysconf_close(conf);
+
+  char expected[] = "key1 = \"c\";\nkey2=two # note\nkey2 = dup\nkey4=\"four x\" \n";
+  char contents[256] = "";
+  FILE *file = fopen(filename, "r");
+  size_t length = fread(contents, 1, sizeof(contents) - 1, file);
+  contents[length] = '\0';
+  fclose(file);
+  mu_assert(strcmp(contents, expected) == 0);
+  return 0;
+}
+
+/**
+ *: test_libsysconf_truncate
+ * @brief               Tests a handle whose file is truncated by
+ *                      another process.
+ *
+ * PASS:    if lookups still answer from what the handle loaded (a
+ *          mapped file would fault instead).
+ */
+static char * test_libsysconf_truncate() {
+  char *text;
+  size_t size;
+  FILE *file = open_memstream(&text, &size);
+  for (int i = 0; i < 20000; i++)
+    fprintf(file, "key%d = value%d;\n", i, i);
+  fclose(file);
+  char filename[] = "test/sysconf-test.XXXXXX";
+  int written = write_fixture(filename, text);
+  free(text);
+  mu_assert(written == 0);
+
+  sysconf_t *conf = sysconf_open(filename, NULL);
+  mu_assert(conf != NULL);
+  mu_assert(truncate(filename, 0) == 0);
+  sysconf_value_t values[2];
+  mu_assert(sysconf_get(conf, "key19999", values, 2) == 1);
+  mu_assert(values[0].length == 10 && memcmp(values[0].data, "value19999", 10) == 0);
+  sysconf_close(conf);
+  return 0;
+}
+
+/**
+ *: test_removevariable_copy
+ * @brief               Tests rewriting a large file around a change.
+ *
+ * PASS:    if only the removed line is missing from the file.
+ */
+static char * test_removevariable_copy() {
+  char *text;
+  size_t size;
+  FILE *file = open_memstream(&text, &size);
+  for (int i = 0; i < 20000; i++) {
+    fprintf(file, "item%d = \"value %d\";\n", i, i);
+  }
+  fclose(file);
+  char filename[] = "test/sysconf-test.XXXXXX";
+  int written = write_fixture(filename, text);
+  free(text);
+  mu_assert(written == 0);
+
+  struct stat before, after;
+  mu_assert(stat(filename, &before) == 0);
+  set_change_output(NULL);
+  mu_assert(removevariable("item10000", filename) == 1);
+  set_change_output(stdout);
+  mu_assert(stat(filename, &after) == 0);
+
+  int count = 0;
+  char delimiters[] = " \t\n\"\':=;";
+  config_t* config = parse_config(filename, &count, delimiters);
+
+  mu_assert(after.st_size == before.st_size - (off_t)strlen("item10000 = \"value 10000\";\n"));
+  mu_assert(config != NULL);
+  mu_assert(count == 19999);
+  mu_assert(get_value(config, count, "item10000") == NULL);
+  mu_assert(strcmp(get_value(config, count, "item19999")[2], "19999") == 0);
+
+  free_config(config, count);
+  free(config);
+  return 0;
+}
+
+/**
+ *: test_delim_scan
+ * @brief               Tests the vector delimiter scanner against the
+ *                      lookup table.
+ *
+ * PASS:    if both find the same boundaries and tokens from every
+ *          offset of a buffer (so every alignment and tail length is
+ *          covered).
+ */
+static char * test_delim_scan() {
+  char delimiters[] = " \t\n\"\':=;";
+  char buffer[200];
+  for (size_t i = 0; i < sizeof(buffer); i++) {
+    buffer[i] = "key.value= \t\"x;y:z'\n#\200\377"[(i * 7 + i / 13) % 24];
+  }
+  for (size_t i = 60; i < 110; i++) buffer[i] = 'a';          /* a long token ... */
+  for (size_t i = 120; i < 170; i++) buffer[i] = ' ';         /* ... and a long gap */
+
+  delim_set_t fast, table;
+  delim_init(&fast, delimiters);
+  delim_init_table(&table, delimiters);
+  for (size_t i = 0; i < sizeof(buffer); i++) {
+    size_t length = sizeof(buffer) - i;
+    mu_assert(delim_find(&fast, buffer + i, length) == delim_find(&table, buffer + i, length));
+    mu_assert(delim_span(&fast, buffer + i, length) == delim_span(&table, buffer + i, length));
+
+    span_t fast_spans[64], table_spans[64];
+    int n = delim_tokens(&fast, buffer + i, length, fast_spans, 64);
+    mu_assert(n == delim_tokens(&table, buffer + i, length, table_spans, 64));
+    mu_assert(memcmp(fast_spans, table_spans, (n < 64 ? n : 64) * sizeof(span_t)) == 0);
+  }
+  mu_assert(delim_find(&fast, buffer + 60, 50) == 50);
+  mu_assert(delim_span(&fast, buffer + 120, 50) == 50);
+  return 0;
+}
+
+/**
+ *: test_config_cache
+ * @brief               Tests the compiled cache of a config file.
+ *
+ * PASS:    if the cache answers lookups, follows changes made with
+ *          `writevariable()` and is refused once the file changes
+ *          behind its back.
+ */
+static char * test_config_cache() {
+  char filename[] = "/tmp/sysconf-test.XXXXXX";
+  mu_assert(write_fixture(filename, "# comment\nkey1 = value1 more\nkey2=\"value2\"\nkey1 = later\n") == 0);
+
+  char delimiters[] = " \t\n\"\':=;";
+  config_cache_t cache;
+  const cache_token_t *tokens;
+  mu_assert(open_cache(filename, delimiters, &cache) < 0);
+  mu_assert(write_cache(filename, delimiters) == 0);
+  mu_assert(open_cache(filename, delimiters, &cache) == 0);
+  mu_assert(cache_get(&cache, "key1", &tokens) == 3);
+  mu_assert(strncmp(cache.source.data + tokens[2].offset, "more", tokens[2].length) == 0);
+  mu_assert(cache_get(&cache, "key", &tokens) == 0);
+  close_cache(&cache);
+
+  // Other delimiters need a cache of their own.
+  mu_assert(open_cache(filename, " =", &cache) < 0);
+
+  // Changes made through sysconf rebuild the cache.
+  set_change_output(NULL);
+  char *add[] = { "key3", "three", NULL };
+  mu_assert(writevariable("key3", add, 2, filename) == 0);
+  set_change_output(stdout);
+  mu_assert(open_cache(filename, delimiters, &cache) == 0);
+  mu_assert(cache_get(&cache, "key3", &tokens) == 2);
+  close_cache(&cache);
+
+  // Other changes make it stale.
+  FILE *file = fopen(filename, "a");
+  fprintf(file, "key4 = four\n");
+  fclose(file);
+  mu_assert(open_cache(filename, delimiters, &cache) < 0);
+
+  return 0;
+}
+
 //** TEST RUNNER **//
 // This function just runs all test functions.
 static char * all_tests() {
@@ -275,13 +1460,38 @@ static char * all_tests() {
     mu_run_test("test_asseble_strings", "error, assembled string does not match test string", test_assemble_strings);
     mu_run_test("test_count_tokens", "error, token count mismatch", test_count_tokens);
     mu_run_test("test_parse_config", "error, failed to parse config", test_parse_config);
+    mu_run_test("test_parse_config_entries", "error, parsed entries do not match file", test_parse_config_entries);
+    mu_run_test("test_parse_config_allocations", "error, parser made too many allocations", test_parse_config_allocations);
     mu_run_test("test_get_value", "error, failed to get config value", test_get_value);
     mu_run_test("test_find_config_item", "error, failed to find config item", test_find_config_item);
+    mu_run_test("test_get_value_index", "error, indexed lookup returned the wrong entry", test_get_value_index);
+    mu_run_test("test_scan_config", "error, scan returned the wrong entries", test_scan_config);
+    mu_run_test("test_lookup_config", "error, search found the wrong line", test_lookup_config);
+    mu_run_test("test_long_lines", "error, a long line was split or cut", test_long_lines);
+    mu_run_test("test_stats", "error, stats counters did not move", test_stats);
+    mu_run_test("test_parse_parallel", "error, threaded parse differs from serial", test_parse_parallel);
+    mu_run_test("test_load_files", "error, batch load went wrong", test_load_files);
+    mu_run_test("test_report_duplicates", "error, duplicate report went wrong", test_report_duplicates);
+    mu_run_test("test_overlay_config", "error, overlay resolved the wrong value", test_overlay_config);
+    mu_run_test("test_print_config_file", "error, listing format is wrong", test_print_config_file);
+    mu_run_test("test_set_config_item", "error, in-memory change went wrong", test_set_config_item);
+    mu_run_test("test_serve_config", "error, co-process responses do not match", test_serve_config);
+    mu_run_test("test_config_syntax", "error, syntax tree offsets are wrong", test_config_syntax);
+    mu_run_test("test_config_scope", "error, scoped lookup went wrong", test_config_scope);
+    mu_run_test("test_replacevariable_splice", "error, change did not preserve the file", test_replacevariable_splice);
+    mu_run_test("test_commit_change", "error, a change was lost", test_commit_change);
+    mu_run_test("test_daemon_config", "error, daemon answered wrong", test_daemon_config);
+    mu_run_test("test_libsysconf", "error, handle API went wrong", test_libsysconf);
+    mu_run_test("test_libsysconf_truncate", "error, a truncated file broke a handle", test_libsysconf_truncate);
+    mu_run_test("test_removevariable_copy", "error, rewrite changed more than the removed line", test_removevariable_copy);
+    mu_run_test("test_delim_scan", "error, vector scanner disagrees with the table", test_delim_scan);
+    mu_run_test("test_config_cache", "error, cache lookups went wrong", test_config_cache);
     return 0;
 }
 
 int main() {
   char *result = all_tests();
+  remove_fixtures();
   printf("1..%d\n", tests_run);
   return result != 0;
 }